@@ -4,8 +4,21 @@
 #include "Time_Delays.h"
 #include "Clk_Config.h"
 #include "LCD_Display.h"
-
+#include "CRC_Engine.h"
+#include "Packet.h"
+#include "Journal.h"
+#include "Batch.h"
+#include "I2C_Bus.h"
+#include "EEPROM.h"
+#include "EEPROM_Cache.h"
+#include "Sampler.h"
+#include "Filter.h"
+#include "Format.h"
+#include "Alarm.h"
+
+#if defined(FORMAT_BENCH)
 #include <stdio.h>
+#endif /* FORMAT_BENCH */
 #include <string.h>
 
 #include "Small_7.h"
@@ -15,30 +28,64 @@
 
 /*
 A2
-This program allows the user to read the temperature from the mbed application shield temperature sensor,
+This program reads the temperature from the mbed application shield temperature sensor in the background,
 stores it in the Payload field of a packet of an experimental protocol, writes the packet to EEPROM and 
 reads it back again. 
 The packet has the following fields: MAC dest, MAC src, Length, Payload and FCS.
 The following joystick presses perform the listed functions, after performing a function it flashes a success
 message on the LCD.
-Centre: Read temperature from sensor, store it in Payload field of the packet and calculate CRC value (Nucleo 
-provides a CRC unit for calculating CRC values), then store it in the FCS field of the packet
-Right: Write packet to EEPROM
-Left: Read packet from EEPROM
+Centre: Show the newest temperature sample in the Payload field of the packet
+Right: Append packet to the journal in EEPROM
+Left: Read the newest packet back from the journal in EEPROM
 Up: Display new field of the packet
 Down: Display new field of the packet 
 
+The sensor is read every SAMPLE_PERIOD_US by TIM2 and the I2C1 interrupts (Sampler.c), and the samples are
+queued in a ring which the main loop drains (store_sample): each sample is stored in the Payload field and the CRC
+value is calculated (Nucleo provides a CRC unit for calculating CRC values) and stored in the FCS field. The
+sampling times do not depend on the joystick, the LCD or the EEPROM. The bus is scanned for LM75s at start up and
+all of them are read in each sweep; every sensor has its own stream (filter and batch, tagged with the sensor's
+address when there is more than one sensor), and the first sensor's stream fills the packet on the display. The
+samples pass through a fixed point filter
+(Filter.c: boxcar, EMA or median, SAMPLE_FILTER) in blocks on their way to the packet. Building with FILTER_BENCH
+defined shows the cycles per sample of each filter at start up.
+
+The sensors' over-temperature outputs (OS) share a line wired to an EXTI interrupt (Alarm.c): the thresholds
+(ALARM_TOS, ALARM_THYST) are written to the sensors at start up, and each crossing is queued with its time, so the
+alarm costs nothing while the temperature stays on one side. Every packet filled while the alarm was on has
+PACKET_ALARM_FLAG set in its sample field, and the centre press shows the number of alarms.
+
+The numbers on the LCD are written by Format.c with integer arithmetic instead of sprintf, the temperature from the
+11-bit reading in 0.125 degree steps ("-0.375"). Building with FORMAT_BENCH defined shows the cycles taken by
+sprintf and by Format.c for a temperature and for a hex value at start up.
+
+The LCD driver (LCD_Display.c) only sends the columns of each page that have changed. The main loop draws with the
+flushes deferred and sends each screen in one update at the end of the pass, instead of all 512 bytes after every
+character.
+
+The I2C1 clock (I2C_SPEED) is worked out at run time from the APB1 clock that SystemClock_Config has set. Building
+with I2C_BENCH defined shows the bytes per second of sensor reads and EEPROM sequential reads at 100, 200 and
+400 kHz at start up.
+
 Furthermore, acknowledge polling is used for EEPROM's internal write operation to go between successive page write
-cycles
+cycles. The EEPROM is written from the I2C1 interrupts (EEPROM.c), so the joystick and the sensor keep working
+while a packet is written. All the I2C1 traffic (sensor reads, EEPROM writes and reads) goes through one queue of
+transfer descriptors run from the I2C1 and DMA interrupts (I2C_Bus.c). Each transfer has a deadline; the main
+loop and every wait check it, and a bus held by a glitch or a device out of step is recovered (SCL clocked by
+hand, I2C1 reset) and the transfer retried, so the unit does not hang on the bus. The journal writes go through a
+RAM page cache (EEPROM_Cache.c) which writes the dirty pages back once they are EEPROM_CACHE_MAX_AGE_US old.
+
+In batching mode (batch_mode) each temperature sample is also packed into pl, and the packet is appended to the
+journal once it is full (Batch.c), so there is one FCS and one EEPROM write for many samples. The delta format
+stores the change from the previous read in a few bits, so a slowly changing temperature fits 60-130 samples in a
+packet (25 in the raw format). Right closes a partly filled batch early, and so does Left for the first sensor's
+batch, whose packet the one read back goes into. The FCS of a batch is calculated when the batch is closed.
+
+The FCS is calculated over the packet packed into 15 words (format v1, standard CRC-32/MPEG-2). Packets with the
+older format, where every byte is widened to a word (v0), still pass the FCS check and are shown as "FCS v0 OK".
 */
 
 
-// Temperature Sensor I2C Address
-#define TEMPADR 0x90
-
-// EEPROM I2C Address
-#define EEPROMADR 0xA0
-
 // GPIO
 void configure_gpio(void);
 
@@ -51,32 +98,73 @@ uint32_t joystick_right(void);
 uint32_t joystick_centre(void);
 
 // I2C
+#define I2C_SPEED I2C_SPEED_FAST // SCL, the timing is worked out from the APB1 clock (I2C_Bus.c)
 void i2c_1_configure(void);
-
-// Temperature
-uint16_t read_temperature(void);
-
-// Payload structure (46 byte field)
-struct P {
-	uint16_t sample; // 2 bytes
-	unsigned char pl[44]; // 44 bytes
-}; 
-
-// Packet structure (the members of the structure are the fields of the packet)
-struct Pack {
-	unsigned char MAC_dest[6]; // 6 byte field
-	unsigned char MAC_src[6]; // 6 byte field
-	uint16_t length; //2 byte field
-	struct P payload; // 46 byte field
-	uint32_t FCS; //4 byte field
+void ui_delay(uint32_t us); // Waits for the user with the I2C deadlines still checked (LL_mDelay would hold them off)
+#if defined(I2C_BENCH)
+void i2c_bench(void);
+#endif /* I2C_BENCH */
+
+// Temperature (read in the background by Sampler.c)
+#define SAMPLE_PERIOD_US 1000000
+#define SAMPLE_BLOCK 8 // Samples taken from the sampler and filtered at a time
+#define SAMPLE_FILTER FILTER_MEDIAN // Removes single sample spikes without blurring steps
+#define SAMPLE_FILTER_PARAM 5 // Window (see Filter.h for the other filters)
+void filter_samples(struct Sample* sample, uint32_t n);
+void store_sample(const struct Sample* s);
+#if defined(FILTER_BENCH)
+void filter_bench(void);
+#endif /* FILTER_BENCH */
+
+// Over-temperature alarm (the LM75 OS output, Alarm.c), thresholds in 0.125 degree steps (set in 0.5 degree steps)
+#define ALARM_TOS (30 * 8) // On above 30 degrees
+#define ALARM_THYST (28 * 8) // Off again below 28 degrees
+
+// LCD text (Format.c: integer only, so sprintf and the floating point library are not linked in)
+#if defined(FORMAT_BENCH)
+void format_bench(void);
+#endif /* FORMAT_BENCH */
+
+// EEPROM (writes run from the I2C1 interrupts, so the main loop carries on while the packet is written)
+int eeprom_journal_write(uint16_t address, const unsigned char* data, uint16_t length);
+const struct EEPROM_Ops eeprom_ops = { eeprom_journal_write, eeprom_read, eeprom_wait_ready, eeprom_async_busy };
+
+// Write-back page cache in front of the EEPROM
+#define EEPROM_CACHE_MAX_AGE_US 2000000 // Dirty pages are written back after 2 s
+struct EEPROM_Cache eeprom_cache;
+int eeprom_cached_write(uint16_t address, const unsigned char* data, uint16_t length);
+int eeprom_cached_read(uint16_t address, unsigned char* data, uint16_t length);
+int eeprom_cached_wait(void);
+const struct EEPROM_Ops eeprom_cached_ops = { eeprom_cached_write, eeprom_cached_read, eeprom_cached_wait };
+int eeprom_write_error; // Error of a page write back not yet shown (the page stays dirty and is written again)
+
+// Packet journal in EEPROM
+struct Journal journal;
+
+// Batching of samples in pl
+uint32_t batch_mode = BATCH_FORMAT_DELTA; // BATCH_FORMAT_RAW for 11 bits per sample, 0 for one sample per packet
+
+// Sample stream of each sensor (only the first sensor's samples go into the packet when not batching)
+struct Stream {
+	struct Pack* packet; // Batch being filled
+	uint32_t closed; // The batch has been appended, the next sample starts a new one
+	uint16_t alarm; // PACKET_ALARM_FLAG if the alarm has been on since the last packet was appended (or sample stored)
+	struct Filter filter;
 };
-
-// EEPROM
-void eeprom_write(struct Pack data);
-struct Pack eeprom_read(void);
-
-// CRC calculation function
+struct Stream streams[SAMPLER_MAX_SENSORS];
+struct Pack sensor_packets[SAMPLER_MAX_SENSORS - 1]; // Batches of the other sensors, the first one uses the packet
+uint32_t batch_close(struct Stream* stream);
+
+// CRC calculation functions
+uint32_t fcs_mode = FCS_MODE_PACKED; // FCS format used for new packets (FCS_MODE_LEGACY for the byte-widened format)
+static uint32_t crc_words[FCS_WORDS_MAX]; // Word stream read by the DMA
+void calculate_CRC_start(struct Pack pkt, uint32_t mode);
+int calculate_CRC_try(struct Pack pkt, uint32_t mode, uint32_t* crc);
+uint32_t calculate_CRC_mode(struct Pack pkt, uint32_t mode);
 uint32_t calculate_CRC(struct Pack pkt);
+#define FCS_CHECK_ENGINE_ERROR (-2) // fcs_check: the CRC engine's DMA failed, nothing was checked
+int fcs_check(struct Pack pkt, uint32_t* crc);
+struct FCS_Cache fcs_cache; // FCS state of the constant packet fields, only the sample changes on a temperature read
 		
 int main(void){
     // Init
@@ -90,6 +178,12 @@ int main(void){
 	Clear_Screen();
 	Initialise_LCD_Controller();
 	set_font((unsigned char*) Arial_12);
+#if defined(FILTER_BENCH)
+	filter_bench();
+#endif /* FILTER_BENCH */
+#if defined(FORMAT_BENCH)
+	format_bench();
+#endif /* FORMAT_BENCH */
 		
 	// Configure GPIO
 	configure_gpio();
@@ -98,6 +192,16 @@ int main(void){
 	// Configure I2C and set up the GPIO pins it uses
 	i2c_1_configure(); 
 	
+	// Configure the DMA fed CRC unit
+	crc_engine_configure();
+	
+	// Configure the interrupt driven I2C1 transfers and the EEPROM driver built on them
+	i2c_bus_configure();
+	eeprom_configure();
+	
+	// Configure the timer driven temperature sampling (started once the packet is set up)
+	sampler_configure(SAMPLE_PERIOD_US);
+	
 	// Initializations and declarations
 	char outputString[18]; //Buffer to store text in for LCD
 	struct Pack packet; //Packet
@@ -118,81 +222,155 @@ int main(void){
 	
 	packet.FCS= 0x00; // FCS initialization
 	
+	fcs_cache_prime(&fcs_cache, &packet, fcs_mode, calculate_CRC_mode); // Cache the FCS of the constant fields
+	
+	// Find the newest packet in the EEPROM journal
+	eeprom_cache_init(&eeprom_cache, &eeprom_ops);
+	journal_mount(&journal, &eeprom_cached_ops, EEPROM_SIZE/PACKET_SIZE, calculate_CRC_mode, fcs_mode);
+	
+	// Find the sensors on the bus and give each one a stream (the others' batches have the packet's header fields)
+	sampler_scan();
+#if defined(I2C_BENCH)
+	i2c_bench();
+#endif /* I2C_BENCH */
+	for(uint32_t i=0; i<SAMPLER_MAX_SENSORS; i++){
+		if(i > 0){
+			sensor_packets[i-1] = packet;
+		}
+		streams[i].packet = (i > 0) ? &sensor_packets[i-1] : &packet;
+		streams[i].closed = 1;
+		streams[i].alarm = 0;
+		filter_init(&streams[i].filter, SAMPLE_FILTER, SAMPLE_FILTER_PARAM);
+	}
+	alarm_configure(ALARM_TOS, ALARM_THYST); // Thresholds of the sensors found, crossings come in on EXTI
+	sampler_start();
+	
 	//Display MAC dest:
 	put_string(0,0,"             ");
 	put_string(0,15,"             ");
 	put_string(0,0,"MAC dest:");
 	
 	for(int i=0; i<6; i++){
-	    sprintf(outputString, "%x", packet.MAC_dest[i]); // Print to LCD
+	    format_hex(outputString, packet.MAC_dest[i]); // Print to LCD
 	    put_string(22*i,15,outputString);
 	}
 	
+	Defer_LCD_Flush(1); // The main loop flushes the LCD once per pass
 	int current=1; // Index for 'joystick up' and 'joystick down' (takes values from 1 to 6)
 	//Main Loop
     while (1){
+		i2c_poll(); // Recovers the bus if a transfer has missed its deadline (a sensor read is never waited for)
+		int error = eeprom_cache_poll(&eeprom_cache, micros(), EEPROM_CACHE_MAX_AGE_US); // Write back the old dirty pages
+		if(error){
+			eeprom_write_error = error; // Shown by the next 'joystick right'
+		}
+		
+		// Crossings of the alarm thresholds since the last time round: the packets being filled are stamped even if
+		// the alarm has gone off again
+		uint32_t alarm = alarm_active();
+		struct Alarm_Event event;
+		while(alarm_read(&event)){
+			alarm = 1;
+		}
+		if(alarm){
+			for(uint32_t i=0; i<SAMPLER_MAX_SENSORS; i++){
+				streams[i].alarm = PACKET_ALARM_FLAG;
+			}
+		}
+		
+		struct Sample sample[SAMPLE_BLOCK]; // Samples taken since the last time round
+		uint32_t samples = 0;
+		while(samples < SAMPLE_BLOCK && sampler_read(&sample[samples])){
+			samples++;
+		}
+		filter_samples(sample, samples);
+		for(uint32_t i=0; i<samples; i++){
+			store_sample(&sample[i]);
+		}
+		
 		if(joystick_centre()){			
-			LL_mDelay(100000); // Delay for switch bounce
-				
-			packet.payload.sample = read_temperature(); // Reads temperature sensor
-				
-			// Each time temperature is read, CRC is calculated
-			packet.FCS= calculate_CRC(packet);
+			ui_delay(100000); // Delay for switch bounce
 			
-			put_string(0,0,"             "); // Report successful temperature read
-			put_string(0,0,"Sampled");
+			put_string(0,0,"             "); // Report the samples taken
+			strcpy(outputString, "Sampled ");
+			format_uint(outputString + 8, batch_mode ? batch_count(&packet) : sampler_stats()->samples);
+			put_string(0,0,outputString);
 			put_string(0,15,"             ");
+			strcpy(outputString, "Alarms ");
+			format_uint(outputString + 7, alarm_stats()->raised); // Crossings above Tos since start up
+			put_string(0,15,outputString);
 				
-			LL_mDelay(500000);
+			Flush_LCD(); // Shown for the delay
+			ui_delay(500000);
 			
 			put_string(0,0,"             ");
 			put_string(0,15,"             ");
-			put_string (0,0, "Temp:");
-			sprintf(outputString, "%f", packet.payload.sample*0.125f); // Print temperature to LCD
+			put_string (0,0, (packet.payload.sample & PACKET_ALARM_FLAG) ? "Temp: ALARM" : "Temp:");
+			format_temperature(outputString, packet.payload.sample); // Print temperature to LCD
 			put_string(0,15,outputString);
 			current=4; // It is showing the payload sample so the index is set accordingly
 		} 
 			
 		else if(joystick_right()){
-			LL_mDelay(100000); // Delay for switch bounce
+			ui_delay(100000); // Delay for switch bounce
 				
-			eeprom_write(packet); // Write packet to EEPROM
+			uint32_t written = 1;
+			if(batch_mode){
+				written = 0;
+				for(uint32_t i=0; i<sampler_sensors(); i++){
+					written |= batch_close(&streams[i]); // Append the (partly filled) batches to the journal in EEPROM
+				}
+			}
+			else{
+				journal_append(&journal, &packet); // Append packet to the journal in EEPROM
+			}
 			
 			put_string(0,0,"             "); // Report successful write
-			put_string(0,0,"Written");
+			put_string(0,0,(eeprom_write_error || journal.error) ? "Write error" : written ? "Written" : "Nothing new");
+			eeprom_write_error = 0;
 			put_string(0,15,"             ");
 				
-			LL_mDelay(500000);
+			Flush_LCD(); // Shown for the delay
+			ui_delay(500000);
 			
 			put_string(0,0,"             ");
 			put_string(0,15,"             ");
 			put_string(0,0, "Temp:");
-			sprintf(outputString, "%f", packet.payload.sample*0.125f); // Print temperature to LCD
+			format_temperature(outputString, packet.payload.sample); // Print temperature to LCD
 			put_string(0,15,outputString);
 			current=4; // It is showing the payload sample so the index is set accordingly
 		} 
 
 		else if(joystick_left()){
-			LL_mDelay(100000); // Delay for switch bounce
+			ui_delay(100000); // Delay for switch bounce
 				
-			packet = eeprom_read(); // Read packet from EEPROM
-			
 			put_string(0,0,"             "); // Report success read
-			put_string(0,0,"Retrieved");
 			put_string(0,15,"             ");
+			if(batch_mode){
+				batch_close(&streams[0]); // Its batch is in the packet, append the samples before it is read over
+			}
+			if(journal_read_last(&journal, &packet, 1)){ // Read newest packet from the journal in EEPROM
+				fcs_cache_prime(&fcs_cache, &packet, fcs_mode, calculate_CRC_mode); // The constant fields may have changed
+				streams[0].closed = 1; // Sampling starts a new batch rather than adding to the one read back
+				put_string(0,0,"Retrieved");
+			}
+			else{
+				put_string(0,0,journal.error ? "Read error" : "No packets");
+			}
 				
-			LL_mDelay(500000);
+			Flush_LCD(); // Shown for the delay
+			ui_delay(500000);
 			
 			put_string(0,0,"             ");
 			put_string(0,15,"             ");
 			put_string(0,0, "Temp:");
-			sprintf(outputString, "%f", packet.payload.sample*0.125f); // Print transferred payload sample to LCD 
+			format_temperature(outputString, packet.payload.sample); // Print transferred payload sample to LCD 
 			put_string(0,15,outputString);
 			current=4; // It is showing the payload sample so the index is set accordingly
 		}
 		
 		else if(joystick_down()){
-			LL_mDelay(100000); // Delay for switch bounce
+			ui_delay(100000); // Delay for switch bounce
 			 
 			// current=1 means the current field is MAC dest 
 			if (current==1){
@@ -200,7 +378,7 @@ int main(void){
                 put_string(0,15,"             ");
                 put_string(0,0,"MAC src:");
                 for(int m=0; m<6; m++){
-                    sprintf(outputString, "%x", packet.MAC_src[m]); // Print MAC src to LCD
+                    format_hex(outputString, packet.MAC_src[m]); // Print MAC src to LCD
                     put_string(22*m,15,outputString);
                 }
 		    	current++;  // Current field is now MAC src
@@ -211,7 +389,7 @@ int main(void){
                 put_string(0,0,"             ");
                 put_string(0,15,"             ");
                 put_string(0,0,"Length:");
-                sprintf(outputString, "%x", packet.length ); // Print length to LCD
+                format_hex(outputString, packet.length); // Print length to LCD
                 put_string(0,15,outputString);
 			    current++; // Current field is now Length
             } 
@@ -221,7 +399,7 @@ int main(void){
                 put_string(0,0,"             ");
                 put_string(0,15,"             ");
                 put_string(0,0,"Temp:");
-                sprintf(outputString, "%f", packet.payload.sample*0.125f); // Print payload sample to LCD 
+                format_temperature(outputString, packet.payload.sample); // Print payload sample to LCD 
                 put_string(0,15,outputString);
 			    current++; // Current field is now Payload
             } 
@@ -231,7 +409,7 @@ int main(void){
                 put_string(0,0,"             ");
                 put_string(0,15,"             ");
                 put_string(0,0,"FCS:");
-                sprintf(outputString, "%x", packet.FCS); // Print FCS to LCD 
+                format_hex(outputString, packet.FCS); // Print FCS to LCD 
                 put_string(0,15,outputString);
                 current++; // Current field is now FCS
 			}
@@ -240,20 +418,25 @@ int main(void){
 			else if (current==5){
 			    uint32_t variable=0; // Variable that holds the newly calculated CRC
                 // Recalculate CRC
-                variable =calculate_CRC(packet);
+                int version =fcs_check(packet, &variable);
                     
-                if(variable==packet.FCS){
+                if(version>=0){
                     put_string(0,0,"             ");
                     put_string(0,15,"             ");
-                    put_string(0,0,"FCS check OK:");
-                    sprintf(outputString, "%x", variable); // Print CRC field to LCD 
+                    put_string(0,0,(version==FCS_MODE_LEGACY) ? "FCS v0 OK:" : "FCS check OK:");
+                    format_hex(outputString, packet.FCS); // Print CRC field to LCD 
                     put_string(0,15,outputString);
                 }
-                else if (variable!=packet.FCS){
+                else if(version==FCS_CHECK_ENGINE_ERROR){
+                    put_string(0,0,"             ");
+                    put_string(0,15,"             ");
+                    put_string(0,0,"CRC DMA error"); // The FCS could not be checked
+                }
+                else{
                     put_string(0,0,"             ");
                     put_string(0,15,"             ");
                     put_string(0,0,"FCS ERROR:");
-                    sprintf(outputString, "%x", variable); // Print CRC field to LCD 
+                    format_hex(outputString, variable); // Print CRC field to LCD 
                     put_string(0,15,outputString);
                 }
                 current++;
@@ -263,20 +446,25 @@ int main(void){
 			else if (current==6){
                 uint32_t variable=0; // Variable that holds the newly calculated CRC
                 // Recalculate CRC
-                variable =calculate_CRC(packet);
+                int version =fcs_check(packet, &variable);
                     
-                if(variable==packet.FCS){
+                if(version>=0){
                     put_string(0,0,"             ");
                     put_string(0,15,"             ");
-                    put_string(0,0,"FCS check OK:");
-                    sprintf(outputString, "%x", variable); // Print CRC field to LCD 
+                    put_string(0,0,(version==FCS_MODE_LEGACY) ? "FCS v0 OK:" : "FCS check OK:");
+                    format_hex(outputString, packet.FCS); // Print CRC field to LCD 
                     put_string(0,15,outputString);
                 }
-                else if (variable!=packet.FCS){
+                else if(version==FCS_CHECK_ENGINE_ERROR){
+                    put_string(0,0,"             ");
+                    put_string(0,15,"             ");
+                    put_string(0,0,"CRC DMA error"); // The FCS could not be checked
+                }
+                else{
                     put_string(0,0,"             ");
                     put_string(0,15,"             ");
                     put_string(0,0,"FCS ERROR:");
-                    sprintf(outputString, "%x", variable); // Print CRC field to LCD 
+                    format_hex(outputString, variable); // Print CRC field to LCD 
                     put_string(0,15,outputString);
                 }
 		}
@@ -284,7 +472,7 @@ int main(void){
 	}
 		 
 		else if(joystick_up()){
-			LL_mDelay(100000); // Delay for switch bounce
+			ui_delay(100000); // Delay for switch bounce
 			 
 			// current=1 means current field is MAC dest 
 			if (current==1){
@@ -292,7 +480,7 @@ int main(void){
                 put_string(0,15,"             ");
                 put_string(0,0,"MAC dest:");
                 for(int m=0; m<6; m++){
-                    sprintf(outputString, "%x", packet.MAC_dest[m]); // Print MAC dest to LCD
+                    format_hex(outputString, packet.MAC_dest[m]); // Print MAC dest to LCD
                     put_string(22*m,15,outputString);
                 }
 			}
@@ -303,7 +491,7 @@ int main(void){
                 put_string(0,15,"             ");
                 put_string(0,0,"MAC dest:");
                 for(int m=0; m<6; m++){
-                    sprintf(outputString, "%x", packet.MAC_dest[m]); // Print MAC dest to LCD
+                    format_hex(outputString, packet.MAC_dest[m]); // Print MAC dest to LCD
                     put_string(22*m,15,outputString);
                     }
                 current--; // Current is now MAC dest
@@ -315,7 +503,7 @@ int main(void){
                 put_string(0,15,"             ");
                 put_string(0,0,"MAC src:");
                 for(int m=0; m<6; m++){
-                    sprintf(outputString, "%x", packet.MAC_src[m]); // Print MAC src to LCD
+                    format_hex(outputString, packet.MAC_src[m]); // Print MAC src to LCD
                     put_string(22*m,15,outputString);
                 }
                 current--; // Current field is now MAC src
@@ -326,7 +514,7 @@ int main(void){
                 put_string(0,0,"             ");
                 put_string(0,15,"             ");
                 put_string(0,0, "Length:");
-                sprintf(outputString, "%x", packet.length ); // Print length to LCD
+                format_hex(outputString, packet.length); // Print length to LCD
                 put_string(0,15,outputString);
                 current--; // Current field is now Length
             }
@@ -336,7 +524,7 @@ int main(void){
 			put_string(0,0,"             ");
 			put_string(0,15,"             ");
 			put_string(0,0, "Temp:");
-			sprintf(outputString, "%f", packet.payload.sample*0.125f); // Print temperature to LCD
+			format_temperature(outputString, packet.payload.sample); // Print temperature to LCD
 			put_string(0,15,outputString);
 			current--; // Current field is now Payload
             } 
@@ -346,12 +534,13 @@ int main(void){
 			put_string(0,0,"             ");
 			put_string(0,15,"             ");
 			put_string(0,0, "FCS:");
-			sprintf(outputString, "%x", packet.FCS ); // Print FCS to LCD
+			format_hex(outputString, packet.FCS); // Print FCS to LCD
 			put_string(0,15,outputString);
 			current--; // Current field is now FCS
             }
 			 
 		}
+		Flush_LCD(); // The screen drawn this time round, in one update
 	}
 }
 
@@ -383,7 +572,7 @@ void i2c_1_configure(void){
   
     LL_I2C_Disable(I2C1);
     LL_I2C_SetMode(I2C1, LL_I2C_MODE_I2C);
-    LL_I2C_ConfigSpeed(I2C1, 84000000, 400000, LL_I2C_DUTYCYCLE_2);
+    i2c_bus_set_speed(I2C_SPEED); // From the APB1 clock as SystemClock_Config has set it
     LL_I2C_Enable(I2C1);
 }	
 
@@ -431,326 +620,291 @@ uint32_t joystick_centre(void) {
 	return (LL_GPIO_IsInputPinSet(GPIOB, LL_GPIO_PIN_5));
 }
 
-uint32_t calculate_CRC(struct Pack pkt) {
-	//Calculate CRC value
-	
-	//Reset the CRC unit before use
-	LL_CRC_ResetCRCCalculationUnit(CRC);
-	
-	//Packet is processed in 'units' of four bytes
-	for(int i=0;i<4;i++){
-	    LL_CRC_FeedData32(CRC, pkt.MAC_dest[i]);
-	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	for(int i=4;i<6;i++){
-	    LL_CRC_FeedData32(CRC, pkt.MAC_dest[i]);
-	}
-	for(int i=0;i<2;i++){
-	    LL_CRC_FeedData32(CRC, pkt.MAC_src[i]);
-	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	for(int i=2;i<6;i++){
-	    LL_CRC_FeedData32(CRC, pkt.MAC_src[i]);
+void ui_delay(uint32_t us){
+	// Switch bounce and messages left on the LCD: the sampler keeps reading the sensors meanwhile, and a transfer
+	// that misses its deadline is only noticed by i2c_poll
+	uint32_t start = micros();
+	while(micros() - start < us){
+		i2c_poll();
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	LL_CRC_FeedData32(CRC, pkt.length);
-	LL_CRC_FeedData32(CRC, pkt.payload.sample);
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	for(int i=0; i<4; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
-	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	for(int i=4; i<8; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
-	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
+}
+
+void calculate_CRC_start(struct Pack pkt, uint32_t mode){
+	//Starts the CRC calculation of the packet, the result is collected with crc_engine_wait()
+	uint32_t n; // Number of words fed to the CRC unit
 	
-	for(int i=8; i<12; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
+	crc_engine_wait(0); // crc_words is still being read by the DMA until the previous calculation finishes
+	n= packet_fcs_words(&pkt, mode, crc_words);
+	crc_engine_start(crc_words, n, 0);
+}
+
+int calculate_CRC_try(struct Pack pkt, uint32_t mode, uint32_t* crc){
+	//Calculate CRC value in the given FCS format, returns 0 or CRC_ENGINE_ERROR ('crc' is then not valid)
+	calculate_CRC_start(pkt, mode);
+	return crc_engine_wait(crc);
+}
+
+uint32_t calculate_CRC_mode(struct Pack pkt, uint32_t mode){
+	//Calculate CRC value in the given FCS format. The FCS written into packets must be right, so a failed DMA
+	//transfer is done again from the CPU
+	uint32_t crc;
+	if(calculate_CRC_try(pkt, mode, &crc)){
+		crc = crc_engine_feed(crc_words, packet_fcs_words(&pkt, mode, crc_words));
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	for(int i=12; i<16; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
+	return crc;
+}
+
+uint32_t calculate_CRC(struct Pack pkt) {
+	//Calculate CRC value in the current FCS format
+	return calculate_CRC_mode(pkt, fcs_mode);
+}
+
+int fcs_check(struct Pack pkt, uint32_t* crc){
+	//Checks the FCS field against the current format first and then the other one, so packets written 
+	//in either format still verify. Returns the matching FCS mode, -1, or FCS_CHECK_ENGINE_ERROR if a CRC could
+	//not be calculated (a DMA error is not taken as a bad FCS). 'crc' gets the current format CRC
+	if(calculate_CRC_try(pkt, fcs_mode, crc)){
+		return FCS_CHECK_ENGINE_ERROR;
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	for(int i=16; i<20; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
+	if(*crc == pkt.FCS){
+		return fcs_mode;
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
 	
-	
-	for(int i=20; i<24; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
+	uint32_t other = (fcs_mode == FCS_MODE_PACKED) ? FCS_MODE_LEGACY : FCS_MODE_PACKED;
+	uint32_t other_crc;
+	if(calculate_CRC_try(pkt, other, &other_crc)){
+		return FCS_CHECK_ENGINE_ERROR;
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	for(int i=24; i<28; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
+	if(other_crc == pkt.FCS){
+		return other;
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
+	return -1;
+}
+
+void filter_samples(struct Sample* sample, uint32_t n){
+	// Runs the samples of each sensor through its stream's filter, as a block
+	int16_t value[SAMPLE_BLOCK];
 	
-	for(int i=28; i<32; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
+	for(uint32_t sensor=0; sensor<sampler_sensors(); sensor++){
+		uint32_t m = 0;
+		for(uint32_t i=0; i<n; i++){
+			if(sample[i].sensor == sensor){
+				value[m++] = FILTER_FROM_LM75(sample[i].value);
+			}
+		}
+		filter_block(&streams[sensor].filter, value, value, m);
+		m = 0;
+		for(uint32_t i=0; i<n; i++){
+			if(sample[i].sensor == sensor){
+				sample[i].value = FILTER_TO_LM75(value[m++]);
+			}
+		}
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	for(int i=32; i<36; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
+}
+
+static void batch_open(struct Stream* stream, uint32_t sensor){
+	// Starts a new batch in the stream, tagged with the sensor when there are several
+	batch_clear(stream->packet, batch_mode);
+	if(sampler_sensors() > 1){
+		batch_set_sensor(stream->packet, sampler_sensor_address(sensor));
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
+	stream->closed = 0;
+}
+
+void store_sample(const struct Sample* s){
+	// Adds a sample to its sensor's batch, or stores it in the payload and updates the FCS
+	struct Stream* stream = &streams[s->sensor];
+	struct Pack* pkt = stream->packet;
 	
-	for(int i=36; i<40; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
+	if(batch_mode){
+		if(stream->closed){
+			batch_open(stream, s->sensor);
+		}
+		if(batch_add(pkt, s->value, s->time_us) == 0){ // Also sets the payload sample
+			// The change is too big for the room left, append the batch and start the next one with it
+			batch_close(stream);
+			batch_open(stream, s->sensor);
+			batch_add(pkt, s->value, s->time_us);
+		}
+		pkt->payload.sample |= stream->alarm;
+		if(batch_full(pkt)){
+			batch_close(stream); // The batch is full, append it to the journal
+		}
+		return;
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
-	
-	
-	for(int i=40; i<44; i++){
-	    LL_CRC_FeedData32(CRC, pkt.payload.pl[i]);
+	if(s->sensor != 0){
+		return;
 	}
-	delay_us(100); // Short delay that allows the CRC to be computed
 	
+	pkt->payload.sample = s->value | stream->alarm;
+	stream->alarm = alarm_active() ? PACKET_ALARM_FLAG : 0;
 	
-	return LL_CRC_ReadData32(CRC);
+	// Each time temperature is read, CRC is calculated (only the sample changed, so the cached FCS is updated)
+	pkt->FCS= fcs_cache_update(&fcs_cache, pkt->payload.sample);
+#if defined(USE_FULL_ASSERT)
+	assert_param(pkt->FCS == calculate_CRC(*pkt)); // Must match recalculating over the whole packet
+#endif /* USE_FULL_ASSERT */
 }
-void eeprom_write(struct Pack data){
-	//Writes packet to the EEPROM
-	int i; // Index for loops
-	
-	LL_I2C_GenerateStartCondition(I2C1); //START
-    while(!LL_I2C_IsActiveFlag_SB(I2C1));
-	
-    LL_I2C_TransmitData8(I2C1, EEPROMADR); //CONTROL BYTE (ADDRESS + WRITE)
-    while(!LL_I2C_IsActiveFlag_ADDR(I2C1));
-    LL_I2C_ClearFlag_ADDR(I2C1);
 
-    LL_I2C_TransmitData8(I2C1, 0x00); //ADDRESS HIGH BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-
-    LL_I2C_TransmitData8(I2C1, 0x00); //ADDRESS LOW BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-				
-	//Writing MAC Destination Address
-	for(i=0; i<6; i++){
-        LL_I2C_TransmitData8(I2C1, (unsigned char)(data.MAC_dest[i]));  
-        while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-	}
-				
-	//Writing MAC Source Address
-	for(i=0; i<6; i++){
-        LL_I2C_TransmitData8(I2C1, (unsigned char)(data.MAC_src[i])); 
-        while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-	}
-				
-	//Writing Length
-    LL_I2C_TransmitData8(I2C1, (unsigned char)(data.length >> 8)); //LENGTH HIGH BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
+int eeprom_journal_write(uint16_t address, const unsigned char* data, uint16_t length){
+	// Journal writes return straight away, the journal calls eeprom_wait_ready before reusing its buffer (which
+	// returns the write's error)
+	eeprom_write_async(address, data, length, 0);
+	return 0;
+}
 
-	LL_I2C_TransmitData8(I2C1, (unsigned char)(data.length & 0x00FF)); //LENGTH LOW BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-				
-	//Writing Payload sample
-	LL_I2C_TransmitData8(I2C1, (unsigned char)(data.payload.sample >> 8)); //TEMPERATURE HIGH BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
+int eeprom_cached_write(uint16_t address, const unsigned char* data, uint16_t length){
+	return eeprom_cache_write(&eeprom_cache, address, data, length);
+}
 
-	LL_I2C_TransmitData8(I2C1, (unsigned char)(data.payload.sample & 0x00FF)); //TEMPERATURE LOW BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-				
-	//Writing pl of Payload until cache is full
-	for(i=0; i<16; i++){
-        LL_I2C_TransmitData8(I2C1, (unsigned char)(data.payload.pl[i])); 
-        while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-	}
-				
-	LL_I2C_GenerateStopCondition(I2C1); //STOP
-				
-	//ACKNOWLEDGE POLLING
-	do{
-		LL_I2C_ClearFlag_AF (I2C1); //clear AF flag
-		LL_I2C_GenerateStartCondition(I2C1); //START
-        while(!LL_I2C_IsActiveFlag_SB(I2C1)); //wait until complete
-	
-        LL_I2C_TransmitData8(I2C1, EEPROMADR); //CONTROL BYTE (ADDRESS + WRITE)
-					
-		delay_us(5000); //wait for small delay for EEPROM to respond
-	}
-	while(!LL_I2C_IsActiveFlag_AF (I2C1));
-				
-	LL_I2C_GenerateStartCondition(I2C1); //START
-    while(!LL_I2C_IsActiveFlag_SB(I2C1));
-	
-    LL_I2C_TransmitData8(I2C1, EEPROMADR); //CONTROL BYTE (ADDRESS + WRITE)
-    while(!LL_I2C_IsActiveFlag_ADDR(I2C1));
-    LL_I2C_ClearFlag_ADDR(I2C1);
+int eeprom_cached_read(uint16_t address, unsigned char* data, uint16_t length){
+	return eeprom_cache_read(&eeprom_cache, address, data, length);
+}
 
-    LL_I2C_TransmitData8(I2C1, 0x00); //ADDRESS HIGH BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
+int eeprom_cached_wait(void){
+	return eeprom_cache_wait(&eeprom_cache);
+}
 
-    LL_I2C_TransmitData8(I2C1, 0x00+32); //ADDRESS LOW BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-				
-	//Writing rest of pl of Payload 
-	for(int i=16; i<44; i++){
-        LL_I2C_TransmitData8(I2C1, (unsigned char)(data.payload.pl[i])); 
-        while(!LL_I2C_IsActiveFlag_TXE(I2C1));
+uint32_t batch_close(struct Stream* stream){
+	// Calculates the FCS of the stream's batch and appends it to the journal in EEPROM, returns 0 if there was
+	// nothing new to append
+	struct Pack* pkt = stream->packet;
+	if(stream->closed || batch_count(pkt) == 0){
+		return 0;
 	}
-				
-	LL_I2C_TransmitData8(I2C1, (unsigned char)(data.FCS >> 24)); //FIRST FCS BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-				
-	LL_I2C_TransmitData8(I2C1, (unsigned char)(data.FCS >> 16)); //SECOND FCS BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-				
-	LL_I2C_TransmitData8(I2C1, (unsigned char)(data.FCS>> 8)); //THIRD FCS BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-			
-	LL_I2C_TransmitData8(I2C1, (unsigned char)(data.FCS)); //FOURTH FCS BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-				
-    LL_I2C_GenerateStopCondition(I2C1); //STOP
+	pkt->FCS = calculate_CRC(*pkt);
+	journal_append(&journal, pkt);
+	stream->closed = 1;
+	stream->alarm = alarm_active() ? PACKET_ALARM_FLAG : 0; // The next batch starts from the line as it is now
+	return 1;
 }
 
-uint16_t read_temperature(void){
-	//Reads the 11 bit temperature value from the 2 byte temperature register
+#if defined(FILTER_BENCH)
+void filter_bench(void){
+	// Shows the cycles per sample of each filter over a block of samples, measured with the DWT cycle counter
+	static int16_t in[256];
+	static int16_t out[256];
+	static const uint32_t settings[4][2] = {
+		{ FILTER_BOXCAR, 3 }, { FILTER_EMA, 8192 }, { FILTER_MEDIAN, 5 }, { FILTER_MEDIAN, 9 }
+	};
+	static char names[4][6] = { "Box8", "EMA", "Med5", "Med9" };
+	struct Filter f;
+	char outputString[18];
+	
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	for(int i=0; i<256; i++){
+		in[i] = (int16_t)(22 * 8 + (i * 7) % 5 - 2);
+	}
 	
-	uint16_t temperature = 0;
-  
-	LL_I2C_GenerateStartCondition(I2C1); //START
-    while(!LL_I2C_IsActiveFlag_SB(I2C1));
-
-	LL_I2C_TransmitData8(I2C1, TEMPADR); //CONTROL BYTE (ADDRESS + READ)
-    while(!LL_I2C_IsActiveFlag_ADDR(I2C1));
-    LL_I2C_ClearFlag_ADDR(I2C1);
-
-    LL_I2C_TransmitData8(I2C1, 0x00); //Set pointer register to temperature register
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-
-	LL_I2C_GenerateStartCondition(I2C1); //RE-START
-    while(!LL_I2C_IsActiveFlag_SB(I2C1));
-
-	LL_I2C_TransmitData8(I2C1, TEMPADR+1); //ADDRESS + READ
-	while(!LL_I2C_IsActiveFlag_ADDR(I2C1));
-    LL_I2C_ClearFlag_ADDR(I2C1);
-
-    LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
-    while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-    temperature = LL_I2C_ReceiveData8(I2C1);  //TEMPERATURE HIGH BYTE
-	temperature = temperature << 8;
-
-	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_NACK); //NACK INCOMING DATA
-	while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-    temperature += LL_I2C_ReceiveData8(I2C1);  //TEMPERATURE LOW BYTE
-
-    LL_I2C_GenerateStopCondition(I2C1);       //STOP
-
-	return temperature >> 5; //Bit shift temperature right, since it's stored in the upper part of the 16 bits, originally.
+	for(int i=0; i<4; i++){
+		filter_init(&f, settings[i][0], settings[i][1]);
+		filter_block(&f, in, out, 1); // Prime the history outside the measurement
+		uint32_t start = DWT->CYCCNT;
+		filter_block(&f, in, out, 256);
+		uint32_t cycles = DWT->CYCCNT - start;
+		
+		put_string(0,0,"             ");
+		put_string(0,15,"             ");
+		put_string(0,0,names[i]);
+		uint32_t length = format_uint(outputString, cycles / 256);
+		outputString[length++] = '.';
+		length += format_uint(outputString + length, cycles * 10 / 256 % 10);
+		strcpy(outputString + length, " cyc/smp");
+		put_string(0,15,outputString);
+		ui_delay(1000000);
+	}
 }
-
-struct Pack eeprom_read(void){
-	// Reads two bytes from the EEPROM
-	struct Pack data; // Received packet
-	int i; // Index for loops
-	uint32_t var; // Variable used for FCS reading
-	
-	LL_I2C_GenerateStartCondition(I2C1); //START
-    while(!LL_I2C_IsActiveFlag_SB(I2C1));
-
-    LL_I2C_TransmitData8(I2C1, EEPROMADR); //CONTROL BYTE (ADDRESS + WRITE)
-    while(!LL_I2C_IsActiveFlag_ADDR(I2C1));
-    LL_I2C_ClearFlag_ADDR(I2C1);
-
-    LL_I2C_TransmitData8(I2C1, 0x00); //ADDRESS HIGH BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-
-	LL_I2C_TransmitData8(I2C1, 0x00); //ADDRESS LOW BYTE
-    while(!LL_I2C_IsActiveFlag_TXE(I2C1));
-
-	LL_I2C_GenerateStartCondition(I2C1); //RE-START
-    while(!LL_I2C_IsActiveFlag_SB(I2C1));
-
-    LL_I2C_TransmitData8(I2C1, EEPROMADR+1); //ADDRESS + READ
-    while(!LL_I2C_IsActiveFlag_ADDR(I2C1));
-    LL_I2C_ClearFlag_ADDR(I2C1);
-	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
-	
-	// Reading MAC Destination Address
-	for(int i=0; i<6; i++){
-		while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-        data.MAC_dest[i] = LL_I2C_ReceiveData8(I2C1); 
-		LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
+#endif /* FILTER_BENCH */
+
+#if defined(FORMAT_BENCH)
+void format_bench(void){
+	// Shows the cycles taken to write a temperature and a hex value with sprintf and with Format.c, measured with
+	// the DWT cycle counter over every temperature reading (the sensor and the floating point are as on the LCD)
+	static char names[4][13] = { "sprintf %f", "format_temp", "sprintf %x", "format_hex" };
+	uint32_t cycles[4] = { 0, 0, 0, 0 };
+	char text[18];
+	char outputString[18];
+	
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	for(uint32_t v=0; v<0x800; v++){
+		uint32_t start = DWT->CYCCNT;
+		sprintf(text, "%f", v*0.125f);
+		uint32_t t1 = DWT->CYCCNT;
+		format_temperature(text, (uint16_t)v);
+		uint32_t t2 = DWT->CYCCNT;
+		sprintf(text, "%x", v * 0x9E3779B1u);
+		uint32_t t3 = DWT->CYCCNT;
+		format_hex(text, v * 0x9E3779B1u);
+		uint32_t t4 = DWT->CYCCNT;
+		cycles[0] += t1 - start;
+		cycles[1] += t2 - t1;
+		cycles[2] += t3 - t2;
+		cycles[3] += t4 - t3;
 	}
 	
-	// Reading MAC Source Address
-	for(int i=0; i<6; i++){
-        while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-        data.MAC_src[i] = LL_I2C_ReceiveData8(I2C1); 
-		LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
+	for(int i=0; i<4; i++){
+		put_string(0,0,"             ");
+		put_string(0,15,"             ");
+		put_string(0,0,names[i]);
+		uint32_t length = format_uint(outputString, cycles[i] / 0x800);
+		strcpy(outputString + length, " cyc");
+		put_string(0,15,outputString);
+		ui_delay(1000000);
 	}
-	
-	// Reading Length
-    while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-	data.length = LL_I2C_ReceiveData8(I2C1); //LENGTH HIGH BYTE
-	data.length += data.length << 8;
-	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
-
-	while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-	data.length += LL_I2C_ReceiveData8(I2C1);  //LENGTH LOW BYTE
-	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
-
-	// Reading temperature sample
-	while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-    data.payload.sample = LL_I2C_ReceiveData8(I2C1); //TEMPERATURE HIGH BYTE
-	data.payload.sample = data.payload.sample << 8;
-	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
-
-	while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-	data.payload.sample += LL_I2C_ReceiveData8(I2C1);  //TEMPERATURE LOW BYTE
-	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
-	
-	// Reading pl of the Payload (the zeros)
-	for(i=0; i<44; i++){
-        while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-        data.payload.pl[i] = LL_I2C_ReceiveData8(I2C1); 
-	    LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
+}
+#endif /* FORMAT_BENCH */
+
+#if defined(I2C_BENCH)
+void i2c_bench(void){
+	// Shows the bytes per second at each bus speed of sensor reads (the two bytes of a fast read of the first
+	// sensor, one transfer at a time) and of an EEPROM sequential read, measured with the DWT cycle counter
+	static const uint32_t speeds[3] = { I2C_SPEED_STANDARD, 200000, I2C_SPEED_FAST };
+	static unsigned char data[2048];
+	static struct I2C_Transfer read;
+	uint32_t rate[2];
+	char outputString[18];
+	
+	for(int i=0; i<3; i++){
+		uint32_t khz = i2c_bus_set_speed(speeds[i]) / 1000;
+		
+		// The sensor's pointer is still on the temperature register, sampler_scan only addresses it
+		read.address = (uint8_t)sampler_sensor_address(0);
+		read.flags = 0;
+		read.priority = I2C_PRIORITY_HIGH;
+		read.cmd_length = 0;
+		read.tx_length = 0;
+		read.rx = data;
+		read.rx_length = 2;
+		read.done = 0;
+		uint32_t start = DWT->CYCCNT;
+		for(int n=0; n<200; n++){
+			i2c_submit(&read, 1);
+			i2c_wait(&read);
+		}
+		rate[0] = (uint32_t)((uint64_t)(200 * 2) * SystemCoreClock / (DWT->CYCCNT - start));
+		
+		start = DWT->CYCCNT;
+		eeprom_read(0, data, sizeof(data));
+		rate[1] = (uint32_t)((uint64_t)sizeof(data) * SystemCoreClock / (DWT->CYCCNT - start));
+		
+		for(int k=0; k<2; k++){
+			put_string(0,0,"             ");
+			put_string(0,15,"             ");
+			strcpy(outputString, k ? "EE " : "LM75 ");
+			uint32_t length = strlen(outputString);
+			length += format_uint(outputString + length, khz);
+			strcpy(outputString + length, " kHz");
+			put_string(0,0,outputString);
+			length = format_uint(outputString, rate[k]);
+			strcpy(outputString + length, " B/s");
+			put_string(0,15,outputString);
+			ui_delay(1000000);
+		}
 	}
-	// Reading FCS value
-	while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-	data.FCS = LL_I2C_ReceiveData8(I2C1); //FCS FIRST BYTE
-	data.FCS = data.FCS<< 24;
-	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
-	
-	while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-    var = LL_I2C_ReceiveData8(I2C1); //FCS SECOND BYTE
-	data.FCS += var<< 16;
-	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
-	
-	while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-    var = LL_I2C_ReceiveData8(I2C1); //FCS THIRD BYTE
-	data.FCS += var<< 8;
-	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_NACK); //NACK INCOMING DATA
-	
-	while(!LL_I2C_IsActiveFlag_RXNE(I2C1));
-	data.FCS += LL_I2C_ReceiveData8(I2C1);  //FCS FOURTH BYTE
-	
-	LL_I2C_GenerateStopCondition(I2C1); //STOP
-	return data;
+	i2c_bus_set_speed(I2C_SPEED);
 }
+#endif /* I2C_BENCH */
@@ -0,0 +1,176 @@
+#include "Batch_Decode.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_DECODE_HAVE_X86 1
+#endif
+
+/*
+Batch Decode
+Two implementations, picked at run time by batch_decode_records:
+ - scalar: each record is parsed and decoded by batch_decode from the board's Batch.c
+ - AVX2: the samples of a record are all the same width, so sample i starts at a known bit. Eight lanes gather the
+   4 bytes holding their sample, swap them to big-endian and shift the sample out. Deltas are then zigzag decoded
+   and turned back into samples with a prefix sum across the lanes, carried on from the previous eight.
+'records' holds 'n' serialised packets (PACKET_SIZE bytes each), 'samples' must have room for
+BATCH_DELTA_MAX_SAMPLES per record. Records that hold no batch give no samples.
+*/
+
+static uint32_t record_count(const unsigned char* pl, uint32_t* format, uint32_t* width){
+	// Format, delta width and sample count from the header of a batch
+	uint32_t header = pl[BATCH_HEADER_OFFSET];
+	*format = header & BATCH_FORMAT_MASK;
+	*width = header & BATCH_WIDTH_MASK;
+	if(*format == BATCH_FORMAT_RAW){
+		return header & BATCH_COUNT_MASK;
+	}
+	if(*format == BATCH_FORMAT_DELTA){
+		return pl[BATCH_DELTA_COUNT_OFFSET];
+	}
+	return 0;
+}
+
+static uint32_t decode_scalar(const unsigned char* records, uint32_t n, uint16_t* samples){
+	uint32_t total = 0;
+	for(uint32_t r=0; r<n; r++){
+		struct Pack pkt;
+		packet_parse(records + (size_t)r * PACKET_SIZE, &pkt);
+		total += batch_decode(&pkt, samples + total);
+	}
+	return total;
+}
+
+#if defined(BATCH_DECODE_HAVE_X86)
+
+__attribute__((target("avx2")))
+static inline __m256i unpack8(const unsigned char* data, __m256i bits, uint32_t width, __m256i valid){
+	// Reads the 'width' bit field (most significant bit first) at each lane's bit offset
+	static const unsigned char swap[32] = { 3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12, 3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12 };
+	__m256i bytes = _mm256_srli_epi32(bits, 3);
+	__m256i word = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)data, bytes, valid, 1);
+	word = _mm256_shuffle_epi8(word, _mm256_loadu_si256((const __m256i*)swap)); // Big-endian
+	word = _mm256_sllv_epi32(word, _mm256_and_si256(bits, _mm256_set1_epi32(7))); // Field at the top
+	return _mm256_srlv_epi32(word, _mm256_set1_epi32((int)(32 - width))); // A shift of 32 leaves 0
+}
+
+__attribute__((target("avx2")))
+static inline void store8(uint16_t* out, __m256i values, uint32_t lanes){
+	// Stores the low 11 bits of the first 'lanes' lanes
+	values = _mm256_and_si256(values, _mm256_set1_epi32(0x7FF));
+	__m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+	if(lanes == 8){
+		_mm_storeu_si128((__m128i*)out, packed);
+	}
+	else{
+		uint16_t tail[8];
+		_mm_storeu_si128((__m128i*)tail, packed);
+		for(uint32_t i=0; i<lanes; i++){
+			out[i] = tail[i];
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static uint32_t decode_avx2(const unsigned char* records, uint32_t n, uint16_t* samples){
+	const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i top = _mm256_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3);
+	const __m256i upper = _mm256_setr_epi32(0, 0, 0, 0, -1, -1, -1, -1);
+	uint32_t total = 0;
+	
+	for(uint32_t r=0; r<n; r++){
+		const unsigned char* pl = records + (size_t)r * PACKET_SIZE + BATCH_RECORD_PL_OFFSET;
+		uint32_t format, width;
+		uint32_t count = record_count(pl, &format, &width);
+		uint16_t* out = samples + total;
+		total += count;
+		
+		if(format == BATCH_FORMAT_RAW){
+			const unsigned char* data = pl + BATCH_DATA_OFFSET;
+			for(uint32_t i=0; i<count; i+=8){
+				__m256i index = _mm256_add_epi32(_mm256_set1_epi32((int)i), lane);
+				__m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)count), index);
+				__m256i bits = _mm256_mullo_epi32(index, _mm256_set1_epi32(BATCH_SAMPLE_BITS));
+				store8(out + i, unpack8(data, bits, BATCH_SAMPLE_BITS, valid), (count - i < 8) ? count - i : 8);
+			}
+			continue;
+		}
+		if(format != BATCH_FORMAT_DELTA || count == 0){
+			continue;
+		}
+		
+		// First sample (sign extended), then the deltas of samples 1 to count-1
+		const unsigned char* data = pl + BATCH_DELTA_DATA_OFFSET;
+		int32_t first = (int32_t)(((uint32_t)data[0] << 3) | (data[1] >> 5));
+		first = (first & 0x400) ? first - 0x800 : first;
+		out[0] = (uint16_t)(first & 0x7FF);
+		__m256i previous = _mm256_set1_epi32(first);
+		for(uint32_t i=1; i<count; i+=8){
+			__m256i index = _mm256_add_epi32(_mm256_set1_epi32((int)i), lane);
+			__m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)count), index);
+			__m256i bits = _mm256_add_epi32(_mm256_set1_epi32(BATCH_SAMPLE_BITS),
+			                                _mm256_mullo_epi32(_mm256_sub_epi32(index, _mm256_set1_epi32(1)), _mm256_set1_epi32((int)width)));
+			__m256i value = unpack8(data, bits, width, valid);
+			
+			// Zigzag: (v >> 1) ^ -(v & 1)
+			__m256i delta = _mm256_xor_si256(_mm256_srli_epi32(value, 1),
+			                                 _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(value, _mm256_set1_epi32(1))));
+			delta = _mm256_and_si256(delta, valid);
+			
+			// Prefix sum within each 128-bit half, then carry the low half's total into the high half
+			delta = _mm256_add_epi32(delta, _mm256_slli_si256(delta, 4));
+			delta = _mm256_add_epi32(delta, _mm256_slli_si256(delta, 8));
+			delta = _mm256_add_epi32(delta, _mm256_and_si256(_mm256_permutevar8x32_epi32(delta, top), upper));
+			__m256i sample = _mm256_add_epi32(previous, delta);
+			
+			store8(out + i, sample, (count - i < 8) ? count - i : 8);
+			previous = _mm256_permutevar8x32_epi32(sample, _mm256_set1_epi32(7));
+		}
+	}
+	return total;
+}
+
+#endif /* BATCH_DECODE_HAVE_X86 */
+
+int batch_decode_tier_supported(batch_decode_tier tier){
+	// Returns 1 if the implementation can run on this machine
+	switch(tier){
+		case BATCH_DECODE_SCALAR:
+			return 1;
+		case BATCH_DECODE_AVX2:
+#if defined(BATCH_DECODE_HAVE_X86)
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#else
+			return 0;
+#endif
+	}
+	return 0;
+}
+
+const char* batch_decode_tier_name(batch_decode_tier tier){
+	switch(tier){
+		case BATCH_DECODE_SCALAR: return "scalar";
+		case BATCH_DECODE_AVX2:   return "avx2";
+	}
+	return "?";
+}
+
+uint32_t batch_decode_records_tier(batch_decode_tier tier, const unsigned char* records, uint32_t n, uint16_t* samples){
+	// Decodes the batches of 'n' records with the given implementation, returns the number of samples
+#if defined(BATCH_DECODE_HAVE_X86)
+	if(tier == BATCH_DECODE_AVX2 && batch_decode_tier_supported(BATCH_DECODE_AVX2)){
+		return decode_avx2(records, n, samples);
+	}
+#endif
+	(void)tier;
+	return decode_scalar(records, n, samples);
+}
+
+uint32_t batch_decode_records(const unsigned char* records, uint32_t n, uint16_t* samples){
+	// Decodes the batches of 'n' records with the fastest implementation
+	static int best = -1;
+	if(best < 0){
+		best = batch_decode_tier_supported(BATCH_DECODE_AVX2) ? BATCH_DECODE_AVX2 : BATCH_DECODE_SCALAR;
+	}
+	return batch_decode_records_tier((batch_decode_tier)best, records, n, samples);
+}
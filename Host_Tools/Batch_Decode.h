@@ -0,0 +1,27 @@
+#ifndef __BATCH_DECODE_H
+#define __BATCH_DECODE_H
+
+#include <stdint.h>
+
+#include "Batch.h"
+
+/*
+Batch Decode
+Decodes the sample batches (Batch.c) of many journal records at once, for reading whole EEPROM dumps or logs.
+*/
+
+#define BATCH_RECORD_PL_OFFSET 16 // pl in a serialised packet (after MAC dest, MAC src, Length and the sample)
+
+// Implementations
+typedef enum {
+	BATCH_DECODE_SCALAR, // Batch.c, one bit at a time
+	BATCH_DECODE_AVX2    // Eight samples per step: gather, variable shifts and a prefix sum (x86 with AVX2 only)
+} batch_decode_tier;
+
+// 			 Batch Decode Functions
+int      batch_decode_tier_supported(batch_decode_tier tier);
+const char* batch_decode_tier_name(batch_decode_tier tier);
+uint32_t batch_decode_records_tier(batch_decode_tier tier, const unsigned char* records, uint32_t n, uint16_t* samples);
+uint32_t batch_decode_records(const unsigned char* records, uint32_t n, uint16_t* samples);
+
+#endif /* __BATCH_DECODE_H */
@@ -0,0 +1,189 @@
+/*
+CRC_Bench
+Checks that every implementation in STM32_CRC.c gives the same result as a bit-at-a-time model of the CRC unit,
+and that the cached FCS of Packet.c (fcs_cache_update) matches the full FCS for every sample value, then reports the throughput of each one on this machine, and the packet rate for both FCS formats.
+
+Build and run (from Host_Tools):
+    gcc -O2 -I../Starter_Project/Inc -o CRC_Bench CRC_Bench.c STM32_CRC.c ../Starter_Project/Packet.c
+    ./CRC_Bench [megabytes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "STM32_CRC.h"
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t crc_reference(uint32_t crc, const unsigned char* p, size_t len){
+	// One bit at a time, as the CRC unit shifts the data register in from bit 31
+	while(len--){
+		crc ^= (uint32_t)*p++ << 24;
+		for(int i=0; i<8; i++){
+			crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04C11DB7u : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static int check_tiers(const unsigned char* data){
+	// Compares every supported implementation against the reference for many lengths and alignments
+	int errors = 0;
+	for(size_t off=0; off<16; off++){
+		for(size_t len=0; len<1100; len += (len < 300) ? 1 : 37){
+			uint32_t ref = crc_reference(STM32_CRC_INIT, data + off, len);
+			for(int t=STM32_CRC_SCALAR; t<=STM32_CRC_CLMUL; t++){
+				if(!stm32_crc_tier_supported((stm32_crc_tier)t)) continue;
+				if(stm32_crc_bytes_tier((stm32_crc_tier)t, STM32_CRC_INIT, data + off, len) != ref){
+					if(errors++ < 10){
+						printf("MISMATCH %s offset %zu length %zu\n", stm32_crc_tier_name((stm32_crc_tier)t), off, len);
+					}
+				}
+			}
+		}
+	}
+	return errors;
+}
+
+static int check_packets(void){
+	// Both FCS formats against the reference fed with the same words the board writes to CRC->DR
+	int errors = 0;
+	for(int n=0; n<1000; n++){
+		struct Pack pkt;
+		uint32_t words[FCS_WORDS_MAX];
+		unsigned char bytes[4*FCS_WORDS_MAX];
+		
+		for(int i=0; i<6; i++){
+			pkt.MAC_dest[i] = rand();
+			pkt.MAC_src[i] = rand();
+		}
+		pkt.length = 0x2e;
+		pkt.payload.sample = rand() & 0x7FF;
+		for(int i=0; i<44; i++){
+			pkt.payload.pl[i] = rand();
+		}
+		
+		for(uint32_t mode=FCS_MODE_LEGACY; mode<=FCS_MODE_PACKED; mode++){
+			uint32_t count = packet_fcs_words(&pkt, mode, words);
+			for(uint32_t i=0; i<count; i++){
+				bytes[4*i] = words[i] >> 24;
+				bytes[4*i+1] = words[i] >> 16;
+				bytes[4*i+2] = words[i] >> 8;
+				bytes[4*i+3] = words[i];
+			}
+			pkt.FCS = stm32_crc_fcs(pkt, mode);
+			if(pkt.FCS != crc_reference(STM32_CRC_INIT, bytes, 4*count)){
+				errors++;
+			}
+			
+			unsigned char record[PACKET_SIZE];
+			packet_serialise(&pkt, record);
+			if(stm32_crc_check_record(record) != (int)mode){
+				errors++;
+			}
+		}
+	}
+	if(errors){
+		printf("MISMATCH in %d packet FCS checks\n", errors);
+	}
+	return errors;
+}
+
+static int check_fcs_cache(void){
+	// The cached FCS against the full FCS for every 16-bit sample (the 11-bit reading and the alarm flag included),
+	// in both formats, for a few packets
+	int errors = 0;
+	for(int n=0; n<4; n++){
+		struct Pack pkt;
+		struct FCS_Cache cache;
+		
+		for(int i=0; i<6; i++){
+			pkt.MAC_dest[i] = rand();
+			pkt.MAC_src[i] = rand();
+		}
+		pkt.length = 0x2e;
+		pkt.payload.sample = rand();
+		for(int i=0; i<44; i++){
+			pkt.payload.pl[i] = (n == 0) ? 0 : rand();
+		}
+		
+		for(uint32_t mode=FCS_MODE_LEGACY; mode<=FCS_MODE_PACKED; mode++){
+			fcs_cache_prime(&cache, &pkt, mode, stm32_crc_fcs);
+			for(uint32_t sample=0; sample<=0xFFFF; sample++){
+				struct Pack p = pkt;
+				p.payload.sample = (uint16_t)sample;
+				if(fcs_cache_update(&cache, (uint16_t)sample) != stm32_crc_fcs(p, mode)){
+					if(errors++ == 0){
+						printf("MISMATCH in the cached FCS for sample 0x%04X, format %u\n", (unsigned)sample, (unsigned)mode);
+					}
+				}
+			}
+		}
+	}
+	if(errors){
+		printf("MISMATCH in %d cached FCS checks\n", errors);
+	}
+	return errors;
+}
+
+int main(int argc, char** argv){
+	size_t megabytes = (argc > 1) ? (size_t)atoi(argv[1]) : 64;
+	size_t len = megabytes << 20;
+	unsigned char* data = malloc(len + 16);
+	if(!data){
+		printf("Out of memory\n");
+		return 1;
+	}
+	srand(1);
+	for(size_t i=0; i<len + 16; i++){
+		data[i] = rand();
+	}
+	
+	if(check_tiers(data) || check_packets() || check_fcs_cache()){
+		return 1;
+	}
+	printf("All implementations match the CRC unit model, and the cached FCS the full one\n\n");
+	
+	printf("%-14s %10s %10s\n", "tier", "GB/s", "crc");
+	for(int t=STM32_CRC_SCALAR; t<=STM32_CRC_CLMUL; t++){
+		if(!stm32_crc_tier_supported((stm32_crc_tier)t)){
+			printf("%-14s %10s\n", stm32_crc_tier_name((stm32_crc_tier)t), "n/a");
+			continue;
+		}
+		double best = 1e9;
+		uint32_t crc = 0;
+		for(int rep=0; rep<5; rep++){
+			double t0 = now();
+			crc = stm32_crc_bytes_tier((stm32_crc_tier)t, STM32_CRC_INIT, data, len);
+			double t1 = now();
+			if(t1 - t0 < best) best = t1 - t0;
+		}
+		printf("%-14s %10.2f %10.8X\n", stm32_crc_tier_name((stm32_crc_tier)t), len / best / 1e9, crc);
+	}
+	
+	// Packet rate with the best implementation
+	struct Pack pkt;
+	memset(&pkt, 0, sizeof(pkt));
+	pkt.length = 0x2e;
+	printf("\n%-14s %10s\n", "FCS format", "Mpkt/s");
+	for(uint32_t mode=FCS_MODE_LEGACY; mode<=FCS_MODE_PACKED; mode++){
+		const int count = 2000000;
+		volatile uint32_t sink = 0;
+		double t0 = now();
+		for(int i=0; i<count; i++){
+			pkt.payload.sample = i & 0x7FF;
+			sink ^= stm32_crc_fcs(pkt, mode);
+		}
+		double t1 = now();
+		printf("%-14s %10.2f\n", (mode == FCS_MODE_LEGACY) ? "v0 legacy" : "v1 packed", count / (t1 - t0) / 1e6);
+	}
+	
+	free(data);
+	return 0;
+}
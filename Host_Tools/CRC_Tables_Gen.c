@@ -0,0 +1,48 @@
+/*
+CRC_Tables_Gen
+Generates STM32_CRC_Tables.h, the slicing-by-8 tables for the STM32 CRC unit polynomial (0x04C11DB7, shifted
+in most significant bit first). The tables are compiled into the host CRC library as constants, so nothing has
+to be built at run time.
+
+Build and run (from Host_Tools):
+    gcc -O2 -o CRC_Tables_Gen CRC_Tables_Gen.c
+    ./CRC_Tables_Gen > STM32_CRC_Tables.h
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define POLY 0x04C11DB7u
+
+int main(void){
+	static uint32_t table[8][256];
+	
+	// Table 0: CRC of a single byte in the top of the register
+	for(uint32_t b=0; b<256; b++){
+		uint32_t crc = b << 24;
+		for(int i=0; i<8; i++){
+			crc = (crc & 0x80000000u) ? (crc << 1) ^ POLY : (crc << 1);
+		}
+		table[0][b] = crc;
+	}
+	// Table k: the same byte followed by k zero bytes
+	for(int k=1; k<8; k++){
+		for(uint32_t b=0; b<256; b++){
+			uint32_t crc = table[k-1][b];
+			table[k][b] = (crc << 8) ^ table[0][crc >> 24];
+		}
+	}
+	
+	printf("// Generated by CRC_Tables_Gen.c, do not edit\n");
+	printf("// Slicing-by-8 tables for polynomial 0x%08X, most significant bit first\n\n", POLY);
+	printf("static const uint32_t stm32_crc_table[8][256] = {\n");
+	for(int k=0; k<8; k++){
+		printf("\t{\n");
+		for(int b=0; b<256; b++){
+			printf("%s0x%08X%s", (b % 8 == 0) ? "\t\t" : "", table[k][b], (b == 255) ? "\n" : ((b % 8 == 7) ? ",\n" : ", "));
+		}
+		printf("\t}%s\n", (k == 7) ? "" : ",");
+	}
+	printf("};\n");
+	return 0;
+}
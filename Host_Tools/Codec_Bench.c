@@ -0,0 +1,123 @@
+/*
+Codec_Bench
+Encodes a simulated temperature log with the board's Batch.c in the raw and the delta format, checks that every
+decoder in Batch_Decode.c gives the log back, and reports how many samples fit in a packet (and so how much
+history fits in the EEPROM journal) and the decode rate of each implementation on this machine.
+
+Build and run (from Host_Tools):
+    gcc -O2 -I../Starter_Project/Inc -o Codec_Bench Codec_Bench.c Batch_Decode.c ../Starter_Project/Batch.c ../Starter_Project/Packet.c
+    ./Codec_Bench [samples] [sample period in s]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Batch_Decode.h"
+
+#define EEPROM_SIZE 8192
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void simulate(uint16_t* log, uint32_t n){
+	// Room temperature that drifts slowly, with sensor noise of a step or two and the odd jump (a door opening)
+	int32_t t = 22 * 8; // 0.125 degree steps
+	for(uint32_t i=0; i<n; i++){
+		int r = rand() % 1000;
+		if(r < 2){
+			t += (rand() % 41) - 20;
+		}
+		else if(r < 300){
+			t += (rand() % 5) - 2;
+		}
+		if(t < -40 * 8) t = -40 * 8;
+		if(t > 120 * 8) t = 120 * 8;
+		log[i] = (uint16_t)(t & 0x7FF);
+	}
+}
+
+static uint32_t encode(const uint16_t* log, uint32_t n, uint32_t format, unsigned char* records){
+	// Packs the log into batch packets as the board does, returns the number of records
+	struct Pack pkt;
+	uint32_t count = 0;
+
+	memset(&pkt, 0, sizeof(pkt));
+	batch_clear(&pkt, format);
+	for(uint32_t i=0; i<n; i++){
+		if(batch_add(&pkt, log[i], i * 1000000u) == 0){
+			packet_serialise(&pkt, records + (size_t)count++ * PACKET_SIZE);
+			batch_clear(&pkt, format);
+			batch_add(&pkt, log[i], i * 1000000u);
+		}
+		if(batch_full(&pkt)){
+			packet_serialise(&pkt, records + (size_t)count++ * PACKET_SIZE);
+			batch_clear(&pkt, format);
+		}
+	}
+	if(batch_count(&pkt)){
+		packet_serialise(&pkt, records + (size_t)count++ * PACKET_SIZE);
+	}
+	return count;
+}
+
+int main(int argc, char** argv){
+	uint32_t n = (argc > 1) ? (uint32_t)atoi(argv[1]) : 4000000;
+	double period = (argc > 2) ? atof(argv[2]) : 1.0;
+	uint16_t* log = malloc(sizeof(uint16_t) * n);
+	uint16_t* decoded = malloc(sizeof(uint16_t) * (n + BATCH_DELTA_MAX_SAMPLES));
+	unsigned char* records = malloc((size_t)n * PACKET_SIZE);
+	if(!log || !decoded || !records){
+		printf("Out of memory\n");
+		return 1;
+	}
+	srand(1);
+	simulate(log, n);
+
+	printf("%-8s %9s %12s %14s", "format", "records", "samples/pkt", "EEPROM hours");
+	for(int t=BATCH_DECODE_SCALAR; t<=BATCH_DECODE_AVX2; t++){
+		printf(" %12s", batch_decode_tier_name((batch_decode_tier)t));
+	}
+	printf("  (Msamples/s)\n");
+
+	int errors = 0;
+	for(int f=0; f<2; f++){
+		uint32_t format = f ? BATCH_FORMAT_DELTA : BATCH_FORMAT_RAW;
+		uint32_t count = encode(log, n, format, records);
+		double per_packet = (double)n / count;
+		printf("%-8s %9u %12.1f %14.1f", f ? "delta" : "raw", count, per_packet,
+		       EEPROM_SIZE / PACKET_SIZE * per_packet * period / 3600);
+
+		for(int t=BATCH_DECODE_SCALAR; t<=BATCH_DECODE_AVX2; t++){
+			if(!batch_decode_tier_supported((batch_decode_tier)t)){
+				printf(" %12s", "n/a");
+				continue;
+			}
+			double best = 1e9;
+			for(int rep=0; rep<3; rep++){
+				memset(decoded, 0, sizeof(uint16_t) * n);
+				double t0 = now();
+				uint32_t got = batch_decode_records_tier((batch_decode_tier)t, records, count, decoded);
+				double t1 = now();
+				if(t1 - t0 < best) best = t1 - t0;
+				if(got != n || memcmp(decoded, log, sizeof(uint16_t) * n)){
+					errors++;
+				}
+			}
+			printf(" %12.1f", n / best / 1e6);
+		}
+		printf("\n");
+	}
+
+	if(errors){
+		printf("MISMATCH in %d decodes\n", errors);
+	}
+	free(log);
+	free(decoded);
+	free(records);
+	return errors != 0;
+}
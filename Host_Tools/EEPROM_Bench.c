@@ -0,0 +1,583 @@
+/*
+EEPROM_Bench
+Runs the board's EEPROM driver (EEPROM.c) and the I2C1 transfer queue under it (I2C_Bus.c) against the 24LC64
+model on the emulated I2C bus. It checks random writes and reads against a copy of what the memory should hold,
+checks chained transfers and a probe of an empty address, checks that a write cycle longer than
+EEPROM_WRITE_TIMEOUT_US is reported, checks that a held bus and a bus error are recovered from (and reported once
+the retries are used up), checks that the priority classes are served in order, checks that page write backs of
+the EEPROM cache (EEPROM_Cache.c) the model refuses are reported and tried again, and then reports the write and
+read throughput and the acknowledge polling for a few write cycle times, the transfer times seen by the I2C1
+queue, the queueing delay of sensor reads (an LM75 model) made while the EEPROM is written and read, and the
+sensor read and EEPROM read throughput at each bus speed set by i2c_bus_set_speed. Times are simulated, on a 400
+kHz bus unless said otherwise. Given a file name, it saves the engine's trace of the sensor reads made while the
+EEPROM is written, for I2C_Replay.
+
+Build and run (from Host_Tools):
+    gcc -O2 -no-pie -II2C_Shim -I../Starter_Project/Inc -I../Starter_Project -o EEPROM_Bench EEPROM_Bench.c EEPROM_Model.c LM75_Model.c I2C_Shim.c ../Starter_Project/I2C_Bus.c ../Starter_Project/EEPROM.c ../Starter_Project/EEPROM_Cache.c
+    ./EEPROM_Bench [seed] [trace.bin]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "I2C_Bus.h"
+#include "EEPROM.h"
+#include "EEPROM_Cache.h"
+#include "EEPROM_Model.h"
+#include "LM75_Model.h"
+#include "Time_Delays.h"
+
+#define BUS_HZ 400000
+
+// Buffers handed to the driver are static, DMA addresses are 32 bits
+static struct EEPROM_Model model;
+static unsigned char expected[EEPROM_SIZE];
+static unsigned char buffer[EEPROM_SIZE];
+static struct I2C_Transfer transfers[4];
+static unsigned char sensor_data[2];
+
+// LM75 at TEMPADR, reading 25 degrees
+#define TEMPADR 0x90
+static struct LM75_Model sensor;
+
+static int order[4]; // Transfers in the order they finished (check_priority)
+static int finished;
+static void note_done(struct I2C_Transfer* t){
+	order[finished++] = (int)(t - transfers);
+}
+
+static int check_memory(const char* what){
+	// Compares the model's memory with what should be in it
+	for(int i=0; i<EEPROM_SIZE; i++){
+		if(model.memory[i] != expected[i]){
+			printf("MISMATCH after %s at 0x%04X: %02X, expected %02X\n", what, i, model.memory[i], expected[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int check_random(void){
+	// Random writes of any address and length, then random reads
+	int errors = 0;
+
+	for(int i=0; i<300; i++){
+		uint16_t address = rand() % EEPROM_SIZE;
+		uint16_t length = 1 + rand() % 100;
+		if(address + length > EEPROM_SIZE){
+			length = EEPROM_SIZE - address;
+		}
+		for(int j=0; j<length; j++){
+			buffer[j] = (unsigned char)rand();
+		}
+		memcpy(expected + address, buffer, length);
+		if(i % 2){
+			errors += eeprom_write(address, buffer, length) != 0;
+		}
+		else{
+			eeprom_write_async(address, buffer, length, 0);
+			errors += eeprom_async_wait() != 0;
+		}
+	}
+	eeprom_wait_ready();
+	if(errors){
+		printf("%d writes failed\n", errors);
+	}
+	errors += check_memory("random writes");
+
+	for(int i=0; i<300 && !errors; i++){
+		uint16_t address = rand() % EEPROM_SIZE;
+		uint16_t length = (i % 10 == 0) ? 1 : 1 + rand() % 300; // Includes the single byte path
+		if(address + length > EEPROM_SIZE){
+			length = EEPROM_SIZE - address;
+		}
+		eeprom_read(address, buffer, length);
+		if(memcmp(buffer, expected + address, length)){
+			printf("MISMATCH reading %u bytes at 0x%04X\n", length, address);
+			errors++;
+		}
+	}
+
+	// A sequential read carries on from the start of the memory after the last byte
+	eeprom_read(EEPROM_SIZE - 2, buffer, 4);
+	if(memcmp(buffer, expected + EEPROM_SIZE - 2, 2) || memcmp(buffer + 2, expected, 2)){
+		printf("MISMATCH reading across the end of the memory\n");
+		errors++;
+	}
+	return errors;
+}
+
+static int check_page_wrap(void){
+	// Model only: a write past the end of a page, queued by hand, wraps around to the start of the page
+	uint16_t address = 0x0400 + EEPROM_PAGE_SIZE - 4;
+	int errors = 0;
+
+	eeprom_wait_ready();
+	for(int i=0; i<8; i++){
+		buffer[i] = (unsigned char)(0xE0 + i);
+	}
+	memset(&transfers[0], 0, sizeof(transfers[0]));
+	transfers[0].address = EEPROMADR;
+	transfers[0].cmd[0] = (uint8_t)(address >> 8);
+	transfers[0].cmd[1] = (uint8_t)address;
+	transfers[0].cmd_length = 2;
+	transfers[0].tx = buffer;
+	transfers[0].tx_length = 8;
+	i2c_submit(&transfers[0], 1);
+	errors += i2c_wait(&transfers[0]) != I2C_OK;
+
+	for(int i=0; i<8; i++){
+		uint16_t a = (uint16_t)(0x0400 + (EEPROM_PAGE_SIZE - 4 + i) % EEPROM_PAGE_SIZE);
+		expected[a] = (unsigned char)(0xE0 + i);
+	}
+	errors += check_memory("a write across the end of a page");
+	errors += !eeprom_model_busy(&model, i2c_shim_now());
+	delay_us(model.write_cycle_us + model.jitter_us); // The driver does not know about this write cycle
+	return errors;
+}
+
+static int check_chain(void){
+	// A chain of reads joined by repeated STARTs (a one byte read with the address, then reads carrying on from
+	// where it stopped), a probe of an address with nothing there, and a chain whose first read fails, the rest
+	// of which is counted and traced as not run
+	uint32_t starts = i2c_shim_stats()->starts;
+	int errors = 0;
+
+	eeprom_wait_ready();
+	memset(transfers, 0, sizeof(transfers));
+	for(int i=0; i<3; i++){
+		transfers[i].address = EEPROMADR;
+		transfers[i].flags = (i < 2) ? I2C_CHAIN : 0;
+		transfers[i].rx = buffer + (i ? 1 + (i - 1) * 5 : 0);
+		transfers[i].rx_length = i ? 5 : 1;
+	}
+	transfers[0].cmd[0] = 0x12;
+	transfers[0].cmd[1] = 0x34;
+	transfers[0].cmd_length = 2;
+	i2c_submit(transfers, 3);
+	for(int i=0; i<3; i++){
+		errors += i2c_wait(&transfers[i]) != I2C_OK;
+	}
+	if(errors || memcmp(buffer, expected + 0x1234, 11)){
+		printf("MISMATCH in a chained read\n");
+		errors++;
+	}
+	if(i2c_shim_stats()->starts - starts != 4){ // START, RE-START for the read, one RE-START for each of the others
+		printf("Chained read used %u STARTs\n", (unsigned)(i2c_shim_stats()->starts - starts));
+		errors++;
+	}
+
+	transfers[3].address = 0x50;
+	i2c_submit(&transfers[3], 1);
+	if(i2c_wait(&transfers[3]) != I2C_NACK){
+		printf("Probe of an empty address was not NACKed\n");
+		errors++;
+	}
+
+	const struct I2C_Device_Stats* d = i2c_device_stats(TEMPADR);
+	uint32_t done = d ? d->transfers : 0;
+	uint32_t failures = d ? d->failures : 0;
+	struct I2C_Trace_Entry last;
+	memset(transfers, 0, 2 * sizeof(transfers[0]));
+	for(int i=0; i<2; i++){
+		transfers[i].address = TEMPADR;
+		transfers[i].rx = sensor_data;
+		transfers[i].rx_length = 2;
+	}
+	transfers[0].flags = I2C_CHAIN;
+	i2c_shim_stall(1 + I2C_RETRIES, 2);
+	i2c_submit(transfers, 2);
+	i2c_wait(&transfers[1]);
+	d = i2c_device_stats(TEMPADR);
+	i2c_trace_copy(&last, 1);
+	if(transfers[0].status != I2C_TIMEOUT || transfers[0].tries != 1 + I2C_RETRIES ||
+	   transfers[1].status != I2C_TIMEOUT || transfers[1].tries != 0 || !d || d->transfers - done != 2 ||
+	   d->failures - failures != 2 || last.tries != 0 || last.status != I2C_TIMEOUT){
+		printf("Chain cut short by a held bus: status %u and %u, %u and %u tries, last traced with %u tries\n",
+		       (unsigned)transfers[0].status, (unsigned)transfers[1].status, transfers[0].tries, transfers[1].tries,
+		       last.tries);
+		errors++;
+	}
+	return errors;
+}
+
+static int check_timeout(void){
+	// A write cycle that never ends within EEPROM_WRITE_TIMEOUT_US is an error
+	int errors = 0;
+	uint32_t timeouts = eeprom_stats()->timeouts;
+
+	model.write_cycle_us = EEPROM_WRITE_TIMEOUT_US * 2;
+	buffer[0] = 0x5A;
+	buffer[1] = 0xA5;
+	if(eeprom_write(0x0100, buffer, 2) != 0){
+		printf("First write failed\n");
+		errors++;
+	}
+	if(eeprom_write(0x0200, buffer, 2) == 0){
+		printf("Write after a %u us cycle did not fail\n", (unsigned)model.write_cycle_us);
+		errors++;
+	}
+	if(eeprom_stats()->timeouts != timeouts + 1){
+		printf("Timeout not counted\n");
+		errors++;
+	}
+
+	// Let the cycle finish, the write did not happen
+	delay_us(EEPROM_WRITE_TIMEOUT_US * 2);
+	model.write_cycle_us = 5000;
+	expected[0x0100] = 0x5A;
+	expected[0x0101] = 0xA5;
+	errors += check_memory("the timeout");
+	return errors;
+}
+
+static int check_recovery(void){
+	// A device holding SDA after the control byte (freed by the recovery clocks), a bus error, a bus held on
+	// every try, which ends with EEPROM_TIMEOUT, and the EEPROM holding SDA part way through the data of a page
+	// write. The bus works again afterwards
+	int errors = 0;
+
+	eeprom_wait_ready();
+	i2c_stats_reset();
+	uint32_t clocks = i2c_shim_stats()->clocks;
+	i2c_shim_stall(1, 3);
+	int result = eeprom_read(0x0300, buffer, 64);
+	const struct I2C_Device_Stats* d = i2c_device_stats(EEPROMADR);
+	if(result != 0 || memcmp(buffer, expected + 0x0300, 64)){
+		printf("MISMATCH reading after a recovery\n");
+		errors++;
+	}
+	if(!d || d->timeouts != 1 || d->retries != 1 || d->recoveries != 1 || d->failures != 0){
+		printf("Held bus: %u timeouts, %u retries, %u recoveries, %u failures\n", d ? (unsigned)d->timeouts : 0,
+		       d ? (unsigned)d->retries : 0, d ? (unsigned)d->recoveries : 0, d ? (unsigned)d->failures : 0);
+		errors++;
+	}
+	if(i2c_shim_stats()->clocks - clocks < 3){
+		printf("Recovery gave %u clocks\n", (unsigned)(i2c_shim_stats()->clocks - clocks));
+		errors++;
+	}
+
+	i2c_shim_glitch(1);
+	result = eeprom_read(0x0400, buffer, 8);
+	if(result != 0 || memcmp(buffer, expected + 0x0400, 8) || d->bus_errors != 1 || d->retries != 2){
+		printf("Bus error not recovered from\n");
+		errors++;
+	}
+
+	i2c_shim_stall(1 + I2C_RETRIES, 2);
+	if(eeprom_read(0x0500, buffer, 8) != EEPROM_TIMEOUT || d->failures != 1){
+		printf("Bus held on every try was not reported\n");
+		errors++;
+	}
+	eeprom_read(0x0500, buffer, 8);
+	if(memcmp(buffer, expected + 0x0500, 8)){
+		printf("MISMATCH reading after a failed transfer\n");
+		errors++;
+	}
+
+	// The recovery's STOP writes the first 8 bytes of the page, the retry is not acknowledged while the EEPROM is
+	// busy with them, and the page is written again in full afterwards. The next write goes through as usual
+	eeprom_wait_ready();
+	uint32_t timeouts = d->timeouts;
+	uint32_t pages = model.page_writes;
+	memset(buffer, 0x6B, 64);
+	i2c_shim_stall_data(2 + 9, 3); // Two address bytes, 8 data bytes taken, held in the ninth
+	result = eeprom_write(0x0600, buffer, EEPROM_PAGE_SIZE);
+	int next = eeprom_write(0x0620, buffer, EEPROM_PAGE_SIZE);
+	memset(expected + 0x0600, 0x6B, 64);
+	if(result != 0 || next != 0 || d->timeouts != timeouts + 1 || model.page_writes != pages + 3){
+		printf("Page write held part way: returned %d then %d, %u timeouts, %u write cycles\n", result, next,
+		       (unsigned)(d->timeouts - timeouts), (unsigned)(model.page_writes - pages));
+		errors++;
+	}
+	errors += check_memory("a page write held part way");
+	printf("Recovery %u us at most, transfers %u us at most\n", (unsigned)d->recovery_max_us, (unsigned)d->max_us);
+	return errors;
+}
+
+static int check_priority(void){
+	// With an EEPROM read on the bus, a LOW, a NORMAL and a HIGH transfer queued in that order finish HIGH,
+	// NORMAL, LOW, all before the read (which is in chunks)
+	int errors = 0;
+
+	eeprom_wait_ready();
+	memset(transfers, 0, sizeof(transfers));
+	for(int i=0; i<3; i++){
+		transfers[i].address = TEMPADR;
+		transfers[i].rx = sensor_data;
+		transfers[i].rx_length = 2;
+		transfers[i].priority = (uint8_t)(I2C_PRIORITY_LOW - i);
+		transfers[i].done = note_done;
+	}
+	finished = 0;
+	eeprom_read_async(0, buffer, 1024, 0);
+	delay_us(100); // The first chunk is on the bus
+	for(int i=0; i<3; i++){
+		i2c_submit(&transfers[i], 1);
+	}
+	i2c_wait(&transfers[0]);
+	if(!eeprom_async_busy() || order[0] != 2 || order[1] != 1 || order[2] != 0){
+		printf("Priority classes served out of order: %d %d %d%s\n", order[0], order[1], order[2],
+		       eeprom_async_busy() ? "" : ", after the EEPROM read");
+		errors++;
+	}
+	errors += eeprom_async_wait() != 0;
+	if(memcmp(buffer, expected, 1024)){
+		printf("MISMATCH in a read with other transfers between its chunks\n");
+		errors++;
+	}
+	return errors;
+}
+
+// The page cache over the driver as the board sets it up: writes return straight away, their error comes from the wait
+static int cache_write_async(uint16_t address, const unsigned char* data, uint16_t length){
+	eeprom_write_async(address, data, length, 0);
+	return 0;
+}
+static const struct EEPROM_Ops cache_ops = { cache_write_async, eeprom_read, eeprom_wait_ready, eeprom_async_busy };
+static struct EEPROM_Cache cache;
+
+static int cache_error(const char* what, int error, int expected_error){
+	if(error != expected_error){
+		printf("Cache %s returned %d, expected %d\n", what, error, expected_error);
+		return 1;
+	}
+	return 0;
+}
+
+static int check_cache(void){
+	// Page write backs the EEPROM refuses: the error comes out of the flush, the next cache write and a poll once
+	// the driver has finished, and the page stays dirty until a later write back gets it into the EEPROM
+	unsigned char data[8];
+	int errors = 0;
+
+	eeprom_wait_ready();
+	eeprom_cache_init(&cache, &cache_ops);
+	for(int i=0; i<8; i++){
+		data[i] = (unsigned char)rand();
+	}
+	errors += cache_error("write", eeprom_cache_write(&cache, 0x0404, data, 8), 0);
+	model.fail_writes = 1;
+	errors += cache_error("flush of a refused page", eeprom_cache_flush(&cache), EEPROM_ERROR);
+	errors += check_memory("a refused write back");
+	errors += cache_error("flush again", eeprom_cache_flush(&cache), 0);
+	memcpy(expected + 0x0404, data, 8);
+	errors += check_memory("a write back tried again");
+
+	// Refused while the main loop carries on: the next write to the page gets the error, and is kept
+	data[0] ^= 0xFF;
+	errors += cache_error("write", eeprom_cache_write(&cache, 0x0404, data, 1), 0);
+	model.fail_writes = 1;
+	errors += cache_error("poll sending the page", eeprom_cache_poll(&cache, 10, 0), 0);
+	data[1] ^= 0xFF;
+	errors += cache_error("write after a refused page", eeprom_cache_write(&cache, 0x0405, data + 1, 1), EEPROM_ERROR);
+	errors += cache_error("poll", eeprom_cache_poll(&cache, 20, 100), 0);
+	errors += check_memory("a refused write back");
+	errors += cache_error("poll after the age", eeprom_cache_poll(&cache, 200, 100), 0);
+	errors += cache_error("wait", eeprom_cache_wait(&cache), 0);
+	memcpy(expected + 0x0404, data, 2);
+	errors += check_memory("a page written back by a poll");
+
+	// Refused with nothing else going on: a later poll gets the error once the driver has finished
+	data[2] ^= 0xFF;
+	errors += cache_error("write", eeprom_cache_write(&cache, 0x0406, data + 2, 1), 0);
+	model.fail_writes = 1;
+	errors += cache_error("poll sending the page", eeprom_cache_poll(&cache, 300, 0), 0);
+	eeprom_async_wait();
+	errors += cache_error("poll after a refused page", eeprom_cache_poll(&cache, 310, 100), EEPROM_ERROR);
+	errors += cache_error("flush", eeprom_cache_flush(&cache), 0);
+	expected[0x0406] = data[2];
+	errors += check_memory("a cache flush");
+	if(model.fail_writes){
+		printf("Refused write not tried\n");
+		errors++;
+	}
+	return errors;
+}
+
+static void sensor_delay(const char* what, int write){
+	// Reads the sensor every 500 us (HIGH) while the EEPROM is written or read, and reports the queueing delay
+	struct I2C_Transfer* t = &transfers[0];
+	memset(t, 0, sizeof(*t));
+	t->address = TEMPADR;
+	t->rx = sensor_data;
+	t->rx_length = 2;
+	t->priority = I2C_PRIORITY_HIGH;
+	t->status = I2C_OK;
+
+	eeprom_wait_ready();
+	i2c_stats_reset();
+	if(write){
+		memset(buffer, 0x3C, 2048);
+		eeprom_write_async(0, buffer, 2048, 0);
+	}
+	else{
+		eeprom_read_async(0, buffer, 4096, 0);
+	}
+	while(eeprom_async_busy()){
+		if(t->status != I2C_PENDING){
+			i2c_submit(t, 1);
+		}
+		delay_us(500);
+	}
+	i2c_wait(t);
+	eeprom_wait_ready();
+	const struct I2C_Class_Stats* c = i2c_class_stats(I2C_PRIORITY_HIGH);
+	printf("%-14s %6u %9u %9u\n", what, (unsigned)c->transfers, (unsigned)(c->total_us / c->transfers),
+	       (unsigned)c->max_us);
+}
+
+static int speed(uint32_t hz){
+	// Sensor reads one at a time (the two bytes of a fast read) and an EEPROM sequential read at one bus speed. The
+	// transfers must make their deadlines at any speed
+	struct I2C_Transfer* t = &transfers[0];
+	uint32_t timeouts = i2c_device_stats(TEMPADR)->timeouts + i2c_device_stats(EEPROMADR)->timeouts;
+	uint32_t set = i2c_bus_set_speed(hz);
+	memset(t, 0, sizeof(*t));
+	t->address = TEMPADR;
+	t->rx = sensor_data;
+	t->rx_length = 2;
+	t->priority = I2C_PRIORITY_HIGH;
+
+	uint64_t t0 = i2c_shim_now();
+	for(int i=0; i<200; i++){
+		i2c_submit(t, 1);
+		i2c_wait(t);
+	}
+	uint64_t t1 = i2c_shim_now();
+	eeprom_read(0, buffer, EEPROM_SIZE);
+	uint64_t t2 = i2c_shim_now();
+	printf("%6u %6u %9.0f %9.0f\n", (unsigned)(hz / 1000), (unsigned)set, 200 * 2 / ((t1 - t0) * 1e-9),
+	       EEPROM_SIZE / ((t2 - t1) * 1e-9));
+	timeouts = i2c_device_stats(TEMPADR)->timeouts + i2c_device_stats(EEPROMADR)->timeouts - timeouts;
+	if(timeouts || memcmp(buffer, expected, EEPROM_SIZE) != 0){
+		printf("At %u Hz: %u timeouts, read %s\n", (unsigned)set, (unsigned)timeouts,
+		       memcmp(buffer, expected, EEPROM_SIZE) ? "wrong" : "right");
+		return 1;
+	}
+	return 0;
+}
+
+static int save_trace(const char* path){
+	// Writes the engine's trace ring as the board's RAM holds it
+	FILE* f = fopen(path, "wb");
+	if(!f || fwrite(i2c_trace(), sizeof(struct I2C_Trace), 1, f) != 1){
+		printf("Cannot write %s\n", path);
+		if(f){
+			fclose(f);
+		}
+		return 1;
+	}
+	fclose(f);
+	return 0;
+}
+
+static void bench(uint32_t cycle_us, uint32_t jitter_us){
+	// Writes and reads the whole memory, and reports the polling
+	eeprom_stats_reset();
+	model.write_cycle_us = cycle_us;
+	model.jitter_us = jitter_us;
+	uint32_t pages = model.page_writes;
+	uint32_t nacks = model.busy_nacks;
+
+	// Two passes, the second uses the adapted polling
+	uint64_t t0 = 0;
+	for(int pass=0; pass<2; pass++){
+		if(pass == 1){
+			pages = model.page_writes;
+			nacks = model.busy_nacks;
+			t0 = i2c_shim_now();
+		}
+		for(int address=0; address<EEPROM_SIZE; address+=256){
+			memset(buffer, pass ? 0x3C : 0xC3, 256);
+			eeprom_write((uint16_t)address, buffer, 256);
+		}
+		eeprom_wait_ready();
+	}
+	uint64_t t1 = i2c_shim_now();
+	eeprom_read(0, buffer, EEPROM_SIZE);
+	uint64_t t2 = i2c_shim_now();
+
+	const struct EEPROM_Stats* s = eeprom_stats();
+	pages = model.page_writes - pages;
+	printf("%6u %6u %9.0f %9.0f %7u %9.2f %7u %7u\n", (unsigned)cycle_us, (unsigned)jitter_us,
+	       EEPROM_SIZE / ((t1 - t0) * 1e-9), EEPROM_SIZE / ((t2 - t1) * 1e-9), (unsigned)eeprom_stats_mean_us(),
+	       (double)(model.busy_nacks - nacks) / pages, (unsigned)s->first_poll_us, (unsigned)s->poll_interval_us);
+	memset(expected, 0x3C, sizeof(expected));
+}
+
+int main(int argc, char** argv){
+	srand((argc > 1) ? (unsigned)atoi(argv[1]) : 1);
+
+	i2c_shim_init(BUS_HZ);
+	eeprom_model_init(&model, 5000, 0);
+	i2c_shim_attach(&model.device);
+	lm75_model_init(&sensor, TEMPADR, 25 * 8);
+	i2c_shim_attach(&sensor.device);
+	i2c_bus_configure();
+	i2c_bus_set_speed(BUS_HZ);
+	eeprom_configure();
+	memset(expected, 0xFF, sizeof(expected));
+
+	model.write_cycle_us = 3000;
+	model.jitter_us = 1500;
+	int errors = check_random();
+	errors += check_page_wrap();
+	errors += check_chain();
+	errors += check_timeout();
+	errors += check_recovery();
+	errors += check_priority();
+	errors += check_cache();
+	if(errors){
+		return 1;
+	}
+	printf("Driver matches the EEPROM model\n\n");
+
+	printf("%6s %6s %9s %9s %7s %9s %7s %7s\n", "tWC us", "jitter", "write B/s", "read B/s", "mean us",
+	       "polls/pg", "first", "every");
+	i2c_stats_reset();
+	bench(5000, 0);
+	bench(3000, 1500);
+	bench(1500, 500);
+	errors += check_memory("the benchmark");
+
+	// Transfer times over the benchmark, from the first START to the end (page writes, polls and reads)
+	const struct I2C_Device_Stats* d = i2c_device_stats(EEPROMADR);
+	printf("\n%u transfers, %u NACKed, longest %u us\n", (unsigned)d->transfers, (unsigned)d->nacks,
+	       (unsigned)d->max_us);
+	for(int i=0; i<I2C_LATENCY_BINS; i++){
+		if(i < I2C_LATENCY_BINS-1){
+			printf("  < %5u us %7u\n", (unsigned)(I2C_LATENCY_BIN_US << i), (unsigned)d->histogram[i]);
+		}
+		else{
+			printf(" >= %5u us %7u\n", (unsigned)(I2C_LATENCY_BIN_US << (i - 1)), (unsigned)d->histogram[i]);
+		}
+	}
+
+	// A sensor read waits for at most one EEPROM transfer (a page write, a poll or a read chunk)
+	printf("\n%-14s %6s %9s %9s\n", "sensor reads", "reads", "mean us", "max us");
+	sensor_delay("EEPROM write", 1);
+	if(argc > 2){
+		errors += save_trace(argv[2]);
+	}
+	sensor_delay("EEPROM read", 0);
+
+	// Throughput against the SCL clock (the bytes on the bus, less the START, address and ACK overhead)
+	printf("\n%6s %6s %9s %9s\n", "kHz", "SCL Hz", "LM75 B/s", "read B/s");
+	errors += speed(I2C_SPEED_MIN);
+	errors += speed(50000);
+	errors += speed(I2C_SPEED_STANDARD);
+	errors += speed(200000);
+	errors += speed(I2C_SPEED_FAST);
+	if(i2c_bus_set_speed(1000000) != 0 || i2c_bus_speed() != I2C_SPEED_FAST){
+		printf("Speed beyond fast mode was taken\n");
+		errors++;
+	}
+
+	const struct I2C_Shim_Stats* bus = i2c_shim_stats();
+	printf("\n%u STARTs, %u NACKs, %u bytes, %u interrupts\n", (unsigned)bus->starts, (unsigned)bus->nacks,
+	       (unsigned)bus->bytes, (unsigned)bus->interrupts);
+	return errors != 0;
+}
@@ -0,0 +1,121 @@
+/*
+EEPROM Model
+Behaviour of the 24LC64 at EEPROMADR on the emulated I2C bus (I2C_Shim.c):
+- Two address bytes follow the control byte for a write and load the address pointer.
+- Data bytes go into the page buffer at the pointer, which wraps around within the page, so bytes past the end of
+  the page overwrite its start.
+- The STOP after data bytes starts the internal write cycle, which copies the written bytes of the page buffer to
+  the memory. The control byte is not acknowledged until the cycle is over. A (RE)START before the STOP discards
+  the page buffer.
+- Reads return the byte at the pointer and move it on, wrapping around at the end of the memory, for as long as
+  the master acknowledges.
+The memory starts erased (0xFF).
+*/
+
+#include <string.h>
+
+#include "EEPROM_Model.h"
+
+#define PHASE_HIGH 0 // Next byte written is the address high byte
+#define PHASE_LOW  1 // Address low byte
+#define PHASE_DATA 2 // Data bytes
+
+static int model_start(void* context, uint8_t control, uint64_t now){
+	struct EEPROM_Model* m = context;
+	
+	if(eeprom_model_busy(m, now)){
+		m->busy_nacks++;
+		return 0;
+	}
+	m->page_mask = 0; // Write not completed by a STOP
+	if(!(control & 1)){
+		m->phase = PHASE_HIGH;
+	}
+	return 1;
+}
+
+static int model_write(void* context, uint8_t data, uint64_t now){
+	struct EEPROM_Model* m = context;
+	(void)now;
+	
+	switch(m->phase){
+		case PHASE_HIGH:
+			m->pointer = (uint16_t)((data << 8) & (EEPROM_SIZE - 1)); // Upper bits are don't care
+			m->phase = PHASE_LOW;
+			break;
+			
+		case PHASE_LOW:
+			m->pointer |= data;
+			m->page_base = m->pointer - (m->pointer % EEPROM_PAGE_SIZE);
+			m->phase = PHASE_DATA;
+			break;
+			
+		default:{
+			if(m->fail_writes){
+				m->fail_writes--;
+				m->page_mask = 0; // Nothing of this write is kept
+				return 0;
+			}
+			uint16_t offset = m->pointer % EEPROM_PAGE_SIZE;
+			m->page[offset] = data;
+			m->page_mask |= 1u << offset;
+			m->pointer = m->page_base + (offset + 1) % EEPROM_PAGE_SIZE; // Wraps within the page
+			m->bytes_written++;
+			break;
+		}
+	}
+	return 1;
+}
+
+static uint8_t model_read(void* context, int ack, uint64_t now){
+	struct EEPROM_Model* m = context;
+	(void)ack;
+	(void)now;
+	
+	uint8_t data = m->memory[m->pointer];
+	m->pointer = (m->pointer + 1) % EEPROM_SIZE;
+	m->bytes_read++;
+	return data;
+}
+
+static void model_stop(void* context, uint64_t now){
+	struct EEPROM_Model* m = context;
+	
+	if(m->page_mask){
+		for(int i=0; i<EEPROM_PAGE_SIZE; i++){
+			if(m->page_mask & (1u << i)){
+				m->memory[m->page_base + i] = m->page[i];
+			}
+		}
+		m->page_mask = 0;
+		
+		uint32_t cycle = m->write_cycle_us;
+		if(m->jitter_us){
+			m->seed = m->seed * 1103515245u + 12345u;
+			cycle += (m->seed >> 8) % (m->jitter_us + 1);
+		}
+		m->busy_until = now + (uint64_t)cycle * 1000;
+		m->page_writes++;
+	}
+	m->phase = PHASE_HIGH;
+}
+
+void eeprom_model_init(struct EEPROM_Model* m, uint32_t write_cycle_us, uint32_t jitter_us){
+	// Erased memory, not busy
+	memset(m, 0, sizeof(*m));
+	memset(m->memory, 0xFF, sizeof(m->memory));
+	m->write_cycle_us = write_cycle_us;
+	m->jitter_us = jitter_us;
+	m->seed = 1;
+	m->device.address = EEPROMADR;
+	m->device.context = m;
+	m->device.start = model_start;
+	m->device.write = model_write;
+	m->device.read = model_read;
+	m->device.stop = model_stop;
+}
+
+int eeprom_model_busy(const struct EEPROM_Model* m, uint64_t now){
+	// 1 while the internal write cycle runs
+	return now < m->busy_until;
+}
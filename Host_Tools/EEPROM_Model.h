@@ -0,0 +1,33 @@
+#ifndef __EEPROM_MODEL_H
+#define __EEPROM_MODEL_H
+
+#include <stdint.h>
+
+#include "EEPROM.h"
+#include "I2C_Shim.h"
+
+// 24LC64 on the emulated bus
+struct EEPROM_Model {
+	struct I2C_Device device; // Attach with i2c_shim_attach(&model.device)
+	unsigned char memory[EEPROM_SIZE];
+	uint32_t write_cycle_us; // Internal write cycle time
+	uint32_t jitter_us; // Each cycle takes up to this much longer (uniformly spread)
+	uint32_t seed; // For the jitter
+	uint64_t busy_until; // End of the current write cycle (ns)
+	uint16_t pointer; // Address pointer
+	int phase; // What the next byte written is (address high, address low or data)
+	unsigned char page[EEPROM_PAGE_SIZE]; // Page buffer
+	uint32_t page_mask; // Bytes of the page buffer that were written
+	uint16_t page_base; // Page the buffer belongs to
+	uint32_t page_writes; // Write cycles started
+	uint32_t bytes_written; // Data bytes received (before any overwriting in the page buffer)
+	uint32_t bytes_read;
+	uint32_t busy_nacks; // Control bytes not acknowledged because of a write cycle
+	uint32_t fail_writes; // Writes still to be refused: their first data byte is not acknowledged and nothing is written
+};
+
+// 			 EEPROM Model Functions
+void     eeprom_model_init(struct EEPROM_Model* m, uint32_t write_cycle_us, uint32_t jitter_us);
+int      eeprom_model_busy(const struct EEPROM_Model* m, uint64_t now);
+
+#endif /* __EEPROM_MODEL_H */
@@ -0,0 +1,191 @@
+/*
+Filter_Bench
+Runs the board's Filter.c (with the C versions of the Cortex-M4 DSP instructions) over a simulated temperature log
+with sensor noise and the odd spike. It checks every filter against a plain one-sample-at-a-time version, in
+blocks of random sizes and in place, and reports how far each output is from the noise-free temperature, the delay
+it adds and the time per sample on this machine. The target numbers (cycles per sample with the DSP instructions)
+come from the board built with FILTER_BENCH defined, which shows them on the LCD.
+
+Build and run (from Host_Tools):
+    gcc -O2 -I../Starter_Project/Inc -o Filter_Bench Filter_Bench.c ../Starter_Project/Filter.c -lm
+    ./Filter_Bench [samples]
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Filter.h"
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void simulate(int16_t* clean, int16_t* noisy, uint32_t n){
+	// A slow sine (a day in 0.125 degree steps) with a step or two of noise and a spike one sample in 200
+	for(uint32_t i=0; i<n; i++){
+		double t = 20 * 8 + 4 * 8 * sin(i * 2 * 3.14159265 / 86400.0);
+		clean[i] = (int16_t)lrint(t);
+		int32_t x = clean[i] + (rand() % 5) - 2;
+		if(rand() % 200 == 0){
+			x += (rand() % 2) ? 40 : -40;
+		}
+		noisy[i] = (int16_t)x;
+	}
+}
+
+static void reference(uint32_t type, uint32_t param, const int16_t* in, int16_t* out, uint32_t n){
+	// The same filters written the obvious way, one sample at a time
+	static int16_t window[FILTER_HISTORY];
+	int32_t y = 0;
+	for(uint32_t i=0; i<n; i++){
+		if(type == FILTER_BOXCAR || type == FILTER_MEDIAN){
+			uint32_t length = (type == FILTER_BOXCAR) ? 1u << param : param;
+			for(uint32_t k=0; k<length; k++){
+				window[k] = (i + 1 >= length - k) ? in[i + 1 + k - length] : in[0]; // Primed with the first sample
+			}
+			if(type == FILTER_BOXCAR){
+				int32_t sum = 0;
+				for(uint32_t k=0; k<length; k++){
+					sum += window[k];
+				}
+				out[i] = (int16_t)((sum + (param ? 1 << (param - 1) : 0)) >> param);
+			}
+			else{
+				for(uint32_t a=1; a<length; a++){ // Insertion sort
+					int16_t v = window[a];
+					uint32_t b = a;
+					for(; b>0 && window[b - 1] > v; b--){
+						window[b] = window[b - 1];
+					}
+					window[b] = v;
+				}
+				out[i] = window[length / 2];
+			}
+		}
+		else if(type == FILTER_EMA){
+			int32_t x = in[i] * (1 << FILTER_EMA_FRAC);
+			if(i == 0){
+				y = x;
+			}
+			y = (int32_t)(param * x + (32768 - param) * y + (1 << 14)) >> 15;
+			out[i] = (int16_t)((y + (1 << (FILTER_EMA_FRAC - 1))) >> FILTER_EMA_FRAC);
+		}
+		else{
+			out[i] = in[i];
+		}
+	}
+}
+
+static int check(uint32_t type, uint32_t param, const int16_t* in, int16_t* out, int16_t* expected, uint32_t n){
+	// Filters in blocks of 1-40 samples, in place, and compares with the reference
+	struct Filter f;
+	filter_init(&f, type, param);
+	reference(type, f.param, in, expected, n);
+	memcpy(out, in, sizeof(int16_t) * n);
+	for(uint32_t i=0; i<n; ){
+		uint32_t block = 1 + rand() % 40;
+		if(i + block > n) block = n - i;
+		filter_block(&f, out + i, out + i, block);
+		i += block;
+	}
+	for(uint32_t i=0; i<n; i++){
+		if(out[i] != expected[i]){
+			printf("MISMATCH type %u param %u at sample %u: %d, expected %d\n", (unsigned)type, (unsigned)param,
+			       (unsigned)i, out[i], expected[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char** argv){
+	uint32_t n = (argc > 1) ? (uint32_t)atoi(argv[1]) : 1000000;
+	int16_t* clean = malloc(sizeof(int16_t) * n);
+	int16_t* noisy = malloc(sizeof(int16_t) * n);
+	int16_t* out = malloc(sizeof(int16_t) * n);
+	int16_t* expected = malloc(sizeof(int16_t) * n);
+	if(!clean || !noisy || !out || !expected){
+		printf("Out of memory\n");
+		return 1;
+	}
+	srand(1);
+	simulate(clean, noisy, n);
+
+	// Every setting against the reference, on a shorter log (the reference boxcar is slow)
+	uint32_t short_n = n < 20000 ? n : 20000;
+	int errors = 0;
+	for(uint32_t p=0; p<=FILTER_BOXCAR_MAX_SHIFT; p++){
+		errors += check(FILTER_BOXCAR, p, noisy, out, expected, short_n);
+	}
+	for(uint32_t p=1; p<=FILTER_MEDIAN_MAX; p+=2){
+		errors += check(FILTER_MEDIAN, p, noisy, out, expected, short_n);
+	}
+	uint32_t alphas[] = { 1, 1000, 4096, 8192, 16384, 32767 };
+	for(uint32_t a=0; a<sizeof(alphas)/sizeof(alphas[0]); a++){
+		errors += check(FILTER_EMA, alphas[a], noisy, out, expected, short_n);
+	}
+	errors += check(FILTER_NONE, 0, noisy, out, expected, short_n);
+	if(errors){
+		return 1;
+	}
+	printf("Filters match the reference\n\n");
+
+	const struct { uint32_t type; uint32_t param; const char* name; } settings[] = {
+		{ FILTER_NONE, 0, "none" },
+		{ FILTER_BOXCAR, 3, "boxcar 8" },
+		{ FILTER_BOXCAR, 5, "boxcar 32" },
+		{ FILTER_EMA, 8192, "EMA 1/4" },
+		{ FILTER_EMA, 2048, "EMA 1/16" },
+		{ FILTER_MEDIAN, 3, "median 3" },
+		{ FILTER_MEDIAN, 5, "median 5" },
+		{ FILTER_MEDIAN, 9, "median 9" },
+	};
+	printf("%-10s %9s %9s %9s %9s\n", "filter", "RMS deg", "max step", "delay", "ns/sample");
+	for(uint32_t s=0; s<sizeof(settings)/sizeof(settings[0]); s++){
+		struct Filter f;
+		double best = 1e9;
+		for(int rep=0; rep<3; rep++){
+			filter_init(&f, settings[s].type, settings[s].param);
+			double t0 = now();
+			for(uint32_t i=0; i<n; i+=32){
+				filter_block(&f, noisy + i, out + i, (n - i < 32) ? n - i : 32); // Blocks as the main loop uses
+			}
+			double t1 = now();
+			if(t1 - t0 < best) best = t1 - t0;
+		}
+
+		// Error against the clean signal, at the delay (in samples) that fits best
+		double best_rms = 1e9;
+		int32_t max_err = 0;
+		uint32_t delay = 0;
+		for(uint32_t d=0; d<20; d++){
+			double sum = 0;
+			int32_t worst = 0;
+			for(uint32_t i=100; i<n; i++){
+				int32_t e = out[i] - clean[i - d];
+				sum += (double)e * e;
+				if(abs(e) > worst) worst = abs(e);
+			}
+			double rms = sqrt(sum / (n - 100));
+			if(rms < best_rms){
+				best_rms = rms;
+				max_err = worst;
+				delay = d;
+			}
+		}
+		printf("%-10s %9.3f %9d %9u %9.2f\n", settings[s].name, best_rms / 8, max_err, (unsigned)delay,
+		       best / n * 1e9);
+	}
+	printf("(error from the noise-free temperature in degrees and 0.125 degree steps, delay in samples)\n");
+
+	free(clean);
+	free(noisy);
+	free(out);
+	free(expected);
+	return 0;
+}
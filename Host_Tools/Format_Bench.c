@@ -0,0 +1,111 @@
+/*
+Format_Bench
+Checks the board's Format.c against sprintf: every 11-bit temperature reading against "%.3f" of the signed value
+in degrees, and hex and decimal values (all small ones, then random ones over the 32-bit range) against "%x" and
+"%u". Then reports the time per call of sprintf and of Format.c on this machine. The target numbers (cycles per
+call on the Cortex-M4) come from the board built with FORMAT_BENCH defined, which shows them on the LCD.
+
+Build and run (from Host_Tools):
+    gcc -O2 -I../Starter_Project/Inc -o Format_Bench Format_Bench.c ../Starter_Project/Format.c
+    ./Format_Bench [calls]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Format.h"
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t random32(uint32_t* state){
+	// xorshift32
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static int16_t signed_sample(uint32_t v){
+	// The 11-bit reading sign extended, in 0.125 degree steps
+	return (int16_t)((uint16_t)(v << 5)) >> 5;
+}
+
+static int compare(const char* what, uint32_t value, const char* got, uint32_t length, const char* expected){
+	if(strcmp(got, expected) != 0 || length != strlen(expected)){
+		printf("MISMATCH %s of %08x: \"%s\" (length %u), expected \"%s\"\n", what, (unsigned)value, got,
+		       (unsigned)length, expected);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv){
+	uint32_t calls = (argc > 1) ? (uint32_t)atoi(argv[1]) : 10000000;
+	char got[32];
+	char expected[32];
+	int errors = 0;
+
+	for(uint32_t v=0; v<0x800; v++){
+		snprintf(expected, sizeof(expected), "%.3f", signed_sample(v) * 0.125);
+		errors += compare("temperature", v, got, format_temperature(got, (uint16_t)v), expected);
+		// Bits above the 11 are ignored
+		errors += compare("temperature", v | 0xF800, got, format_temperature(got, (uint16_t)(v | 0xF800)), expected);
+	}
+	uint32_t state = 1;
+	for(uint32_t i=0; i<2000000; i++){
+		uint32_t v = (i < 1000000) ? i : random32(&state) >> (random32(&state) & 31);
+		snprintf(expected, sizeof(expected), "%x", (unsigned)v);
+		errors += compare("hex", v, got, format_hex(got, v), expected);
+		snprintf(expected, sizeof(expected), "%u", (unsigned)v);
+		errors += compare("uint", v, got, format_uint(got, v), expected);
+		if(errors > 10){
+			break;
+		}
+	}
+	snprintf(expected, sizeof(expected), "%x", 0xFFFFFFFFu);
+	errors += compare("hex", 0xFFFFFFFFu, got, format_hex(got, 0xFFFFFFFFu), expected);
+	snprintf(expected, sizeof(expected), "%u", 0xFFFFFFFFu);
+	errors += compare("uint", 0xFFFFFFFFu, got, format_uint(got, 0xFFFFFFFFu), expected);
+	if(errors){
+		return 1;
+	}
+	printf("Format.c matches sprintf\n\n");
+
+	// Time per call, best of 3. The sum of the lengths keeps the calls from being optimised away
+	const char* names[4] = { "sprintf %f", "format_temperature", "sprintf %x", "format_hex" };
+	double best[4] = { 1e9, 1e9, 1e9, 1e9 };
+	volatile uint32_t sink = 0;
+	for(int rep=0; rep<3; rep++){
+		for(int k=0; k<4; k++){
+			uint32_t total = 0;
+			double t0 = now();
+			for(uint32_t i=0; i<calls; i++){
+				uint32_t v = i * 0x9E3779B1u;
+				switch(k){
+					case 0: total += (uint32_t)sprintf(got, "%f", (v & 0x7FF) * 0.125f); break;
+					case 1: total += format_temperature(got, (uint16_t)v); break;
+					case 2: total += (uint32_t)sprintf(got, "%x", (unsigned)v); break;
+					default: total += format_hex(got, v); break;
+				}
+			}
+			double t1 = now();
+			sink += total;
+			if(t1 - t0 < best[k]) best[k] = t1 - t0;
+		}
+	}
+	printf("%-20s %9s\n", "", "ns/call");
+	for(int k=0; k<4; k++){
+		printf("%-20s %9.2f\n", names[k], best[k] / calls * 1e9);
+	}
+	printf("temperature %.1fx faster, hex %.1fx faster\n", best[0] / best[1], best[2] / best[3]);
+	(void)sink;
+	return 0;
+}
@@ -0,0 +1,189 @@
+/*
+I2C_Replay
+Replays an I2C trace from the board (the ring of I2C_Bus.c, saved from RAM with the debugger as a binary file) on
+the emulated bus, with the board's I2C_Bus.c, against the 24LC64 model at EEPROMADR and an LM75 model at each
+sensor address (0x90-0x9E) that appears in the trace; other addresses have no device and are not acknowledged.
+Each transaction is queued at its recorded time, from its start, with the same address, lengths and chaining (the
+transfers not run after their chain failed on the board, recorded with 0 tries, are queued in that chain). Only
+the first I2C_TRACE_BYTES of each write were recorded, the rest are written as 0 (for an EEPROM page write that is
+the data, the memory address is in the first two bytes). The engine records the replay in its own trace, and the
+tool prints the two side by side and marks the transactions whose status differs or whose duration is more than
+a quarter (and 50 us) off, to reproduce protocol and timing problems offline: a device not answering, polls
+NACKed for longer than the write cycle time given, transfers stretched or retried on the board.
+
+Build and run (from Host_Tools):
+    gcc -O2 -no-pie -II2C_Shim -I../Starter_Project/Inc -I../Starter_Project -o I2C_Replay I2C_Replay.c EEPROM_Model.c LM75_Model.c I2C_Shim.c ../Starter_Project/I2C_Bus.c
+    ./I2C_Replay trace.bin [bus kHz, the trace's speed by default] [EEPROM write cycle us, 5000 by default]
+(EEPROM_Bench writes a trace of its own to try it with: ./EEPROM_Bench 1 trace.bin)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "I2C_Bus.h"
+#include "EEPROM.h"
+#include "EEPROM_Model.h"
+#include "LM75_Model.h"
+#include "Time_Delays.h"
+
+#define LM75_FIRST 0x90
+#define LM75_LAST  0x9E
+
+#define REPLAY_BYTES 256 // Longest write or read replayed
+
+// Buffers handed to the driver are static, DMA addresses are 32 bits
+static struct I2C_Trace trace; // From the file
+static struct I2C_Trace_Entry recorded[I2C_TRACE_SIZE];
+static struct I2C_Trace_Entry replayed[I2C_TRACE_SIZE];
+static struct I2C_Transfer transfers[I2C_TRACE_SIZE];
+static unsigned char tx[I2C_TRACE_SIZE][REPLAY_BYTES];
+static unsigned char rx[I2C_TRACE_SIZE][REPLAY_BYTES];
+
+static struct EEPROM_Model eeprom;
+static struct LM75_Model sensors[(LM75_LAST - LM75_FIRST) / 2 + 1];
+
+static const char* status_name(uint32_t status){
+	static const char* names[] = { "pending", "ok", "NACK", "NACK data", "error", "timeout" };
+	return (status <= I2C_TIMEOUT) ? names[status] : "?";
+}
+
+static void print_bytes(char direction, uint32_t length, const uint8_t* data){
+	// "W3 00 10 2A    " for the first bytes of a write or a read
+	char text[32];
+	int n = 0;
+	if(length){
+		n = sprintf(text, "%c%u", direction, (unsigned)length);
+		for(uint32_t i=0; i<length && i<I2C_TRACE_BYTES; i++){
+			n += sprintf(text + n, " %02X", data[i]);
+		}
+	}
+	text[n] = 0;
+	printf(" %-16s", text);
+}
+
+static uint32_t load(const char* path){
+	// Reads the trace and puts its entries in order, oldest first. Returns the number of entries
+	FILE* f = fopen(path, "rb");
+	if(!f){
+		printf("Cannot open %s\n", path);
+		return 0;
+	}
+	size_t size = fread(&trace, 1, sizeof(trace), f);
+	fclose(f);
+	if(size != sizeof(trace) || trace.magic != I2C_TRACE_MAGIC || trace.size != I2C_TRACE_SIZE){
+		printf("%s is not an I2C trace of %u entries (%u bytes)\n", path, I2C_TRACE_SIZE, (unsigned)sizeof(trace));
+		return 0;
+	}
+	uint32_t n = (trace.head < I2C_TRACE_SIZE) ? trace.head : I2C_TRACE_SIZE;
+	for(uint32_t i=0; i<n; i++){
+		recorded[i] = trace.entry[(trace.head - n + i) & (I2C_TRACE_SIZE - 1)];
+	}
+	return n;
+}
+
+static void replay(uint32_t n){
+	// Queues each chain of transactions at its recorded time and waits for it to finish
+	uint64_t t0 = i2c_shim_now();
+	for(uint32_t i=0; i<n; ){
+		uint32_t first = i;
+		for(;;){
+			const struct I2C_Trace_Entry* e = &recorded[i];
+			struct I2C_Transfer* t = &transfers[i];
+			memset(t, 0, sizeof(*t));
+			t->address = e->address;
+			t->flags = e->flags & I2C_CHAIN;
+			t->priority = I2C_PRIORITY_NORMAL;
+			t->tx = tx[i];
+			t->tx_length = (e->write_length < sizeof(tx[i])) ? e->write_length : sizeof(tx[i]);
+			memset(tx[i], 0, sizeof(tx[i]));
+			memcpy(tx[i], e->write, (t->tx_length < I2C_TRACE_BYTES) ? t->tx_length : I2C_TRACE_BYTES);
+			t->rx = rx[i];
+			t->rx_length = (e->read_length < sizeof(rx[i])) ? e->read_length : sizeof(rx[i]);
+			i++;
+			if(i == n || (!(t->flags & I2C_CHAIN) && recorded[i].tries != 0)){
+				t->flags = 0;
+				break;
+			}
+			t->flags = I2C_CHAIN;
+		}
+		uint64_t at = t0 + (uint64_t)(recorded[first].time_us - recorded[0].time_us) * 1000;
+		if(i2c_shim_now() < at){
+			delay_us((uint32_t)((at - i2c_shim_now()) / 1000));
+		}
+		i2c_submit(&transfers[first], i - first);
+		i2c_wait(&transfers[i - 1]);
+	}
+}
+
+static int differs(const struct I2C_Trace_Entry* a, const struct I2C_Trace_Entry* b){
+	uint32_t d = (a->duration_us > b->duration_us) ? a->duration_us - b->duration_us : b->duration_us - a->duration_us;
+	return a->status != b->status || (d > 50 && d * 4 > a->duration_us);
+}
+
+int main(int argc, char** argv){
+	if(argc < 2){
+		printf("usage: %s trace.bin [bus kHz] [EEPROM write cycle us]\n", argv[0]);
+		return 1;
+	}
+	uint32_t n = load(argv[1]);
+	if(n == 0){
+		return 1;
+	}
+	uint32_t hz = (argc > 2) ? (uint32_t)atoi(argv[2]) * 1000 : (trace.speed ? trace.speed : I2C_SPEED_FAST);
+	uint32_t cycle_us = (argc > 3) ? (uint32_t)atoi(argv[3]) : 5000;
+
+	i2c_shim_init(hz);
+	eeprom_model_init(&eeprom, cycle_us, 0);
+	i2c_shim_attach(&eeprom.device);
+	for(uint32_t i=0; i<n; i++){
+		uint8_t a = recorded[i].address;
+		struct LM75_Model* s = &sensors[(a - LM75_FIRST) / 2];
+		if(a >= LM75_FIRST && a <= LM75_LAST && s->device.address == 0){
+			lm75_model_init(s, a, 25 * 8);
+			i2c_shim_attach(&s->device);
+		}
+	}
+	i2c_bus_configure();
+	if(i2c_bus_set_speed(hz) == 0){
+		printf("%u Hz cannot be set\n", (unsigned)hz);
+		return 1;
+	}
+
+	printf("%u transactions over %u ms, recorded at %u Hz, replayed at %u Hz\n\n", (unsigned)n,
+	       (unsigned)((recorded[n - 1].time_us - recorded[0].time_us) / 1000), (unsigned)trace.speed,
+	       (unsigned)i2c_bus_speed());
+	replay(n);
+	uint32_t m = i2c_trace_copy(replayed, I2C_TRACE_SIZE);
+
+	uint32_t marked = 0;
+	printf("%10s %4s %-16s %-16s %-9s %6s %-9s %6s\n", "ms", "addr", " write", " read", "board", "us",
+	       "replay", "us");
+	for(uint32_t i=0; i<n; i++){
+		const struct I2C_Trace_Entry* e = &recorded[i];
+		const struct I2C_Trace_Entry* r = (i < m) ? &replayed[i] : 0;
+		printf("%10.3f   %02X", (e->time_us - recorded[0].time_us) / 1000.0, e->address);
+		print_bytes('W', e->write_length, e->write);
+		print_bytes('R', e->read_length, e->read);
+		printf(" %-9s %6u", status_name(e->status), (unsigned)e->duration_us);
+		if(r){
+			printf(" %-9s %6u", status_name(r->status), (unsigned)r->duration_us);
+		}
+		else{
+			printf(" %-16s", "not run");
+		}
+		int marks = !r || differs(e, r);
+		marked += marks;
+		printf("%s", marks ? "  <<" : "");
+		if(e->tries > 1){
+			printf("  %u tries on the board", (unsigned)e->tries);
+		}
+		else if(e->tries == 0){
+			printf("  not run on the board");
+		}
+		printf("\n");
+	}
+	printf("\n%u of %u transactions differ (<<)\n", (unsigned)marked, (unsigned)n);
+	return 0;
+}
@@ -0,0 +1,782 @@
+/*
+I2C Shim
+Emulates the parts of the STM32F401 used by the I2C drivers (I2C1 as master, TIM5 in one pulse mode, DMA1 Stream 0
+for received bytes, the NVIC, the DWT cycle counter and the I2C1 pins as GPIO) so the board's driver sources build
+and run unchanged on Linux. The drivers
+include I2C_Shim/main.h instead of the firmware's main.h.
+Time is simulated: it moves on to the next bus or timer event whenever the emulated hardware is stepped, or by
+1 us when nothing is scheduled (the CPU is busy). The bus moves one bit per 1/bus_hz, a byte takes 9 bits, and
+the master stretches the clock while a flag (SB, ADDR, TXE with BTF, RXNE) waits for the software, like the
+STM32 does. Devices are attached as I2C_Device callbacks.
+Interrupts are delivered from SIGALRM, which interrupts the program like an exception interrupts the main loop,
+and also straight after any register access from the main program that leaves one pending. A flag read that
+finds the flag clear steps the hardware, so the drivers' polling loops make progress without the signal.
+DMA addresses are 32 bits, as on the STM32, so the tools have to be linked with -no-pie and only hand the
+drivers static buffers.
+Reading the cycle counter costs the CPU SHIM_DWT_NS, so a wait on it ends. Faults can be put on the bus for the
+recovery code: i2c_shim_stall makes a device hold SDA low after a control byte (nothing on the bus moves until SCL
+is clocked by hand, as after a glitch that left a device half way through a byte), i2c_shim_stall_data does the
+same part way through the bytes written to a device, and i2c_shim_glitch gives a bus error instead of an
+acknowledge.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "main.h"
+#include "Time_Delays.h"
+
+#define SHIM_DEVICES 8
+#define SHIM_TICK_US 20 // SIGALRM period (real time)
+#define SHIM_STORM 100000 // Interrupts without simulated time moving on before giving up
+#define SHIM_DWT_NS 100 // CPU time of a cycle counter read
+
+// Bus operations
+#define OP_NONE    0
+#define OP_START   1 // (RE)START condition
+#define OP_ADDRESS 2 // Control byte
+#define OP_TX      3 // Data byte to the device
+#define OP_RX      4 // Data byte from the device
+#define OP_HELD    5 // A device holds SDA low, nothing moves until it has been clocked free
+
+I2C_TypeDef shim_i2c1;
+TIM_TypeDef shim_tim5;
+DMA_TypeDef shim_dma1;
+GPIO_TypeDef shim_gpiob;
+CoreDebug_Type shim_coredebug;
+uint32_t SystemCoreClock = 84000000;
+
+static struct I2C_Shim_Stats stats;
+static uint64_t now_ns; // Simulated time
+static volatile sig_atomic_t depth; // Inside a register access from the main program
+static volatile sig_atomic_t in_isr; // Running an interrupt handler
+static volatile sig_atomic_t primask; // Interrupts masked by __disable_irq
+static uint32_t nvic_enabled[2];
+static uint32_t storm; // Handlers run since simulated time last moved
+
+static struct {
+	uint32_t bit_ns;
+	struct I2C_Device* devices[SHIM_DEVICES];
+	int count;
+	struct I2C_Device* device; // Device that acknowledged the control byte
+	int reading; // The device was addressed for reading
+	int op;
+	uint64_t op_end;
+	uint8_t shift; // Byte being shifted
+	uint8_t dr; // Data register
+	int dr_full; // Transmit byte waiting for the shift register
+	int rx_more; // Reception stalled on RXNE, carries on when DR is read
+	int start_req, stop_req;
+	int sb, addr, txe, btf, rxne, af, berr, arlo, ovr;
+	int it_evt, it_buf, it_err, dma_rx, last;
+	uint32_t stall, stall_clocks; // Control bytes still to be stalled, and the SCL pulses that free each one
+	uint32_t stall_byte; // Bytes still to be written before the one that is stalled (0 for none)
+	uint32_t held; // SCL pulses still needed before the device holding SDA lets it go
+	uint32_t glitch; // Control bytes still to end in a bus error
+} bus;
+
+static struct {
+	uint64_t tick_ns;
+	uint64_t end;
+	int running, uif, uie;
+} tim;
+
+static struct {
+	uint32_t memory;
+	uint32_t ndtr;
+	uint32_t index;
+	int enabled, tc, te, tcie, teie;
+} dma;
+
+// Default handlers, the drivers' handlers replace them (like the weak handlers of the startup file)
+__attribute__((weak)) void I2C1_EV_IRQHandler(void){}
+__attribute__((weak)) void I2C1_ER_IRQHandler(void){}
+__attribute__((weak)) void TIM5_IRQHandler(void){}
+__attribute__((weak)) void DMA1_Stream0_IRQHandler(void){}
+
+static void shim_dispatch(void);
+
+// A register access from the main program must not be interrupted by the signal half way
+#define SHIM_ENTER() do{ depth++; __atomic_signal_fence(__ATOMIC_SEQ_CST); }while(0)
+#define SHIM_EXIT()  do{ __atomic_signal_fence(__ATOMIC_SEQ_CST); depth--; shim_dispatch(); }while(0)
+
+/*---------------------------------------- Bus ----------------------------------------*/
+
+static void bus_begin(int op, uint32_t bits){
+	if(op == OP_ADDRESS && bus.stall){
+		bus.stall--;
+		bus.held = bus.stall_clocks;
+	}
+	if(op == OP_TX && bus.stall_byte && --bus.stall_byte == 0){
+		bus.held = bus.stall_clocks;
+	}
+	if(bus.held){
+		bus.op = OP_HELD; // Never ends by itself
+		bus.op_end = UINT64_MAX;
+		return;
+	}
+	bus.op = op;
+	bus.op_end = now_ns + (uint64_t)bits * bus.bit_ns;
+}
+
+static void bus_stop(void){
+	// STOP condition, the bus is free
+	if(bus.device && bus.device->stop){
+		bus.device->stop(bus.device->context, now_ns);
+	}
+	bus.device = 0;
+	bus.reading = 0;
+	bus.txe = 0;
+	bus.btf = 0;
+	bus.rx_more = 0;
+	bus.stop_req = 0;
+	shim_i2c1.CR1 &= ~I2C_CR1_STOP;
+}
+
+static void bus_start(void){
+	// (RE)START condition
+	bus.start_req = 0;
+	bus.txe = 0;
+	bus.btf = 0;
+	shim_i2c1.CR1 &= ~I2C_CR1_START;
+	bus_begin(OP_START, 1);
+}
+
+static void bus_after_byte(void){
+	// A pending START or STOP goes out once the byte has
+	if(bus.start_req){
+		bus_start();
+	}
+	else if(bus.stop_req){
+		bus_stop();
+	}
+}
+
+static void bus_event(void){
+	// The current bus operation has finished
+	int op = bus.op;
+	bus.op = OP_NONE;
+
+	switch(op){
+		case OP_START:
+			stats.starts++;
+			bus.sb = 1;
+			break;
+
+		case OP_ADDRESS:{
+			struct I2C_Device* device = 0;
+			if(bus.glitch){
+				bus.glitch--;
+				bus.device = 0;
+				bus.berr = 1;
+				break;
+			}
+			for(int i=0; i<bus.count; i++){
+				if(bus.devices[i]->address == (bus.shift & 0xFE)){
+					device = bus.devices[i];
+				}
+			}
+			if(device && device->start(device->context, bus.shift, now_ns)){
+				bus.device = device;
+				bus.reading = bus.shift & 1;
+				bus.addr = 1;
+			}
+			else{
+				stats.nacks++;
+				bus.device = 0;
+				bus.af = 1;
+			}
+			bus_after_byte();
+			break;
+		}
+
+		case OP_TX:
+			stats.bytes++;
+			if(!bus.device->write(bus.device->context, bus.shift, now_ns)){
+				bus.af = 1;
+				bus.dr_full = 0;
+			}
+			else if(bus.dr_full && !bus.start_req && !bus.stop_req){
+				bus.shift = bus.dr;
+				bus.dr_full = 0;
+				bus.txe = 1;
+				bus_begin(OP_TX, 9);
+				break;
+			}
+			else{
+				bus.btf = 1;
+			}
+			bus_after_byte();
+			break;
+
+		case OP_RX:{
+			int ack = (shim_i2c1.CR1 & I2C_CR1_ACK) && !(bus.dma_rx && bus.last && dma.enabled && dma.ndtr == 1);
+			uint8_t data = bus.device->read(bus.device->context, ack, now_ns);
+			stats.bytes++;
+			if(bus.dma_rx && dma.enabled){
+				((unsigned char*)(uintptr_t)dma.memory)[dma.index++] = data;
+				if(--dma.ndtr == 0){
+					dma.enabled = 0;
+					dma.tc = 1;
+				}
+			}
+			else{
+				if(bus.rxne){
+					bus.ovr = 1;
+				}
+				bus.dr = data;
+				bus.rxne = 1;
+			}
+			if(bus.start_req){
+				bus_start();
+			}
+			else if(bus.stop_req){
+				bus_stop();
+			}
+			else if(ack){
+				if(bus.rxne && !(bus.dma_rx && dma.enabled)){
+					bus.rx_more = 1; // Clock stretched until DR is read
+				}
+				else{
+					bus_begin(OP_RX, 9);
+				}
+			}
+			break;
+		}
+	}
+}
+
+/*---------------------------------------- Time ----------------------------------------*/
+
+static void shim_step(uint64_t limit){
+	// Moves simulated time on to the next event (but not past 'limit') and handles it, or by 1 us if nothing is
+	// scheduled
+	uint64_t next = UINT64_MAX;
+
+	if(bus.op != OP_NONE && bus.op_end < next) next = bus.op_end;
+	if(tim.running && tim.end < next) next = tim.end;
+
+	if(next == UINT64_MAX){
+		next = now_ns + 1000;
+	}
+	if(next > limit){
+		next = limit;
+	}
+	if(next > now_ns){
+		now_ns = next;
+		storm = 0;
+	}
+	if(bus.op != OP_NONE && bus.op_end <= now_ns){
+		bus_event();
+	}
+	if(tim.running && tim.end <= now_ns){
+		tim.running = 0; // One pulse mode
+		tim.uif = 1;
+	}
+}
+
+static void shim_tick(int signal){
+	// SIGALRM: the hardware carries on while the main program runs
+	(void)signal;
+	if(depth || in_isr){
+		return;
+	}
+	depth++;
+	shim_step(UINT64_MAX);
+	depth--;
+	shim_dispatch();
+}
+
+static int irq_enabled(IRQn_Type irq){
+	return (nvic_enabled[irq / 32] >> (irq % 32)) & 1;
+}
+
+static void shim_dispatch(void){
+	// Runs the pending interrupt handlers, in NVIC order (all the drivers use the same priority)
+	if(depth || in_isr || primask){
+		return;
+	}
+	for(;;){
+		void (*handler)(void) = 0;
+
+		if(irq_enabled(DMA1_Stream0_IRQn) && ((dma.tc && dma.tcie) || (dma.te && dma.teie))){
+			handler = DMA1_Stream0_IRQHandler;
+		}
+		else if(irq_enabled(I2C1_EV_IRQn) && bus.it_evt &&
+		        (bus.sb || bus.addr || bus.btf || (bus.it_buf && (bus.txe || bus.rxne)))){
+			handler = I2C1_EV_IRQHandler;
+		}
+		else if(irq_enabled(I2C1_ER_IRQn) && bus.it_err && (bus.af || bus.berr || bus.arlo || bus.ovr)){
+			handler = I2C1_ER_IRQHandler;
+		}
+		else if(irq_enabled(TIM5_IRQn) && tim.uie && tim.uif){
+			handler = TIM5_IRQHandler;
+		}
+		else{
+			return;
+		}
+
+		if(++storm > SHIM_STORM){
+			fprintf(stderr, "I2C shim: interrupt storm (a handler is not clearing its flag)\n");
+			abort();
+		}
+		stats.interrupts++;
+		in_isr = 1;
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);
+		handler();
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);
+		in_isr = 0;
+	}
+}
+
+static uint32_t shim_flag(int* flag){
+	// Reads a flag, a polling loop that finds it clear lets the hardware move on
+	SHIM_ENTER();
+	if(!*flag && !in_isr){
+		shim_step(UINT64_MAX);
+	}
+	uint32_t set = *flag;
+	SHIM_EXIT();
+	return set;
+}
+
+/*---------------------------------------- Shim ----------------------------------------*/
+
+void i2c_shim_init(uint32_t bus_hz){
+	// Resets the emulated hardware and starts delivering interrupts
+	struct sigaction action;
+	struct itimerval period;
+
+	memset(&bus, 0, sizeof(bus));
+	memset(&tim, 0, sizeof(tim));
+	memset(&dma, 0, sizeof(dma));
+	memset(&stats, 0, sizeof(stats));
+	bus.bit_ns = 1000000000u / bus_hz;
+	tim.tick_ns = 1000;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = shim_tick;
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGALRM, &action, 0);
+	period.it_interval.tv_sec = 0;
+	period.it_interval.tv_usec = SHIM_TICK_US;
+	period.it_value = period.it_interval;
+	setitimer(ITIMER_REAL, &period, 0);
+}
+
+void i2c_shim_attach(struct I2C_Device* device){
+	// Puts a device on the bus
+	SHIM_ENTER();
+	if(bus.count < SHIM_DEVICES){
+		bus.devices[bus.count++] = device;
+	}
+	SHIM_EXIT();
+}
+
+uint64_t i2c_shim_now(void){
+	// Simulated time in ns
+	return now_ns;
+}
+
+const struct I2C_Shim_Stats* i2c_shim_stats(void){
+	return &stats;
+}
+
+void i2c_shim_stall(uint32_t count, uint32_t clocks){
+	// The next 'count' control bytes are not answered: a device holds SDA low until SCL has been pulsed 'clocks'
+	// times by hand (more than the master gives in a recovery keeps the bus held)
+	SHIM_ENTER();
+	bus.stall = count;
+	bus.stall_clocks = clocks ? clocks : 1;
+	SHIM_EXIT();
+}
+
+void i2c_shim_stall_data(uint32_t byte, uint32_t clocks){
+	// The device being written holds SDA low during the 'byte'th byte written from now on (1 is the next one), the
+	// bytes before it have been taken, until SCL has been pulsed 'clocks' times by hand
+	SHIM_ENTER();
+	bus.stall_byte = byte;
+	bus.stall_clocks = clocks ? clocks : 1;
+	SHIM_EXIT();
+}
+
+void i2c_shim_glitch(uint32_t count){
+	// The next 'count' control bytes end in a bus error
+	SHIM_ENTER();
+	bus.glitch = count;
+	SHIM_EXIT();
+}
+
+/*---------------------------------------- Time_Delays ----------------------------------------*/
+
+uint32_t micros(void){
+	return (uint32_t)(now_ns / 1000);
+}
+
+uint32_t millis(void){
+	return (uint32_t)(now_ns / 1000000);
+}
+
+void delay_us(uint32_t t){
+	// The CPU is busy for 't' us, the hardware carries on (and interrupts) meanwhile
+	uint64_t end = now_ns + (uint64_t)t * 1000;
+	while(now_ns < end){
+		SHIM_ENTER();
+		shim_step(end);
+		SHIM_EXIT();
+	}
+}
+
+void delay_ms(uint32_t t){
+	delay_us(t * 1000);
+}
+
+DWT_Type* shim_dwt(void){
+	// The cycle counter, kept in step with the simulated time. The read takes the CPU SHIM_DWT_NS, the hardware
+	// carries on meanwhile (also inside a handler, a handler may wait on the counter)
+	static DWT_Type dwt;
+	SHIM_ENTER();
+	shim_step(now_ns + SHIM_DWT_NS);
+	dwt.CYCCNT = (uint32_t)(now_ns * (SystemCoreClock / 1000000) / 1000);
+	SHIM_EXIT();
+	return &dwt;
+}
+
+/*---------------------------------------- NVIC and RCC ----------------------------------------*/
+
+void __disable_irq(void){
+	primask = 1;
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+void __enable_irq(void){
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	primask = 0;
+	shim_dispatch();
+}
+
+uint32_t __get_PRIMASK(void){
+	return (uint32_t)primask;
+}
+
+void __set_PRIMASK(uint32_t mask){
+	if(mask){
+		__disable_irq();
+	}
+	else{
+		__enable_irq();
+	}
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority){
+	(void)irq;
+	(void)priority;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq){
+	SHIM_ENTER();
+	nvic_enabled[irq / 32] |= 1u << (irq % 32);
+	SHIM_EXIT();
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq){
+	SHIM_ENTER();
+	nvic_enabled[irq / 32] &= ~(1u << (irq % 32));
+	SHIM_EXIT();
+}
+
+void LL_APB1_GRP1_EnableClock(uint32_t periphs){
+	(void)periphs;
+}
+
+void LL_AHB1_GRP1_EnableClock(uint32_t periphs){
+	(void)periphs;
+}
+
+void LL_RCC_GetSystemClocksFreq(LL_RCC_ClocksTypeDef* clocks){
+	// The board's clock tree: no prescalers after SYSCLK
+	clocks->SYSCLK_Frequency = SystemCoreClock;
+	clocks->HCLK_Frequency = SystemCoreClock;
+	clocks->PCLK1_Frequency = SystemCoreClock;
+	clocks->PCLK2_Frequency = SystemCoreClock;
+}
+
+/*---------------------------------------- GPIO ----------------------------------------*/
+
+static int gpio_level(uint32_t pin){
+	// Level the GPIO puts on a pin: low only as an output driven low (open drain, pulled up)
+	uint32_t index = (uint32_t)__builtin_ctz(pin);
+	return ((shim_gpiob.MODER >> (2 * index)) & 3) != LL_GPIO_MODE_OUTPUT || (shim_gpiob.ODR & pin);
+}
+
+static void gpio_update(uint32_t odr){
+	// The pins change as ODR is written: a falling SCL clocks a device holding SDA, and SDA rising while SCL is
+	// high is a STOP
+	int scl = gpio_level(LL_GPIO_PIN_8);
+	int sda = gpio_level(LL_GPIO_PIN_9) && !bus.held;
+
+	shim_gpiob.ODR = odr;
+	if(scl && !gpio_level(LL_GPIO_PIN_8)){
+		stats.clocks++;
+		if(bus.held && --bus.held == 0){
+			bus.op = OP_NONE;
+		}
+	}
+	if(!sda && scl && gpio_level(LL_GPIO_PIN_8) && gpio_level(LL_GPIO_PIN_9) && !bus.held){
+		if(bus.device && bus.device->stop){
+			bus.device->stop(bus.device->context, now_ns);
+		}
+		bus.device = 0;
+		bus.reading = 0;
+	}
+}
+
+void LL_GPIO_SetPinMode(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t mode){
+	uint32_t index = (uint32_t)__builtin_ctz(pin);
+	SHIM_ENTER();
+	GPIOx->MODER = (GPIOx->MODER & ~(3u << (2 * index))) | (mode << (2 * index));
+	SHIM_EXIT();
+}
+
+void LL_GPIO_SetOutputPin(GPIO_TypeDef* GPIOx, uint32_t pins){ SHIM_ENTER(); gpio_update(GPIOx->ODR | pins); SHIM_EXIT(); }
+void LL_GPIO_ResetOutputPin(GPIO_TypeDef* GPIOx, uint32_t pins){ SHIM_ENTER(); gpio_update(GPIOx->ODR & ~pins); SHIM_EXIT(); }
+
+uint32_t LL_GPIO_IsInputPinSet(GPIO_TypeDef* GPIOx, uint32_t pins){
+	(void)GPIOx;
+	SHIM_ENTER();
+	uint32_t set = (!(pins & LL_GPIO_PIN_8) || gpio_level(LL_GPIO_PIN_8)) &&
+	               (!(pins & LL_GPIO_PIN_9) || (gpio_level(LL_GPIO_PIN_9) && !bus.held));
+	SHIM_EXIT();
+	return set;
+}
+
+/*---------------------------------------- I2C ----------------------------------------*/
+
+void LL_I2C_Enable(I2C_TypeDef* I2Cx){ (void)I2Cx; }
+void LL_I2C_Disable(I2C_TypeDef* I2Cx){ (void)I2Cx; }
+void LL_I2C_DisableReset(I2C_TypeDef* I2Cx){ (void)I2Cx; }
+
+void LL_I2C_ConfigSpeed(I2C_TypeDef* I2Cx, uint32_t clock, uint32_t speed, uint32_t duty){
+	// The LL driver's register values (duty cycle 2 only), and the bus runs at the frequency CCR gives
+	uint32_t mhz = clock / 1000000;
+	uint32_t ccr;
+	(void)duty;
+	SHIM_ENTER();
+	I2Cx->CR2 = (I2Cx->CR2 & ~I2C_CR2_FREQ) | mhz;
+	if(speed > 100000){
+		ccr = clock / (speed * 3);
+		ccr = (ccr & I2C_CCR_CCR) ? ccr : 1;
+		I2Cx->TRISE = mhz * 300 / 1000 + 1;
+		I2Cx->CCR = I2C_CCR_FS | ccr;
+		bus.bit_ns = (uint32_t)(3ull * ccr * 1000000000u / clock);
+	}
+	else{
+		ccr = clock / (speed * 2);
+		ccr = ((ccr & I2C_CCR_CCR) < 4) ? 4 : ccr;
+		I2Cx->TRISE = mhz + 1;
+		I2Cx->CCR = ccr;
+		bus.bit_ns = (uint32_t)(2ull * ccr * 1000000000u / clock);
+	}
+	SHIM_EXIT();
+}
+
+void LL_I2C_EnableReset(I2C_TypeDef* I2Cx){
+	// Software reset: the peripheral forgets the transaction and its registers (the pins stay as they are)
+	SHIM_ENTER();
+	bus.op = bus.held ? OP_HELD : OP_NONE;
+	bus.device = 0;
+	bus.reading = 0;
+	bus.dr_full = 0;
+	bus.rx_more = 0;
+	bus.start_req = 0;
+	bus.stop_req = 0;
+	bus.sb = bus.addr = bus.txe = bus.btf = bus.rxne = bus.af = bus.berr = bus.arlo = bus.ovr = 0;
+	bus.it_evt = bus.it_buf = bus.it_err = bus.dma_rx = bus.last = 0;
+	I2Cx->CR1 = 0;
+	I2Cx->CR2 = 0;
+	I2Cx->CCR = 0;
+	I2Cx->TRISE = 0;
+	stats.resets++;
+	SHIM_EXIT();
+}
+
+void LL_I2C_GenerateStartCondition(I2C_TypeDef* I2Cx){
+	(void)I2Cx;
+	SHIM_ENTER();
+	if(bus.op == OP_NONE && !bus.dr_full){
+		bus_start();
+	}
+	else{
+		bus.start_req = 1; // After the current byte
+		shim_i2c1.CR1 |= I2C_CR1_START;
+	}
+	SHIM_EXIT();
+}
+
+void LL_I2C_GenerateStopCondition(I2C_TypeDef* I2Cx){
+	(void)I2Cx;
+	SHIM_ENTER();
+	if(bus.op == OP_NONE && !bus.dr_full){
+		bus_stop();
+	}
+	else{
+		bus.stop_req = 1; // After the current byte
+		shim_i2c1.CR1 |= I2C_CR1_STOP;
+	}
+	SHIM_EXIT();
+}
+
+void LL_I2C_TransmitData8(I2C_TypeDef* I2Cx, uint8_t data){
+	(void)I2Cx;
+	SHIM_ENTER();
+	if(bus.sb){
+		bus.sb = 0;
+		bus.shift = data;
+		bus_begin(OP_ADDRESS, 9);
+	}
+	else if(bus.op == OP_NONE && bus.device && !bus.reading && !bus.addr){
+		bus.shift = data;
+		bus.txe = 1;
+		bus.btf = 0;
+		bus_begin(OP_TX, 9);
+	}
+	else{
+		bus.dr = data;
+		bus.dr_full = 1;
+		bus.txe = 0;
+	}
+	SHIM_EXIT();
+}
+
+uint8_t LL_I2C_ReceiveData8(I2C_TypeDef* I2Cx){
+	(void)I2Cx;
+	SHIM_ENTER();
+	uint8_t data = bus.dr;
+	bus.rxne = 0;
+	if(bus.rx_more){
+		bus.rx_more = 0;
+		bus_begin(OP_RX, 9);
+	}
+	SHIM_EXIT();
+	return data;
+}
+
+void LL_I2C_AcknowledgeNextData(I2C_TypeDef* I2Cx, uint32_t type){
+	(void)I2Cx;
+	SHIM_ENTER();
+	shim_i2c1.CR1 = (shim_i2c1.CR1 & ~I2C_CR1_ACK) | type;
+	SHIM_EXIT();
+}
+
+uint32_t LL_I2C_IsActiveFlag_SB(I2C_TypeDef* I2Cx){ (void)I2Cx; return shim_flag(&bus.sb); }
+uint32_t LL_I2C_IsActiveFlag_ADDR(I2C_TypeDef* I2Cx){ (void)I2Cx; return shim_flag(&bus.addr); }
+uint32_t LL_I2C_IsActiveFlag_TXE(I2C_TypeDef* I2Cx){ (void)I2Cx; return shim_flag(&bus.txe); }
+uint32_t LL_I2C_IsActiveFlag_BTF(I2C_TypeDef* I2Cx){ (void)I2Cx; return shim_flag(&bus.btf); }
+uint32_t LL_I2C_IsActiveFlag_RXNE(I2C_TypeDef* I2Cx){ (void)I2Cx; return shim_flag(&bus.rxne); }
+uint32_t LL_I2C_IsActiveFlag_AF(I2C_TypeDef* I2Cx){ (void)I2Cx; return shim_flag(&bus.af); }
+uint32_t LL_I2C_IsActiveFlag_BERR(I2C_TypeDef* I2Cx){ (void)I2Cx; return shim_flag(&bus.berr); }
+uint32_t LL_I2C_IsActiveFlag_ARLO(I2C_TypeDef* I2Cx){ (void)I2Cx; return shim_flag(&bus.arlo); }
+uint32_t LL_I2C_IsActiveFlag_OVR(I2C_TypeDef* I2Cx){ (void)I2Cx; return shim_flag(&bus.ovr); }
+
+void LL_I2C_ClearFlag_ADDR(I2C_TypeDef* I2Cx){
+	(void)I2Cx;
+	SHIM_ENTER();
+	if(bus.addr){
+		bus.addr = 0;
+		if(bus.reading){
+			bus_begin(OP_RX, 9);
+		}
+		else if(bus.dr_full){
+			bus.shift = bus.dr;
+			bus.dr_full = 0;
+			bus.txe = 1;
+			bus_begin(OP_TX, 9);
+		}
+		else{
+			bus.txe = 1;
+		}
+	}
+	SHIM_EXIT();
+}
+
+void LL_I2C_ClearFlag_AF(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.af = 0; SHIM_EXIT(); }
+void LL_I2C_ClearFlag_BERR(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.berr = 0; SHIM_EXIT(); }
+void LL_I2C_ClearFlag_ARLO(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.arlo = 0; SHIM_EXIT(); }
+void LL_I2C_ClearFlag_OVR(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.ovr = 0; SHIM_EXIT(); }
+
+void LL_I2C_EnableIT_EVT(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.it_evt = 1; SHIM_EXIT(); }
+void LL_I2C_DisableIT_EVT(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.it_evt = 0; SHIM_EXIT(); }
+void LL_I2C_EnableIT_BUF(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.it_buf = 1; SHIM_EXIT(); }
+void LL_I2C_DisableIT_BUF(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.it_buf = 0; SHIM_EXIT(); }
+void LL_I2C_EnableIT_ERR(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.it_err = 1; SHIM_EXIT(); }
+void LL_I2C_DisableIT_ERR(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.it_err = 0; SHIM_EXIT(); }
+void LL_I2C_EnableDMAReq_RX(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.dma_rx = 1; SHIM_EXIT(); }
+void LL_I2C_DisableDMAReq_RX(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.dma_rx = 0; SHIM_EXIT(); }
+void LL_I2C_EnableLastDMA(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.last = 1; SHIM_EXIT(); }
+void LL_I2C_DisableLastDMA(I2C_TypeDef* I2Cx){ (void)I2Cx; SHIM_ENTER(); bus.last = 0; SHIM_EXIT(); }
+
+/*---------------------------------------- TIM5 ----------------------------------------*/
+
+void LL_TIM_SetPrescaler(TIM_TypeDef* TIMx, uint32_t prescaler){
+	SHIM_ENTER();
+	TIMx->PSC = prescaler;
+	tim.tick_ns = (uint64_t)(prescaler + 1) * 1000000000u / SystemCoreClock;
+	SHIM_EXIT();
+}
+
+void LL_TIM_SetOnePulseMode(TIM_TypeDef* TIMx, uint32_t mode){ (void)TIMx; (void)mode; } // Always one pulse
+void LL_TIM_SetUpdateSource(TIM_TypeDef* TIMx, uint32_t source){ (void)TIMx; (void)source; } // Always the counter
+void LL_TIM_GenerateEvent_UPDATE(TIM_TypeDef* TIMx){ (void)TIMx; } // Only reloads the prescaler
+void LL_TIM_ClearFlag_UPDATE(TIM_TypeDef* TIMx){ (void)TIMx; SHIM_ENTER(); tim.uif = 0; SHIM_EXIT(); }
+uint32_t LL_TIM_IsActiveFlag_UPDATE(TIM_TypeDef* TIMx){ (void)TIMx; return shim_flag(&tim.uif); }
+void LL_TIM_EnableIT_UPDATE(TIM_TypeDef* TIMx){ (void)TIMx; SHIM_ENTER(); tim.uie = 1; SHIM_EXIT(); }
+
+void LL_TIM_SetAutoReload(TIM_TypeDef* TIMx, uint32_t value){
+	SHIM_ENTER();
+	TIMx->ARR = value;
+	SHIM_EXIT();
+}
+
+void LL_TIM_SetCounter(TIM_TypeDef* TIMx, uint32_t value){
+	SHIM_ENTER();
+	TIMx->CNT = value;
+	SHIM_EXIT();
+}
+
+void LL_TIM_EnableCounter(TIM_TypeDef* TIMx){
+	// Counts from CNT up to ARR, then the update event
+	SHIM_ENTER();
+	tim.running = 1;
+	tim.end = now_ns + (uint64_t)(TIMx->ARR - TIMx->CNT + 1) * tim.tick_ns;
+	SHIM_EXIT();
+}
+
+/*---------------------------------------- DMA1 Stream 0 ----------------------------------------*/
+
+void LL_DMA_EnableStream(DMA_TypeDef* DMAx, uint32_t stream){
+	(void)DMAx; (void)stream;
+	SHIM_ENTER();
+	dma.enabled = dma.ndtr != 0;
+	dma.index = 0;
+	SHIM_EXIT();
+}
+
+void LL_DMA_DisableStream(DMA_TypeDef* DMAx, uint32_t stream){ (void)DMAx; (void)stream; SHIM_ENTER(); dma.enabled = 0; SHIM_EXIT(); }
+void LL_DMA_SetChannelSelection(DMA_TypeDef* DMAx, uint32_t stream, uint32_t channel){ (void)DMAx; (void)stream; (void)channel; }
+void LL_DMA_ConfigTransfer(DMA_TypeDef* DMAx, uint32_t stream, uint32_t configuration){ (void)DMAx; (void)stream; (void)configuration; }
+void LL_DMA_DisableFifoMode(DMA_TypeDef* DMAx, uint32_t stream){ (void)DMAx; (void)stream; }
+void LL_DMA_SetPeriphAddress(DMA_TypeDef* DMAx, uint32_t stream, uint32_t address){ (void)DMAx; (void)stream; (void)address; }
+void LL_DMA_SetMemoryAddress(DMA_TypeDef* DMAx, uint32_t stream, uint32_t address){ (void)DMAx; (void)stream; SHIM_ENTER(); dma.memory = address; SHIM_EXIT(); }
+void LL_DMA_SetDataLength(DMA_TypeDef* DMAx, uint32_t stream, uint32_t length){ (void)DMAx; (void)stream; SHIM_ENTER(); dma.ndtr = length; SHIM_EXIT(); }
+void LL_DMA_EnableIT_TC(DMA_TypeDef* DMAx, uint32_t stream){ (void)DMAx; (void)stream; SHIM_ENTER(); dma.tcie = 1; SHIM_EXIT(); }
+void LL_DMA_EnableIT_TE(DMA_TypeDef* DMAx, uint32_t stream){ (void)DMAx; (void)stream; SHIM_ENTER(); dma.teie = 1; SHIM_EXIT(); }
+uint32_t LL_DMA_IsActiveFlag_TC0(DMA_TypeDef* DMAx){ (void)DMAx; return shim_flag(&dma.tc); }
+uint32_t LL_DMA_IsActiveFlag_TE0(DMA_TypeDef* DMAx){ (void)DMAx; return shim_flag(&dma.te); }
+void LL_DMA_ClearFlag_TC0(DMA_TypeDef* DMAx){ (void)DMAx; SHIM_ENTER(); dma.tc = 0; SHIM_EXIT(); }
+void LL_DMA_ClearFlag_HT0(DMA_TypeDef* DMAx){ (void)DMAx; }
+void LL_DMA_ClearFlag_TE0(DMA_TypeDef* DMAx){ (void)DMAx; SHIM_ENTER(); dma.te = 0; SHIM_EXIT(); }
+void LL_DMA_ClearFlag_FE0(DMA_TypeDef* DMAx){ (void)DMAx; }
+void LL_DMA_ClearFlag_DME0(DMA_TypeDef* DMAx){ (void)DMAx; }
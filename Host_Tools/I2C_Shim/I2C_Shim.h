@@ -0,0 +1,35 @@
+#ifndef __I2C_SHIM_H
+#define __I2C_SHIM_H
+
+#include <stdint.h>
+
+// A device on the emulated I2C bus. The shim calls it as the master drives the bus, times are in simulated ns
+struct I2C_Device {
+	uint8_t address; // 8-bit address with the R/W bit clear (e.g. 0xA0)
+	void* context;
+	int     (*start)(void* context, uint8_t control, uint64_t now); // Control byte after a (RE)START, 1 to acknowledge
+	int     (*write)(void* context, uint8_t data, uint64_t now); // Byte from the master, 1 to acknowledge
+	uint8_t (*read)(void* context, int ack, uint64_t now); // Byte to the master, 'ack' is how the master answers it
+	void    (*stop)(void* context, uint64_t now);
+};
+
+// Bus activity seen by the shim
+struct I2C_Shim_Stats {
+	uint32_t starts; // START and repeated START conditions
+	uint32_t nacks; // Control bytes that were not acknowledged
+	uint32_t bytes; // Bytes moved after the control byte, either direction
+	uint32_t interrupts; // Interrupt handlers run
+	uint32_t clocks; // SCL pulses made by hand (GPIO)
+	uint32_t resets; // I2C1 software resets
+};
+
+// 			 I2C Shim Functions
+void     i2c_shim_init(uint32_t bus_hz);
+void     i2c_shim_attach(struct I2C_Device* device);
+uint64_t i2c_shim_now(void);
+const struct I2C_Shim_Stats* i2c_shim_stats(void);
+void     i2c_shim_stall(uint32_t count, uint32_t clocks);
+void     i2c_shim_stall_data(uint32_t byte, uint32_t clocks);
+void     i2c_shim_glitch(uint32_t count);
+
+#endif /* __I2C_SHIM_H */
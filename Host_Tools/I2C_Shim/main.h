@@ -0,0 +1,208 @@
+#ifndef __MAIN_H
+#define __MAIN_H
+
+/*
+Host stand-in for the firmware's main.h. It declares the part of CMSIS and the LL drivers used by the I2C drivers
+(I2C1, TIM5, DMA1 Stream 0, the NVIC, the DWT cycle counter, the I2C1 pins on GPIOB and the clock tree), implemented in I2C_Shim.c
+on top of an emulated bus. Register values are only kept where the drivers read them directly.
+*/
+
+#include <stdint.h>
+
+#include "I2C_Shim.h"
+
+typedef enum {
+	DMA1_Stream0_IRQn = 11,
+	I2C1_EV_IRQn      = 31,
+	I2C1_ER_IRQn      = 32,
+	TIM5_IRQn         = 50
+} IRQn_Type;
+
+typedef struct {
+	volatile uint32_t CR1;
+	volatile uint32_t CR2;
+	volatile uint32_t OAR1;
+	volatile uint32_t OAR2;
+	volatile uint32_t DR;
+	volatile uint32_t SR1;
+	volatile uint32_t SR2;
+	volatile uint32_t CCR;
+	volatile uint32_t TRISE;
+	volatile uint32_t FLTR;
+} I2C_TypeDef;
+
+typedef struct {
+	volatile uint32_t CR1;
+	volatile uint32_t CNT;
+	volatile uint32_t PSC;
+	volatile uint32_t ARR;
+} TIM_TypeDef;
+
+typedef struct {
+	volatile uint32_t LISR;
+	volatile uint32_t HISR;
+} DMA_TypeDef;
+
+typedef struct {
+	volatile uint32_t MODER;
+	volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+	uint32_t SYSCLK_Frequency;
+	uint32_t HCLK_Frequency;
+	uint32_t PCLK1_Frequency;
+	uint32_t PCLK2_Frequency;
+} LL_RCC_ClocksTypeDef;
+
+extern I2C_TypeDef shim_i2c1;
+extern TIM_TypeDef shim_tim5;
+extern DMA_TypeDef shim_dma1;
+extern GPIO_TypeDef shim_gpiob;
+extern CoreDebug_Type shim_coredebug;
+extern uint32_t SystemCoreClock;
+
+#define I2C1 (&shim_i2c1)
+#define TIM5 (&shim_tim5)
+#define DMA1 (&shim_dma1)
+#define GPIOB (&shim_gpiob)
+#define DWT (shim_dwt()) // Each access costs the CPU a little time, so waits on CYCCNT end
+#define CoreDebug (&shim_coredebug)
+
+#define DWT_CTRL_CYCCNTENA_Msk     (1u << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+
+#define READ_BIT(REG, BIT) ((REG) & (BIT))
+#define I2C_CR1_START (1u << 8)
+#define I2C_CR1_STOP  (1u << 9)
+#define I2C_CR1_ACK   (1u << 10)
+#define I2C_CR2_FREQ  0x3Fu
+#define I2C_CCR_CCR_Pos 0u
+#define I2C_CCR_CCR   0xFFFu
+#define I2C_CCR_DUTY  (1u << 14)
+#define I2C_CCR_FS    (1u << 15)
+
+#define LL_I2C_DUTYCYCLE_2 0u
+
+#define LL_I2C_ACK  I2C_CR1_ACK
+#define LL_I2C_NACK 0u
+
+#define LL_APB1_GRP1_PERIPH_TIM5 (1u << 3)
+#define LL_AHB1_GRP1_PERIPH_DMA1 (1u << 21)
+
+#define LL_TIM_ONEPULSEMODE_SINGLE   (1u << 3)
+#define LL_TIM_UPDATESOURCE_COUNTER  (1u << 2)
+
+#define LL_DMA_STREAM_0               0u
+#define LL_DMA_CHANNEL_1              (1u << 25)
+#define LL_DMA_DIRECTION_PERIPH_TO_MEMORY 0u
+#define LL_DMA_PRIORITY_HIGH          (2u << 16)
+#define LL_DMA_MODE_NORMAL            0u
+#define LL_DMA_PERIPH_NOINCREMENT     0u
+#define LL_DMA_MEMORY_INCREMENT       (1u << 10)
+#define LL_DMA_PDATAALIGN_BYTE        0u
+#define LL_DMA_MDATAALIGN_BYTE        0u
+
+#define LL_GPIO_PIN_8           (1u << 8)
+#define LL_GPIO_PIN_9           (1u << 9)
+#define LL_GPIO_MODE_OUTPUT     1u
+#define LL_GPIO_MODE_ALTERNATE  2u
+
+// 			 NVIC
+void     __disable_irq(void);
+void     __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void     __set_PRIMASK(uint32_t mask);
+void     NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+void     NVIC_EnableIRQ(IRQn_Type irq);
+void     NVIC_DisableIRQ(IRQn_Type irq);
+DWT_Type* shim_dwt(void);
+
+// 			 RCC
+void     LL_APB1_GRP1_EnableClock(uint32_t periphs);
+void     LL_AHB1_GRP1_EnableClock(uint32_t periphs);
+void     LL_RCC_GetSystemClocksFreq(LL_RCC_ClocksTypeDef* clocks);
+
+// 			 GPIO (the I2C1 pins, PB8 SCL and PB9 SDA)
+void     LL_GPIO_SetPinMode(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t mode);
+void     LL_GPIO_SetOutputPin(GPIO_TypeDef* GPIOx, uint32_t pins);
+void     LL_GPIO_ResetOutputPin(GPIO_TypeDef* GPIOx, uint32_t pins);
+uint32_t LL_GPIO_IsInputPinSet(GPIO_TypeDef* GPIOx, uint32_t pins);
+
+// 			 I2C
+void     LL_I2C_Enable(I2C_TypeDef* I2Cx);
+void     LL_I2C_Disable(I2C_TypeDef* I2Cx);
+void     LL_I2C_EnableReset(I2C_TypeDef* I2Cx);
+void     LL_I2C_DisableReset(I2C_TypeDef* I2Cx);
+void     LL_I2C_ConfigSpeed(I2C_TypeDef* I2Cx, uint32_t clock, uint32_t speed, uint32_t duty);
+void     LL_I2C_GenerateStartCondition(I2C_TypeDef* I2Cx);
+void     LL_I2C_GenerateStopCondition(I2C_TypeDef* I2Cx);
+void     LL_I2C_TransmitData8(I2C_TypeDef* I2Cx, uint8_t data);
+uint8_t  LL_I2C_ReceiveData8(I2C_TypeDef* I2Cx);
+void     LL_I2C_AcknowledgeNextData(I2C_TypeDef* I2Cx, uint32_t type);
+uint32_t LL_I2C_IsActiveFlag_SB(I2C_TypeDef* I2Cx);
+uint32_t LL_I2C_IsActiveFlag_ADDR(I2C_TypeDef* I2Cx);
+uint32_t LL_I2C_IsActiveFlag_TXE(I2C_TypeDef* I2Cx);
+uint32_t LL_I2C_IsActiveFlag_BTF(I2C_TypeDef* I2Cx);
+uint32_t LL_I2C_IsActiveFlag_RXNE(I2C_TypeDef* I2Cx);
+uint32_t LL_I2C_IsActiveFlag_AF(I2C_TypeDef* I2Cx);
+uint32_t LL_I2C_IsActiveFlag_BERR(I2C_TypeDef* I2Cx);
+uint32_t LL_I2C_IsActiveFlag_ARLO(I2C_TypeDef* I2Cx);
+uint32_t LL_I2C_IsActiveFlag_OVR(I2C_TypeDef* I2Cx);
+void     LL_I2C_ClearFlag_ADDR(I2C_TypeDef* I2Cx);
+void     LL_I2C_ClearFlag_AF(I2C_TypeDef* I2Cx);
+void     LL_I2C_ClearFlag_BERR(I2C_TypeDef* I2Cx);
+void     LL_I2C_ClearFlag_ARLO(I2C_TypeDef* I2Cx);
+void     LL_I2C_ClearFlag_OVR(I2C_TypeDef* I2Cx);
+void     LL_I2C_EnableIT_EVT(I2C_TypeDef* I2Cx);
+void     LL_I2C_DisableIT_EVT(I2C_TypeDef* I2Cx);
+void     LL_I2C_EnableIT_BUF(I2C_TypeDef* I2Cx);
+void     LL_I2C_DisableIT_BUF(I2C_TypeDef* I2Cx);
+void     LL_I2C_EnableIT_ERR(I2C_TypeDef* I2Cx);
+void     LL_I2C_DisableIT_ERR(I2C_TypeDef* I2Cx);
+void     LL_I2C_EnableDMAReq_RX(I2C_TypeDef* I2Cx);
+void     LL_I2C_DisableDMAReq_RX(I2C_TypeDef* I2Cx);
+void     LL_I2C_EnableLastDMA(I2C_TypeDef* I2Cx);
+void     LL_I2C_DisableLastDMA(I2C_TypeDef* I2Cx);
+
+// 			 TIM
+void     LL_TIM_SetPrescaler(TIM_TypeDef* TIMx, uint32_t prescaler);
+void     LL_TIM_SetOnePulseMode(TIM_TypeDef* TIMx, uint32_t mode);
+void     LL_TIM_SetUpdateSource(TIM_TypeDef* TIMx, uint32_t source);
+void     LL_TIM_GenerateEvent_UPDATE(TIM_TypeDef* TIMx);
+void     LL_TIM_ClearFlag_UPDATE(TIM_TypeDef* TIMx);
+uint32_t LL_TIM_IsActiveFlag_UPDATE(TIM_TypeDef* TIMx);
+void     LL_TIM_EnableIT_UPDATE(TIM_TypeDef* TIMx);
+void     LL_TIM_SetAutoReload(TIM_TypeDef* TIMx, uint32_t value);
+void     LL_TIM_SetCounter(TIM_TypeDef* TIMx, uint32_t value);
+void     LL_TIM_EnableCounter(TIM_TypeDef* TIMx);
+
+// 			 DMA (stream 0 only)
+void     LL_DMA_EnableStream(DMA_TypeDef* DMAx, uint32_t stream);
+void     LL_DMA_DisableStream(DMA_TypeDef* DMAx, uint32_t stream);
+void     LL_DMA_SetChannelSelection(DMA_TypeDef* DMAx, uint32_t stream, uint32_t channel);
+void     LL_DMA_ConfigTransfer(DMA_TypeDef* DMAx, uint32_t stream, uint32_t configuration);
+void     LL_DMA_DisableFifoMode(DMA_TypeDef* DMAx, uint32_t stream);
+void     LL_DMA_SetPeriphAddress(DMA_TypeDef* DMAx, uint32_t stream, uint32_t address);
+void     LL_DMA_SetMemoryAddress(DMA_TypeDef* DMAx, uint32_t stream, uint32_t address);
+void     LL_DMA_SetDataLength(DMA_TypeDef* DMAx, uint32_t stream, uint32_t length);
+void     LL_DMA_EnableIT_TC(DMA_TypeDef* DMAx, uint32_t stream);
+void     LL_DMA_EnableIT_TE(DMA_TypeDef* DMAx, uint32_t stream);
+uint32_t LL_DMA_IsActiveFlag_TC0(DMA_TypeDef* DMAx);
+uint32_t LL_DMA_IsActiveFlag_TE0(DMA_TypeDef* DMAx);
+void     LL_DMA_ClearFlag_TC0(DMA_TypeDef* DMAx);
+void     LL_DMA_ClearFlag_HT0(DMA_TypeDef* DMAx);
+void     LL_DMA_ClearFlag_TE0(DMA_TypeDef* DMAx);
+void     LL_DMA_ClearFlag_FE0(DMA_TypeDef* DMAx);
+void     LL_DMA_ClearFlag_DME0(DMA_TypeDef* DMAx);
+
+#endif /* __MAIN_H */
@@ -0,0 +1,82 @@
+/*
+Journal_Dump
+Mounts the packet journal from an EEPROM image (a raw dump of the whole EEPROM) with the same Journal.c as the
+board, and prints the newest records oldest first with their FCS check, and the samples of batch records.
+
+Build and run (from Host_Tools):
+    gcc -O2 -I../Starter_Project/Inc -o Journal_Dump Journal_Dump.c STM32_CRC.c ../Starter_Project/Journal.c ../Starter_Project/Batch.c ../Starter_Project/Packet.c
+    ./Journal_Dump eeprom.bin [count] [fcs mode: 0 legacy, 1 packed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Journal.h"
+#include "Batch.h"
+#include "STM32_CRC.h"
+
+#define EEPROM_SIZE 8192
+
+static unsigned char image[EEPROM_SIZE]; // The emulated EEPROM
+
+static int image_write(uint16_t address, const unsigned char* data, uint16_t length){
+	memcpy(image + address, data, length);
+	return 0;
+}
+
+static int image_read(uint16_t address, unsigned char* data, uint16_t length){
+	memcpy(data, image + address, length);
+	return 0;
+}
+
+static const struct EEPROM_Ops image_ops = { image_write, image_read, 0 };
+
+int main(int argc, char** argv){
+	if(argc < 2){
+		printf("usage: %s eeprom.bin [count] [fcs mode]\n", argv[0]);
+		return 1;
+	}
+	uint16_t count = (argc > 2) ? (uint16_t)atoi(argv[2]) : 16;
+	uint32_t mode = (argc > 3) ? (uint32_t)atoi(argv[3]) : FCS_MODE_PACKED;
+	
+	FILE* f = fopen(argv[1], "rb");
+	if(!f){
+		printf("Cannot open %s\n", argv[1]);
+		return 1;
+	}
+	memset(image, 0xFF, sizeof(image));
+	size_t size = fread(image, 1, sizeof(image), f);
+	fclose(f);
+	
+	struct Journal j;
+	journal_mount(&j, &image_ops, (uint16_t)(size / PACKET_SIZE), stm32_crc_fcs, mode);
+	printf("%u slots, %u records, head slot %u, next sequence %u\n", j.slots, j.count, j.head, j.next_seq);
+	
+	struct Pack* pkts = malloc(sizeof(struct Pack) * (count ? count : 1));
+	uint16_t n = journal_read_last(&j, pkts, count);
+	for(uint16_t i=0; i<n; i++){
+		unsigned char bytes[PACKET_SIZE];
+		packet_serialise(&pkts[i], bytes);
+		int version = stm32_crc_check_record(bytes);
+		uint16_t sample = pkts[i].payload.sample & PACKET_SAMPLE_MASK;
+		int16_t degrees8 = (sample & 0x400) ? (int16_t)(sample - 0x800) : (int16_t)sample;
+		printf("seq %5u  sample %4u (%7.3f C)%s  FCS %08X %s\n", journal_sequence(&pkts[i]), sample,
+		       degrees8 * 0.125f, (pkts[i].payload.sample & PACKET_ALARM_FLAG) ? "  ALARM" : "", pkts[i].FCS,
+		       (version < 0) ? "ERROR" : (version == FCS_MODE_LEGACY ? "v0 OK" : "OK"));
+		uint32_t samples = batch_count(&pkts[i]);
+		if(samples){
+			printf("    batch of %u from %u us over %u ms", samples, batch_time(&pkts[i]), batch_span_ms(&pkts[i]));
+			if(batch_sensor(&pkts[i])){
+				printf(" from sensor %02X", batch_sensor(&pkts[i]));
+			}
+			printf(":");
+			for(uint32_t k=0; k<samples; k++){
+				printf(" %u", batch_sample(&pkts[i], k));
+			}
+			printf("\n");
+		}
+	}
+	free(pkts);
+	return 0;
+}
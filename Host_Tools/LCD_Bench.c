@@ -0,0 +1,246 @@
+/*
+LCD_Bench
+Runs the board's LCD_Display.c on Linux against a model of the display controller (LCD_Shim.c: SPI1, the A0, reset
+and chip select pins and the controller's display RAM) and checks the flushing of changed columns. After every
+flush the controller's RAM must match the driver's buffer, and what was sent must be exactly the runs of changed
+bytes of each page, a new run (and column address) starting where FLUSH_GAP or more unchanged bytes lie between
+two changes; a flush with nothing changed sends nothing. This is checked for pixels (in and out of range),
+characters and strings in both fonts, flushed as they are drawn and deferred over many, then the SPI bytes of the
+screens the program draws are reported against sending the whole buffer.
+
+Build and run (from Host_Tools):
+    gcc -O2 -Wall -ILCD_Shim -I../Starter_Project/Inc -o LCD_Bench LCD_Bench.c LCD_Shim.c ../Starter_Project/LCD_Display.c
+    ./LCD_Bench [flushes] [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "LCD_Display.h"
+#include "Arial_9.h"
+#include "Arial_12.h"
+
+#define LCD_PAGES 4
+#define LCD_WIDTH 128
+#define FLUSH_GAP 3 // LCD_FLUSH_GAP of LCD_Display.c
+
+extern unsigned char buffer[512]; // The driver's copy of the display
+void LCD_Display_Config(void); // Not in LCD_Display.h
+
+static unsigned char shown[LCD_PAGES][LCD_WIDTH]; // What the LCD showed before the flush being checked
+static struct LCD_Shim_Run expected[LCD_SHIM_RUNS];
+
+static uint32_t expected_runs(void){
+	// The runs a flush should send: the changed bytes of each page, in runs that end on a change and take in the
+	// next change while fewer than FLUSH_GAP unchanged bytes lie between them
+	uint32_t n = 0;
+	for(int page=0; page<LCD_PAGES; page++){
+		int last = -1; // Last change of the open run
+		for(int column=0; column<LCD_WIDTH; column++){
+			if(buffer[page * LCD_WIDTH + column] == shown[page][column]){
+				continue;
+			}
+			if(last >= 0 && column - last - 1 < FLUSH_GAP){
+				expected[n - 1].length = (uint16_t)(column - expected[n - 1].column + 1);
+			}
+			else if(n < LCD_SHIM_RUNS){
+				expected[n].page = (uint8_t)page;
+				expected[n].column = (uint8_t)column;
+				expected[n].length = 1;
+				n++;
+			}
+			last = column;
+		}
+	}
+	return n;
+}
+
+static int check_ram(const char* what){
+	// The controller's RAM against the driver's buffer
+	for(int page=0; page<LCD_PAGES; page++){
+		for(int column=0; column<LCD_WIDTH; column++){
+			if(lcd_shim_ram(page, column) != buffer[page * LCD_WIDTH + column]){
+				printf("MISMATCH after %s on page %d column %d: %02X, expected %02X\n", what, page, column,
+				       lcd_shim_ram(page, column), buffer[page * LCD_WIDTH + column]);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static void mark(void){
+	// Starts a check: what the LCD shows now, and a new run log
+	memcpy(shown, buffer, sizeof(shown));
+	lcd_shim_mark();
+}
+
+static int check_flush(const char* what){
+	// One flush since mark: the runs sent against the expected ones, then the RAM
+	const struct LCD_Shim_Run* runs;
+	uint32_t n = expected_runs();
+	uint32_t sent = lcd_shim_runs(&runs);
+	int errors = 0;
+
+	if(sent != n){
+		printf("MISMATCH after %s: %u runs sent, expected %u\n", what, (unsigned)sent, (unsigned)n);
+		errors++;
+	}
+	for(uint32_t i=0; i<n && i<sent && !errors; i++){
+		if(runs[i].page != expected[i].page || runs[i].column != expected[i].column || runs[i].length != expected[i].length){
+			printf("MISMATCH after %s in run %u: page %u column %u length %u, expected page %u column %u length %u\n",
+			       what, (unsigned)i, runs[i].page, runs[i].column, runs[i].length, expected[i].page,
+			       expected[i].column, expected[i].length);
+			errors++;
+		}
+	}
+	errors += check_ram(what);
+	mark();
+	return errors;
+}
+
+static void random_text(char* text, int length){
+	for(int i=0; i<length; i++){
+		text[i] = (char)(32 + rand() % 95);
+	}
+	text[length] = 0;
+}
+
+static void random_draw(int op){
+	// A string, a character or some pixels anywhere, partly off the screen (none of them flushed by themselves
+	// while deferred)
+	char text[12];
+	if(op == 0){
+		random_text(text, 1 + rand() % 10);
+		put_string(rand() % LCD_WIDTH, rand() % (LCD_PAGES * 8), text);
+	}
+	else if(op == 1){
+		locate(rand() % LCD_WIDTH, rand() % (LCD_PAGES * 8));
+		put_char(32 + rand() % 95);
+	}
+	else{
+		for(int i=rand() % 20; i>0; i--){
+			pixel(rand() % (LCD_WIDTH + 8) - 4, rand() % (LCD_PAGES * 8 + 8) - 4, rand() & 1);
+		}
+	}
+}
+
+static int check_gap(void){
+	// Changes FLUSH_GAP - 1 bytes apart go in one run, FLUSH_GAP apart in two
+	int errors = 0;
+	const struct LCD_Shim_Run* runs;
+
+	mark();
+	pixel(10, 0, !(buffer[10] & 1));
+	pixel(10 + FLUSH_GAP, 0, !(buffer[10 + FLUSH_GAP] & 1));
+	pixel(40, 0, !(buffer[40] & 1));
+	pixel(40 + FLUSH_GAP + 1, 0, !(buffer[40 + FLUSH_GAP + 1] & 1));
+	Flush_LCD();
+	uint32_t n = lcd_shim_runs(&runs);
+	if(n != 3 || runs[0].column != 10 || runs[0].length != FLUSH_GAP + 1 || runs[1].column != 40 ||
+	   runs[1].length != 1 || runs[2].column != 40 + FLUSH_GAP + 1 || runs[2].length != 1){
+		printf("Runs not split at %d unchanged bytes\n", FLUSH_GAP);
+		errors++;
+	}
+	errors += check_flush("changes either side of the gap");
+
+	// Drawn again the same, nothing is sent
+	put_string(0, 0, "Temp:");
+	mark();
+	uint32_t bytes = lcd_shim_stats()->bytes;
+	put_string(0, 0, "Temp:");
+	if(lcd_shim_stats()->bytes != bytes){
+		printf("A string drawn over itself sent %u bytes\n", (unsigned)(lcd_shim_stats()->bytes - bytes));
+		errors++;
+	}
+	errors += check_flush("a string drawn over itself");
+	return errors;
+}
+
+static int check_random(int n){
+	// Random drawing, flushed as it is drawn or deferred over several, now and then a cleared screen
+	int errors = 0;
+	for(int i=0; i<n && !errors; i++){
+		set_font((unsigned char*)((rand() % 4) ? Arial_12 : Arial_9));
+		int op = rand() % 5;
+		if(op < 2){
+			random_draw(op); // Flushes once
+		}
+		else if(op == 2){
+			random_draw(2);
+			Flush_LCD();
+		}
+		else if(op == 3){
+			Defer_LCD_Flush(1);
+			for(int k=rand() % 8; k>0; k--){
+				random_draw(rand() % 3);
+			}
+			Defer_LCD_Flush(0); // Flushes what is waiting
+		}
+		else if(rand() % 50 == 0){
+			Clear_Screen(); // Sends everything
+			errors += check_ram("a cleared screen");
+			mark();
+			Flush_LCD();
+		}
+		errors += check_flush("random drawing");
+	}
+	Defer_LCD_Flush(0);
+	return errors;
+}
+
+static void screen(const char* what, const char* top, const char* bottom, int deferred){
+	// SPI bytes of a screen drawn as the main loop draws it, over the one before: both lines blanked and written
+	uint32_t bytes = lcd_shim_stats()->bytes;
+	Defer_LCD_Flush(deferred);
+	put_string(0, 0, "             ");
+	put_string(0, 15, "             ");
+	put_string(0, 0, (char*)top);
+	put_string(0, 15, (char*)bottom);
+	Defer_LCD_Flush(0);
+	printf("%-28s %6u\n", what, (unsigned)(lcd_shim_stats()->bytes - bytes));
+}
+
+int main(int argc, char** argv){
+	int n = (argc > 1) ? atoi(argv[1]) : 20000;
+	srand((argc > 2) ? (unsigned)atoi(argv[2]) : 1);
+
+	lcd_shim_init();
+	set_font((unsigned char*)Arial_12);
+	LCD_Display_Config();
+	int errors = check_ram("configuration");
+	mark();
+	Flush_LCD();
+	errors += check_flush("a flush with nothing new");
+	errors += check_gap();
+	errors += check_random(n);
+	if(lcd_shim_stats()->dropped){
+		printf("%u bytes sent with the LCD not selected\n", (unsigned)lcd_shim_stats()->dropped);
+		errors++;
+	}
+	if(errors){
+		return 1;
+	}
+	printf("Flushes match the display over %d random updates\n\n", n);
+
+	// What the screens cost, against sending the whole buffer
+	set_font((unsigned char*)Arial_12);
+	Clear_Screen();
+	uint32_t bytes = lcd_shim_stats()->bytes;
+	Copy_Data_Buffer_To_LCD();
+	printf("%-28s %6s\n", "screen", "SPI B");
+	printf("%-28s %6u\n", "whole buffer", (unsigned)(lcd_shim_stats()->bytes - bytes));
+	screen("temperature, first time", "Temp:", "21.375", 1);
+	bytes = lcd_shim_stats()->bytes;
+	put_string(0, 0, "             ");
+	printf("%-28s %6u\n", "blank a line", (unsigned)(lcd_shim_stats()->bytes - bytes));
+	screen("temperature, per string", "Temp:", "21.500", 0);
+	screen("temperature, deferred", "Temp:", "21.625", 1);
+	screen("new screen, deferred", "MAC dest:", "aa aa aa", 1);
+	bytes = lcd_shim_stats()->bytes;
+	Flush_LCD();
+	printf("%-28s %6u\n", "nothing new", (unsigned)(lcd_shim_stats()->bytes - bytes));
+	return check_ram("the screens");
+}
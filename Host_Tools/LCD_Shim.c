@@ -0,0 +1,159 @@
+/*
+LCD Shim
+Emulates the parts of the STM32F401 used by the LCD driver (SPI1 as a transmit only master, the A0, reset and chip
+select pins as GPIO) and the display controller at the other end (ST7565R, as on the mbed application board), so
+the board's LCD_Display.c builds and runs unchanged on Linux. The driver includes LCD_Shim/main.h instead of the
+firmware's main.h.
+A byte written to SPI1 reaches the controller if the chip is selected (PB6 low): a command when A0 (PA8) is low,
+display data when it is high. The controller keeps its own display RAM: the column address is set by two commands
+(0x0X low nibble, 0x1X high nibble) and the page by 0xBX, and each data byte goes to the current column, which then
+moves on by one (it stops at the last column). Other commands are counted and otherwise ignored. Each page address
+command starts a run in the log, so a tool can see how a flush split up what it sent. Transfers take no time:
+SPI1 is never busy.
+*/
+
+#include <string.h>
+
+#include "main.h"
+
+#define PIN_A0     LL_GPIO_PIN_8 // PA8
+#define PIN_RESET  LL_GPIO_PIN_6 // PA6
+#define PIN_CS     LL_GPIO_PIN_6 // PB6
+#define SPI_ENABLE (1u << 6) // CR1 SPE
+
+GPIO_TypeDef shim_gpioa;
+GPIO_TypeDef shim_gpiob;
+SPI_TypeDef shim_spi1;
+
+static struct LCD_Shim_Stats stats;
+
+static struct {
+	uint8_t ram[LCD_SHIM_PAGES][LCD_SHIM_COLUMNS];
+	uint32_t page;
+	uint32_t column;
+	struct LCD_Shim_Run runs[LCD_SHIM_RUNS];
+	uint32_t count; // Runs logged since lcd_shim_mark (those past LCD_SHIM_RUNS are counted, not kept)
+} lcd;
+
+static void lcd_command(uint8_t command){
+	// Commands that move the RAM address, a page address starts a run
+	if(command <= 0x0F){
+		lcd.column = (lcd.column & 0xF0) | command;
+	}
+	else if(command <= 0x1F){
+		lcd.column = (lcd.column & 0x0F) | ((command & 0x0F) << 4);
+	}
+	else if((command & 0xF0) == 0xB0){
+		lcd.page = command & 0x0F;
+		stats.addresses++;
+		if(lcd.count < LCD_SHIM_RUNS){
+			lcd.runs[lcd.count].page = (uint8_t)lcd.page;
+			lcd.runs[lcd.count].column = (uint8_t)lcd.column;
+			lcd.runs[lcd.count].length = 0;
+		}
+		lcd.count++;
+	}
+}
+
+static void lcd_data(uint8_t data){
+	// Display data into the current column, which moves on
+	if(lcd.page < LCD_SHIM_PAGES && lcd.column < LCD_SHIM_COLUMNS){
+		lcd.ram[lcd.page][lcd.column] = data;
+	}
+	if(lcd.column < LCD_SHIM_COLUMNS - 1){
+		lcd.column++;
+	}
+	if(lcd.count && lcd.count <= LCD_SHIM_RUNS){
+		lcd.runs[lcd.count - 1].length++;
+	}
+}
+
+void lcd_shim_init(void){
+	// Pins high (chip not selected, out of reset), SPI1 off, display RAM and log cleared
+	memset(&lcd, 0, sizeof(lcd));
+	memset(&stats, 0, sizeof(stats));
+	memset(&shim_spi1, 0, sizeof(shim_spi1));
+	shim_gpioa.ODR = PIN_A0 | PIN_RESET;
+	shim_gpiob.ODR = PIN_CS;
+}
+
+const struct LCD_Shim_Stats* lcd_shim_stats(void){
+	return &stats;
+}
+
+uint8_t lcd_shim_ram(uint32_t page, uint32_t column){
+	// A byte of the controller's display RAM
+	return (page < LCD_SHIM_PAGES && column < LCD_SHIM_COLUMNS) ? lcd.ram[page][column] : 0;
+}
+
+void lcd_shim_mark(void){
+	// Starts a new run log
+	lcd.count = 0;
+}
+
+uint32_t lcd_shim_runs(const struct LCD_Shim_Run** runs){
+	// Runs sent since lcd_shim_mark, oldest first. Returns their number, which may be more than LCD_SHIM_RUNS
+	*runs = lcd.runs;
+	return lcd.count;
+}
+
+// 			 RCC and utilities
+
+void LL_AHB1_GRP1_EnableClock(uint32_t periphs){ (void)periphs; }
+void LL_APB2_GRP1_EnableClock(uint32_t periphs){ (void)periphs; }
+void LL_mDelay(uint32_t delay){ (void)delay; }
+
+// 			 GPIO
+
+void LL_GPIO_SetPinMode(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t mode){ (void)GPIOx; (void)pin; (void)mode; }
+void LL_GPIO_SetPinSpeed(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t speed){ (void)GPIOx; (void)pin; (void)speed; }
+void LL_GPIO_SetPinPull(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t pull){ (void)GPIOx; (void)pin; (void)pull; }
+void LL_GPIO_SetAFPin_0_7(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t alternate){ (void)GPIOx; (void)pin; (void)alternate; }
+
+void LL_GPIO_SetOutputPin(GPIO_TypeDef* GPIOx, uint32_t pins){
+	GPIOx->ODR |= pins;
+}
+
+void LL_GPIO_ResetOutputPin(GPIO_TypeDef* GPIOx, uint32_t pins){
+	if(GPIOx == GPIOA && (pins & PIN_RESET) && (GPIOx->ODR & PIN_RESET)){
+		stats.resets++;
+	}
+	GPIOx->ODR &= ~pins;
+}
+
+// 			 SPI
+
+void LL_SPI_SetBaudRatePrescaler(SPI_TypeDef* SPIx, uint32_t prescaler){ SPIx->CR1 |= prescaler; }
+void LL_SPI_SetTransferDirection(SPI_TypeDef* SPIx, uint32_t direction){ SPIx->CR1 |= direction; }
+void LL_SPI_SetClockPhase(SPI_TypeDef* SPIx, uint32_t phase){ SPIx->CR1 |= phase; }
+void LL_SPI_SetClockPolarity(SPI_TypeDef* SPIx, uint32_t polarity){ SPIx->CR1 |= polarity; }
+void LL_SPI_SetTransferBitOrder(SPI_TypeDef* SPIx, uint32_t order){ SPIx->CR1 |= order; }
+void LL_SPI_SetDataWidth(SPI_TypeDef* SPIx, uint32_t width){ SPIx->CR1 |= width; }
+void LL_SPI_SetNSSMode(SPI_TypeDef* SPIx, uint32_t mode){ SPIx->CR1 |= mode; }
+void LL_SPI_SetMode(SPI_TypeDef* SPIx, uint32_t mode){ SPIx->CR1 |= mode; }
+void LL_SPI_Enable(SPI_TypeDef* SPIx){ SPIx->CR1 |= SPI_ENABLE; }
+void LL_SPI_EnableIT_TXE(SPI_TypeDef* SPIx){ (void)SPIx; }
+void LL_SPI_EnableIT_ERR(SPI_TypeDef* SPIx){ (void)SPIx; }
+
+void LL_SPI_TransmitData8(SPI_TypeDef* SPIx, uint8_t data){
+	// The byte goes straight to the controller, if it is listening
+	SPIx->DR = data;
+	if(!(SPIx->CR1 & SPI_ENABLE) || (shim_gpiob.ODR & PIN_CS)){
+		stats.dropped++;
+		return;
+	}
+	stats.bytes++;
+	if(shim_gpioa.ODR & PIN_A0){
+		stats.data++;
+		lcd_data(data);
+	}
+	else{
+		stats.commands++;
+		lcd_command(data);
+	}
+}
+
+uint32_t LL_SPI_IsActiveFlag_BSY(SPI_TypeDef* SPIx){
+	(void)SPIx;
+	return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef __LCD_SHIM_H
+#define __LCD_SHIM_H
+
+#include <stdint.h>
+
+// Display RAM of the controller (ST7565R), the LCD shows columns 0-127 of pages 0-3
+#define LCD_SHIM_PAGES   8
+#define LCD_SHIM_COLUMNS 132
+#define LCD_SHIM_RUNS    256 // Runs logged between lcd_shim_mark calls
+
+// Data bytes sent after one page address command, into consecutive columns
+struct LCD_Shim_Run {
+	uint8_t page;
+	uint8_t column; // First column
+	uint16_t length; // Data bytes
+};
+
+// SPI traffic seen by the controller
+struct LCD_Shim_Stats {
+	uint32_t bytes; // Bytes sent on SPI1 with the chip selected
+	uint32_t commands; // Of which commands (A0 low)
+	uint32_t data; // Of which display data (A0 high)
+	uint32_t addresses; // Page address commands (each starts a run)
+	uint32_t dropped; // Bytes sent with the chip not selected or SPI1 off
+	uint32_t resets; // Pulses on the reset pin
+};
+
+// 			 LCD Shim Functions
+void     lcd_shim_init(void);
+const struct LCD_Shim_Stats* lcd_shim_stats(void);
+uint8_t  lcd_shim_ram(uint32_t page, uint32_t column);
+void     lcd_shim_mark(void);
+uint32_t lcd_shim_runs(const struct LCD_Shim_Run** runs);
+
+#endif /* __LCD_SHIM_H */
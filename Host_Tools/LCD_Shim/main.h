@@ -0,0 +1,86 @@
+#ifndef __MAIN_H
+#define __MAIN_H
+
+/*
+Host stand-in for the firmware's main.h. It declares the part of the LL drivers used by the LCD driver (SPI1, the
+LCD pins on GPIOA and GPIOB, the clock enables and LL_mDelay), implemented in LCD_Shim.c on top of a model of the
+display controller. Register values are only kept where the shim needs them.
+*/
+
+#include <stdint.h>
+
+#include "LCD_Shim.h"
+
+typedef struct {
+	volatile uint32_t MODER;
+	volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct {
+	volatile uint32_t CR1;
+	volatile uint32_t CR2;
+	volatile uint32_t SR;
+	volatile uint32_t DR;
+} SPI_TypeDef;
+
+extern GPIO_TypeDef shim_gpioa;
+extern GPIO_TypeDef shim_gpiob;
+extern SPI_TypeDef shim_spi1;
+
+#define GPIOA (&shim_gpioa)
+#define GPIOB (&shim_gpiob)
+#define SPI1  (&shim_spi1)
+
+#define LL_AHB1_GRP1_PERIPH_GPIOA (1u << 0)
+#define LL_AHB1_GRP1_PERIPH_GPIOB (1u << 1)
+#define LL_APB2_GRP1_PERIPH_SPI1  (1u << 12)
+
+#define LL_GPIO_PIN_5           (1u << 5)
+#define LL_GPIO_PIN_6           (1u << 6)
+#define LL_GPIO_PIN_7           (1u << 7)
+#define LL_GPIO_PIN_8           (1u << 8)
+#define LL_GPIO_MODE_OUTPUT     1u
+#define LL_GPIO_MODE_ALTERNATE  2u
+#define LL_GPIO_SPEED_FREQ_HIGH 2u
+#define LL_GPIO_PULL_UP         1u
+#define LL_GPIO_PULL_DOWN       2u
+#define LL_GPIO_AF_5            5u
+
+#define LL_SPI_BAUDRATEPRESCALER_DIV8 (2u << 3)
+#define LL_SPI_HALF_DUPLEX_TX         ((1u << 15) | (1u << 14))
+#define LL_SPI_PHASE_2EDGE            (1u << 0)
+#define LL_SPI_POLARITY_HIGH          (1u << 1)
+#define LL_SPI_MSB_FIRST              0u
+#define LL_SPI_DATAWIDTH_8BIT         0u
+#define LL_SPI_NSS_SOFT               (1u << 9)
+#define LL_SPI_MODE_MASTER            ((1u << 2) | (1u << 8))
+
+// 			 RCC and utilities
+void     LL_AHB1_GRP1_EnableClock(uint32_t periphs);
+void     LL_APB2_GRP1_EnableClock(uint32_t periphs);
+void     LL_mDelay(uint32_t delay);
+
+// 			 GPIO (A0 on PA8, reset on PA6, chip select on PB6, SCK and MOSI on PA5 and PA7)
+void     LL_GPIO_SetPinMode(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t mode);
+void     LL_GPIO_SetPinSpeed(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t speed);
+void     LL_GPIO_SetPinPull(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t pull);
+void     LL_GPIO_SetAFPin_0_7(GPIO_TypeDef* GPIOx, uint32_t pin, uint32_t alternate);
+void     LL_GPIO_SetOutputPin(GPIO_TypeDef* GPIOx, uint32_t pins);
+void     LL_GPIO_ResetOutputPin(GPIO_TypeDef* GPIOx, uint32_t pins);
+
+// 			 SPI
+void     LL_SPI_SetBaudRatePrescaler(SPI_TypeDef* SPIx, uint32_t prescaler);
+void     LL_SPI_SetTransferDirection(SPI_TypeDef* SPIx, uint32_t direction);
+void     LL_SPI_SetClockPhase(SPI_TypeDef* SPIx, uint32_t phase);
+void     LL_SPI_SetClockPolarity(SPI_TypeDef* SPIx, uint32_t polarity);
+void     LL_SPI_SetTransferBitOrder(SPI_TypeDef* SPIx, uint32_t order);
+void     LL_SPI_SetDataWidth(SPI_TypeDef* SPIx, uint32_t width);
+void     LL_SPI_SetNSSMode(SPI_TypeDef* SPIx, uint32_t mode);
+void     LL_SPI_SetMode(SPI_TypeDef* SPIx, uint32_t mode);
+void     LL_SPI_Enable(SPI_TypeDef* SPIx);
+void     LL_SPI_EnableIT_TXE(SPI_TypeDef* SPIx);
+void     LL_SPI_EnableIT_ERR(SPI_TypeDef* SPIx);
+void     LL_SPI_TransmitData8(SPI_TypeDef* SPIx, uint8_t data);
+uint32_t LL_SPI_IsActiveFlag_BSY(SPI_TypeDef* SPIx);
+
+#endif /* __MAIN_H */
@@ -0,0 +1,72 @@
+/*
+LM75 Model
+Behaviour of an LM75 temperature sensor on the emulated I2C bus (I2C_Shim.c):
+- The first byte written after the control byte loads the pointer register, the bytes after it go into the
+  register it points to (MSB first, one byte for the configuration). The temperature register cannot be written.
+- Reads return the register at the pointer, MSB then LSB, over and over for as long as the master acknowledges
+  (the configuration register is one byte, repeated). The pointer is kept between transactions, so a read without
+  a pointer write reads the register last pointed to.
+The pointer starts on the temperature register, and Tos and Thyst at their power-on 80 and 75 degrees.
+*/
+
+#include <string.h>
+
+#include "LM75_Model.h"
+
+static int model_start(void* context, uint8_t control, uint64_t now){
+	struct LM75_Model* m = context;
+	(void)control;
+	(void)now;
+
+	m->phase = 0;
+	m->byte = 0;
+	return 1;
+}
+
+static int model_write(void* context, uint8_t data, uint64_t now){
+	struct LM75_Model* m = context;
+	(void)now;
+
+	if(m->phase == 0){
+		m->pointer = data & 3;
+	}
+	else if(m->pointer == LM75_MODEL_CONFIG){
+		m->reg[LM75_MODEL_CONFIG] = (uint16_t)(data << 8);
+		m->writes++;
+	}
+	else if(m->pointer != LM75_MODEL_TEMPERATURE && m->phase <= 2){
+		uint16_t r = m->reg[m->pointer];
+		m->reg[m->pointer] = (m->phase == 1) ? (uint16_t)((data << 8) | (r & 0xFF)) : (uint16_t)((r & 0xFF00) | data);
+		m->writes++;
+	}
+	m->phase++;
+	return 1;
+}
+
+static uint8_t model_read(void* context, int ack, uint64_t now){
+	struct LM75_Model* m = context;
+	(void)ack;
+	(void)now;
+
+	uint16_t r = m->reg[m->pointer];
+	uint8_t data = m->byte ? (uint8_t)r : (uint8_t)(r >> 8);
+	if(m->pointer != LM75_MODEL_CONFIG){
+		m->byte ^= 1;
+	}
+	m->reads++;
+	return data;
+}
+
+void lm75_model_init(struct LM75_Model* m, uint8_t address, int16_t temperature){
+	// 'temperature' in 0.125 degree steps (the 11-bit reading)
+	memset(m, 0, sizeof(*m));
+	m->reg[LM75_MODEL_TEMPERATURE] = (uint16_t)(temperature << 5);
+	m->reg[LM75_MODEL_THYST] = 75 << 8;
+	m->reg[LM75_MODEL_TOS] = 80 << 8;
+	m->device.address = address;
+	m->device.context = m;
+	m->device.start = model_start;
+	m->device.write = model_write;
+	m->device.read = model_read;
+	m->device.stop = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef __LM75_MODEL_H
+#define __LM75_MODEL_H
+
+#include <stdint.h>
+
+#include "I2C_Shim.h"
+
+// LM75 registers (pointer values)
+#define LM75_MODEL_TEMPERATURE 0
+#define LM75_MODEL_CONFIG      1
+#define LM75_MODEL_THYST       2
+#define LM75_MODEL_TOS         3
+
+// LM75 on the emulated bus
+struct LM75_Model {
+	struct I2C_Device device; // Attach with i2c_shim_attach(&model.device)
+	uint16_t reg[4]; // Temperature, configuration (upper byte), Thyst and Tos, as read MSB first
+	uint8_t pointer; // Pointer register
+	int phase; // Bytes written since the control byte (the first one is the pointer)
+	int byte; // Next byte of the register to read (0 MSB, 1 LSB)
+	uint32_t reads; // Bytes read
+	uint32_t writes; // Register bytes written
+};
+
+// 			 LM75 Model Functions
+void     lm75_model_init(struct LM75_Model* m, uint8_t address, int16_t temperature);
+
+#endif /* __LM75_MODEL_H */
@@ -0,0 +1,201 @@
+#include "STM32_CRC.h"
+#include "STM32_CRC_Tables.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STM32_CRC_HAVE_X86 1
+#endif
+
+/*
+STM32 CRC
+Three implementations of the same byte stream CRC, picked at run time by stm32_crc_bytes:
+ - scalar: one lookup in table 0 per byte
+ - slicing-by-8: eight lookups in eight tables per 8 bytes, no dependency between the lookups
+ - carry-less multiply: 64 bytes are folded per step with PCLMULQDQ and the last 16 bytes of the folded
+   value are reduced with the tables
+The tables are generated by CRC_Tables_Gen.c.
+*/
+
+static uint32_t crc_scalar(uint32_t crc, const unsigned char* p, size_t len){
+	while(len--){
+		crc = (crc << 8) ^ stm32_crc_table[0][(crc >> 24) ^ *p++];
+	}
+	return crc;
+}
+
+static uint32_t crc_slice8(uint32_t crc, const unsigned char* p, size_t len){
+	while(len >= 8){
+		crc ^= ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+		crc = stm32_crc_table[7][crc >> 24] ^
+		      stm32_crc_table[6][(crc >> 16) & 0xFF] ^
+		      stm32_crc_table[5][(crc >> 8) & 0xFF] ^
+		      stm32_crc_table[4][crc & 0xFF] ^
+		      stm32_crc_table[3][p[4]] ^
+		      stm32_crc_table[2][p[5]] ^
+		      stm32_crc_table[1][p[6]] ^
+		      stm32_crc_table[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+	return crc_scalar(crc, p, len);
+}
+
+#if defined(STM32_CRC_HAVE_X86)
+
+// x^n mod P for the folding distances (hi: A_hi is moved by n+64 bits, lo: A_lo by n bits)
+#define K_FOLD128_HI 0xC5B9CD4Cu // x^192 mod P
+#define K_FOLD128_LO 0xE8A45605u // x^128 mod P
+#define K_FOLD512_HI 0x8833794Cu // x^576 mod P
+#define K_FOLD512_LO 0xE6228B11u // x^512 mod P
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i fold(__m128i a, __m128i k){
+	// a * x^n mod P, kept as a 128-bit value that is only congruent to the result
+	return _mm_xor_si128(_mm_clmulepi64_si128(a, k, 0x11), _mm_clmulepi64_si128(a, k, 0x00));
+}
+
+__attribute__((target("pclmul,ssse3")))
+static uint32_t crc_clmul(uint32_t crc, const unsigned char* p, size_t len){
+	if(len < 64){
+		return crc_slice8(crc, p, len);
+	}
+	
+	// Reverse the bytes so the first message bit is bit 127, as for a polynomial
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i k512 = _mm_set_epi64x(K_FOLD512_HI, K_FOLD512_LO);
+	const __m128i k128 = _mm_set_epi64x(K_FOLD128_HI, K_FOLD128_LO);
+	
+	__m128i a0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p)), bswap);
+	__m128i a1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), bswap);
+	__m128i a2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 32)), bswap);
+	__m128i a3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 48)), bswap);
+	// Running CRC state is the same as XORing it into the first 32 message bits
+	a0 = _mm_xor_si128(a0, _mm_set_epi32((int)crc, 0, 0, 0));
+	p += 64;
+	len -= 64;
+	
+	while(len >= 64){
+		a0 = _mm_xor_si128(fold(a0, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p)), bswap));
+		a1 = _mm_xor_si128(fold(a1, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), bswap));
+		a2 = _mm_xor_si128(fold(a2, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 32)), bswap));
+		a3 = _mm_xor_si128(fold(a3, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 48)), bswap));
+		p += 64;
+		len -= 64;
+	}
+	
+	a0 = _mm_xor_si128(fold(a0, k128), a1);
+	a0 = _mm_xor_si128(fold(a0, k128), a2);
+	a0 = _mm_xor_si128(fold(a0, k128), a3);
+	while(len >= 16){
+		a0 = _mm_xor_si128(fold(a0, k128), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), bswap));
+		p += 16;
+		len -= 16;
+	}
+	
+	// The CRC of the folded value (starting from 0) is the CRC of everything so far
+	unsigned char folded[16];
+	_mm_storeu_si128((__m128i*)folded, _mm_shuffle_epi8(a0, bswap));
+	crc = crc_slice8(0, folded, 16);
+	return crc_slice8(crc, p, len);
+}
+
+#endif /* STM32_CRC_HAVE_X86 */
+
+int stm32_crc_tier_supported(stm32_crc_tier tier){
+	// Returns 1 if the implementation can run on this machine
+	switch(tier){
+		case STM32_CRC_SCALAR:
+		case STM32_CRC_SLICE8:
+			return 1;
+		case STM32_CRC_CLMUL:
+#if defined(STM32_CRC_HAVE_X86)
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+#else
+			return 0;
+#endif
+	}
+	return 0;
+}
+
+const char* stm32_crc_tier_name(stm32_crc_tier tier){
+	switch(tier){
+		case STM32_CRC_SCALAR: return "scalar";
+		case STM32_CRC_SLICE8: return "slicing-by-8";
+		case STM32_CRC_CLMUL:  return "pclmulqdq";
+	}
+	return "?";
+}
+
+stm32_crc_tier stm32_crc_best_tier(void){
+	// Fastest implementation supported by this machine (checked once)
+	static int best = -1;
+	if(best < 0){
+		best = stm32_crc_tier_supported(STM32_CRC_CLMUL) ? STM32_CRC_CLMUL : STM32_CRC_SLICE8;
+	}
+	return (stm32_crc_tier)best;
+}
+
+uint32_t stm32_crc_bytes_tier(stm32_crc_tier tier, uint32_t crc, const unsigned char* data, size_t len){
+	// Continues 'crc' over 'len' bytes with the given implementation
+	switch(tier){
+		case STM32_CRC_SCALAR:
+			return crc_scalar(crc, data, len);
+		case STM32_CRC_CLMUL:
+#if defined(STM32_CRC_HAVE_X86)
+			if(stm32_crc_tier_supported(STM32_CRC_CLMUL)){
+				return crc_clmul(crc, data, len);
+			}
+#endif
+			/* fall through */
+		case STM32_CRC_SLICE8:
+		default:
+			return crc_slice8(crc, data, len);
+	}
+}
+
+uint32_t stm32_crc_bytes(uint32_t crc, const unsigned char* data, size_t len){
+	// Continues 'crc' over 'len' bytes with the fastest implementation
+	return stm32_crc_bytes_tier(stm32_crc_best_tier(), crc, data, len);
+}
+
+uint32_t stm32_crc_words(uint32_t crc, const uint32_t* words, size_t count){
+	// Same as writing each word to CRC->DR
+	unsigned char bytes[256];
+	
+	while(count){
+		size_t n = (count > sizeof(bytes) / 4) ? sizeof(bytes) / 4 : count;
+		for(size_t i=0; i<n; i++){
+			bytes[4*i]   = (unsigned char)(words[i] >> 24);
+			bytes[4*i+1] = (unsigned char)(words[i] >> 16);
+			bytes[4*i+2] = (unsigned char)(words[i] >> 8);
+			bytes[4*i+3] = (unsigned char)(words[i]);
+		}
+		crc = stm32_crc_bytes(crc, bytes, 4*n);
+		words += n;
+		count -= n;
+	}
+	return crc;
+}
+
+uint32_t stm32_crc_fcs(struct Pack pkt, uint32_t mode){
+	// FCS of the packet in the given format, the same value as calculate_CRC_mode on the board
+	uint32_t words[FCS_WORDS_MAX];
+	uint32_t n = packet_fcs_words(&pkt, mode, words);
+	return stm32_crc_words(STM32_CRC_INIT, words, n);
+}
+
+int stm32_crc_check_record(const unsigned char* bytes){
+	// Checks the FCS of a PACKET_SIZE byte packet as stored in EEPROM.
+	// Returns the matching FCS mode or -1
+	struct Pack pkt;
+	packet_parse(bytes, &pkt);
+	
+	if(stm32_crc_bytes(STM32_CRC_INIT, bytes, PACKET_FCS_OFFSET) == pkt.FCS){
+		return FCS_MODE_PACKED;
+	}
+	if(stm32_crc_fcs(pkt, FCS_MODE_LEGACY) == pkt.FCS){
+		return FCS_MODE_LEGACY;
+	}
+	return -1;
+}
@@ -0,0 +1,36 @@
+#ifndef __STM32_CRC_H
+#define __STM32_CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Packet.h"
+
+/*
+STM32 CRC
+Host implementation of the STM32F4 CRC unit (CRC-32, polynomial 0x04C11DB7, initial value 0xFFFFFFFF, words
+shifted in from bit 31, no final XOR), bit-exact with calculate_CRC on the board in both FCS formats.
+Writing a word to CRC->DR is the same as feeding its four bytes most significant first, so everything is
+built on a byte stream CRC.
+*/
+
+#define STM32_CRC_INIT 0xFFFFFFFFu
+
+// Implementations of the byte stream CRC
+typedef enum {
+	STM32_CRC_SCALAR, // One table lookup per byte
+	STM32_CRC_SLICE8, // Eight bytes per step, eight tables
+	STM32_CRC_CLMUL   // PCLMULQDQ folding, 64 bytes per step (x86 with PCLMULQDQ only)
+} stm32_crc_tier;
+
+// 			 STM32 CRC Functions
+int      stm32_crc_tier_supported(stm32_crc_tier tier);
+const char* stm32_crc_tier_name(stm32_crc_tier tier);
+stm32_crc_tier stm32_crc_best_tier(void);
+uint32_t stm32_crc_bytes_tier(stm32_crc_tier tier, uint32_t crc, const unsigned char* data, size_t len);
+uint32_t stm32_crc_bytes(uint32_t crc, const unsigned char* data, size_t len);
+uint32_t stm32_crc_words(uint32_t crc, const uint32_t* words, size_t count);
+uint32_t stm32_crc_fcs(struct Pack pkt, uint32_t mode);
+int      stm32_crc_check_record(const unsigned char* bytes);
+
+#endif /* __STM32_CRC_H */
@@ -0,0 +1,155 @@
+#include "main.h"
+#include "Time_Delays.h"
+#include "I2C_Bus.h"
+#include "Sampler.h"
+#include "Alarm.h"
+
+/*
+Alarm
+Over-temperature alarm from the LM75 itself. alarm_configure writes the Tos and Thyst registers of every sensor
+found by sampler_scan and puts the OS output in comparator mode: active low, on after two conversions in a row
+above Tos and off again after two below Thyst, so a noisy reading does not toggle it. The OS outputs are open
+drain, so the sensors share one line, and the alarm is on while any sensor is above its threshold. The line is
+wired to ALARM_PIN (D2, PA10, pulled up), whose EXTI interrupt fires on both edges and queues the time and the new
+state in a ring for the main loop, like the samples in Sampler.c. Nothing polls the sensor for the alarm: the bus
+carries the threshold writes once, and alarm_active reads the pin.
+The threshold writes go through the I2C1 transfer queue. Each sensor's writes are chained and end by setting
+its pointer back to the temperature register, so nothing else runs while the pointer is elsewhere and the
+sampler's fast reads (which leave the pointer write out) are not disturbed.
+*/
+
+// OS line (LM75 pin 3) input
+#define ALARM_PORT        GPIOA
+#define ALARM_PIN         LL_GPIO_PIN_10
+#define ALARM_EXTI_LINE   LL_EXTI_LINE_10
+#define ALARM_SYSCFG_PORT LL_SYSCFG_EXTI_PORTA
+#define ALARM_SYSCFG_LINE LL_SYSCFG_EXTI_LINE10
+
+// LM75 registers
+#define LM75_TEMPERATURE 0x00
+#define LM75_CONFIG 0x01
+#define LM75_THYST  0x02
+#define LM75_TOS    0x03
+
+// Configuration: comparator mode (bit 1 clear), OS active low (bit 2 clear), fault queue of 2 (bits 4-3: 01)
+#define LM75_CONFIG_ALARM 0x08
+
+static struct Alarm_Event al_ring[ALARM_RING_SIZE];
+static volatile uint32_t al_head; // Events written (only changed by the interrupt)
+static volatile uint32_t al_tail; // Events read (only changed by the main loop)
+
+static struct Alarm_Stats al_stats;
+
+static struct I2C_Transfer al_transfer[4]; // Writes to one sensor: configuration, Thyst, Tos, pointer back
+
+static uint16_t lm75_threshold(int16_t t){
+	// Q7.3 temperature to the 9-bit threshold register (0.5 degree steps in bits 15-7), rounded down
+	return (uint16_t)((uint16_t)(t >> 2) << 7);
+}
+
+uint32_t alarm_configure(int16_t tos, int16_t thyst){
+	// Sets the thresholds (0.125 degree steps, as the samples) of every sensor and enables the EXTI interrupt of
+	// the OS line. Call after sampler_scan. Returns the number of sensors that took the settings
+	uint32_t done = 0;
+	
+	// OS line: input with pull up (the outputs are open drain), interrupt on both edges
+	LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_GPIOA);
+	LL_GPIO_SetPinMode(ALARM_PORT, ALARM_PIN, LL_GPIO_MODE_INPUT);
+	LL_GPIO_SetPinPull(ALARM_PORT, ALARM_PIN, LL_GPIO_PULL_UP);
+	LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_SYSCFG);
+	LL_SYSCFG_SetEXTISource(ALARM_SYSCFG_PORT, ALARM_SYSCFG_LINE);
+	
+	for(uint32_t i=0; i<sampler_sensors(); i++){
+		uint16_t hyst = lm75_threshold(thyst);
+		uint16_t os = lm75_threshold(tos);
+		for(uint32_t k=0; k<4; k++){
+			al_transfer[k].address = (uint8_t)sampler_sensor_address(i);
+			al_transfer[k].flags = (k < 3) ? I2C_CHAIN : 0;
+			al_transfer[k].priority = I2C_PRIORITY_NORMAL;
+			al_transfer[k].tx_length = 0;
+			al_transfer[k].rx_length = 0;
+			al_transfer[k].done = 0;
+		}
+		al_transfer[0].cmd[0] = LM75_CONFIG;
+		al_transfer[0].cmd[1] = LM75_CONFIG_ALARM;
+		al_transfer[0].cmd_length = 2;
+		al_transfer[1].cmd[0] = LM75_THYST;
+		al_transfer[1].cmd[1] = (uint8_t)(hyst >> 8); //MOST SIGNIFICANT BYTE
+		al_transfer[1].cmd[2] = (uint8_t)hyst; //LEAST SIGNIFICANT BYTE
+		al_transfer[1].cmd_length = 3;
+		al_transfer[2].cmd[0] = LM75_TOS;
+		al_transfer[2].cmd[1] = (uint8_t)(os >> 8);
+		al_transfer[2].cmd[2] = (uint8_t)os;
+		al_transfer[2].cmd_length = 3;
+		al_transfer[3].cmd[0] = LM75_TEMPERATURE;
+		al_transfer[3].cmd_length = 1;
+		i2c_submit(al_transfer, 4);
+		i2c_wait(&al_transfer[3]);
+		
+		uint32_t ok = 1;
+		for(uint32_t k=0; k<4; k++){
+			ok = ok && al_transfer[k].status == I2C_OK;
+		}
+		if(ok){
+			done++;
+		}
+		else{
+			al_stats.errors++;
+			sampler_pointer_moved(); // The pointer may not have been set back
+		}
+	}
+	
+	LL_EXTI_ClearFlag_0_31(ALARM_EXTI_LINE);
+	LL_EXTI_EnableRisingTrig_0_31(ALARM_EXTI_LINE);
+	LL_EXTI_EnableFallingTrig_0_31(ALARM_EXTI_LINE);
+	LL_EXTI_EnableIT_0_31(ALARM_EXTI_LINE);
+	// Nothing on the bus or in the sampler is touched, but keep it with the other interrupts
+	NVIC_SetPriority(EXTI15_10_IRQn, 1);
+	NVIC_EnableIRQ(EXTI15_10_IRQn);
+	return done;
+}
+
+uint32_t alarm_active(void){
+	// Returns 1 while any sensor is above its threshold (the OS line is low)
+	return !LL_GPIO_IsInputPinSet(ALARM_PORT, ALARM_PIN);
+}
+
+uint32_t alarm_read(struct Alarm_Event* e){
+	// Takes the oldest crossing from the ring, returns 0 if there is none (main loop only)
+	uint32_t tail = al_tail;
+	if(tail == al_head){
+		return 0;
+	}
+	*e = al_ring[tail & (ALARM_RING_SIZE - 1)];
+	__DMB(); // The event is copied before its slot is handed back
+	al_tail = tail + 1;
+	return 1;
+}
+
+const struct Alarm_Stats* alarm_stats(void){
+	return &al_stats;
+}
+
+void EXTI15_10_IRQHandler(void){
+	if(!LL_EXTI_IsActiveFlag_0_31(ALARM_EXTI_LINE)){
+		return;
+	}
+	LL_EXTI_ClearFlag_0_31(ALARM_EXTI_LINE);
+	
+	uint32_t active = alarm_active();
+	if(active){
+		al_stats.raised++;
+	}
+	else{
+		al_stats.cleared++;
+	}
+	uint32_t head = al_head;
+	if(head - al_tail == ALARM_RING_SIZE){
+		al_stats.overruns++;
+		return;
+	}
+	al_ring[head & (ALARM_RING_SIZE - 1)].time_us = micros();
+	al_ring[head & (ALARM_RING_SIZE - 1)].active = (uint8_t)active;
+	__DMB(); // The event is in the ring before the main loop can see it
+	al_head = head + 1;
+}
@@ -0,0 +1,276 @@
+#include "Batch.h"
+
+/*
+Batch
+Packs consecutive samples into the pl field of a packet, so one packet (one FCS and one EEPROM write) carries many
+samples instead of one. pl starts with a header byte (format), micros() at the first sample and the time from the
+first to the last sample in ms, followed by the samples. payload.sample holds the newest sample as well, so a batch
+packet still reads as a single sample packet (the caller may set PACKET_ALARM_FLAG in it after each batch_add).
+Two formats:
+ - raw: the header holds the count, then BATCH_MAX_SAMPLES 11-bit samples at most.
+ - delta: a count byte, the first sample (11 bits, the reset point, so every packet decodes on its own), then the
+   change from the previous sample of each following sample, zigzag mapped (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...)
+   and packed in the same number of bits each. The width is in the header. When a delta needs a wider field, the
+   deltas already in the packet are widened in place, so the encoder needs no RAM beyond the packet. A reading
+   that only moves by a few steps takes 2-4 bits instead of 11.
+A batch can be tagged with the I2C address of the sensor its samples came from (several sensors on the bus each
+fill their own batches): the header flag BATCH_SENSOR_FLAG is set and the address is in the last byte before the
+journal sequence number, which the data then stops short of (24 samples in the raw format). Untagged batches keep
+the whole space, so older records read as before.
+A packet whose header has no format bits set (pl all zeros, as in single sample packets) holds no batch.
+Nothing in here touches the hardware, so the same file can be built for host tools.
+*/
+
+static void put_bits(unsigned char* data, uint32_t bit, uint32_t value, uint32_t bits){
+	// Writes 'bits' bits of 'value' at bit offset 'bit', most significant bit first
+	for(uint32_t i=0; i<bits; i++, bit++){
+		unsigned char mask = (unsigned char)(0x80 >> (bit % 8));
+		if(value & (1u << (bits - 1 - i))){
+			data[bit / 8] |= mask;
+		}
+		else{
+			data[bit / 8] &= (unsigned char)~mask;
+		}
+	}
+}
+
+static uint32_t get_bits(const unsigned char* data, uint32_t bit, uint32_t bits){
+	// Reads 'bits' bits at bit offset 'bit', most significant bit first
+	uint32_t value = 0;
+	for(uint32_t i=0; i<bits; i++, bit++){
+		value = (value << 1) | ((data[bit / 8] >> (7 - bit % 8)) & 1);
+	}
+	return value;
+}
+
+static int32_t signed_sample(uint32_t sample){
+	// Samples are two's complement (negative temperatures have bit 10 set)
+	return (sample & 0x400) ? (int32_t)sample - 0x800 : (int32_t)sample;
+}
+
+static uint32_t zigzag(int32_t delta){
+	return (delta >= 0) ? (uint32_t)delta << 1 : ((uint32_t)-delta << 1) - 1;
+}
+
+static int32_t unzigzag(uint32_t value){
+	return (value & 1) ? -(int32_t)((value + 1) >> 1) : (int32_t)(value >> 1);
+}
+
+static uint32_t width_of(uint32_t value){
+	// Bits needed for 'value'
+	uint32_t bits = 0;
+	while(value){
+		bits++;
+		value >>= 1;
+	}
+	return bits;
+}
+
+static uint32_t data_end(const struct Pack* pkt){
+	// Offset in pl where the samples have to stop
+	return (pkt->payload.pl[BATCH_HEADER_OFFSET] & BATCH_SENSOR_FLAG) ? BATCH_SENSOR_OFFSET : JOURNAL_SEQ_OFFSET;
+}
+
+static uint32_t raw_max(const struct Pack* pkt){
+	// Raw samples that fit
+	return (data_end(pkt) - BATCH_DATA_OFFSET) * 8 / BATCH_SAMPLE_BITS;
+}
+
+static uint32_t delta_bits(const struct Pack* pkt){
+	// Bits for the first sample and the deltas
+	return (data_end(pkt) - BATCH_DELTA_DATA_OFFSET) * 8;
+}
+
+static uint32_t delta_position(uint32_t index, uint32_t width){
+	// Bit offset of the delta of sample 'index' (1 and up)
+	return BATCH_SAMPLE_BITS + (index - 1) * width;
+}
+
+void batch_clear(struct Pack* pkt, uint32_t format){
+	// Empties the batch and sets the format of the next one (pl up to the journal sequence number is zeroed)
+	for(int i=0; i<JOURNAL_SEQ_OFFSET; i++){
+		pkt->payload.pl[i] = 0;
+	}
+	pkt->payload.pl[BATCH_HEADER_OFFSET] = (unsigned char)(format & BATCH_FORMAT_MASK);
+}
+
+void batch_set_sensor(struct Pack* pkt, uint32_t address){
+	// Tags an empty batch with the I2C address of the sensor its samples come from (after batch_clear)
+	pkt->payload.pl[BATCH_HEADER_OFFSET] |= BATCH_SENSOR_FLAG;
+	pkt->payload.pl[BATCH_SENSOR_OFFSET] = (unsigned char)address;
+}
+
+uint32_t batch_sensor(const struct Pack* pkt){
+	// I2C address of the sensor the batch came from, 0 if the batch is not tagged
+	if(batch_format(pkt) == 0 || !(pkt->payload.pl[BATCH_HEADER_OFFSET] & BATCH_SENSOR_FLAG)){
+		return 0;
+	}
+	return pkt->payload.pl[BATCH_SENSOR_OFFSET];
+}
+
+static void set_time(struct Pack* pkt, uint32_t count, uint32_t time_us){
+	// Records the time of the first sample, or the span up to the newest
+	unsigned char* pl = pkt->payload.pl;
+	
+	if(count == 0){
+		pl[BATCH_TIME_OFFSET]   = (unsigned char)(time_us >> 24);
+		pl[BATCH_TIME_OFFSET+1] = (unsigned char)(time_us >> 16);
+		pl[BATCH_TIME_OFFSET+2] = (unsigned char)(time_us >> 8);
+		pl[BATCH_TIME_OFFSET+3] = (unsigned char)(time_us);
+	}
+	uint32_t span = (time_us - batch_time(pkt)) / 1000;
+	if(span > 0xFFFF){
+		span = 0xFFFF;
+	}
+	pl[BATCH_SPAN_OFFSET]   = (unsigned char)(span >> 8);
+	pl[BATCH_SPAN_OFFSET+1] = (unsigned char)(span);
+}
+
+static uint32_t delta_add(struct Pack* pkt, uint16_t sample, uint32_t count){
+	// Adds a sample to a delta batch holding 'count' samples, returns 0 if it does not fit
+	unsigned char* pl = pkt->payload.pl;
+	unsigned char* data = pl + BATCH_DELTA_DATA_OFFSET;
+	uint32_t width = pl[BATCH_HEADER_OFFSET] & BATCH_WIDTH_MASK;
+	uint32_t tag = pl[BATCH_HEADER_OFFSET] & BATCH_SENSOR_FLAG;
+	
+	if(count == 0){
+		put_bits(data, 0, sample, BATCH_SAMPLE_BITS); // Reset point
+		return 1;
+	}
+	if(count >= BATCH_DELTA_MAX_SAMPLES){
+		return 0;
+	}
+	
+	uint32_t value = zigzag(signed_sample(sample) - signed_sample(pkt->payload.sample & PACKET_SAMPLE_MASK));
+	uint32_t needed = width_of(value);
+	uint32_t new_width = (needed > width) ? needed : width;
+	if(delta_position(count + 1, new_width) > delta_bits(pkt)){
+		return 0; // Full
+	}
+	
+	if(new_width > width){
+		// Widen the deltas already in the packet, last first so none is overwritten before it is moved
+		for(uint32_t i=count-1; i>=1; i--){
+			put_bits(data, delta_position(i, new_width), get_bits(data, delta_position(i, width), width), new_width);
+		}
+		width = new_width;
+		pl[BATCH_HEADER_OFFSET] = (unsigned char)(BATCH_FORMAT_DELTA | tag | width);
+	}
+	put_bits(data, delta_position(count, width), value, width);
+	return count + 1;
+}
+
+uint32_t batch_add(struct Pack* pkt, uint16_t sample, uint32_t time_us){
+	// Adds a sample taken at 'time_us' (micros()), returns the number of samples in the batch, or 0 if the sample
+	// does not fit (append the batch and start a new one with it). A packet with no format set starts a raw batch
+	unsigned char* pl = pkt->payload.pl;
+	uint32_t count = batch_count(pkt);
+	uint32_t added;
+	
+	sample &= (1u << BATCH_SAMPLE_BITS) - 1;
+	if((pl[BATCH_HEADER_OFFSET] & BATCH_FORMAT_MASK) == 0){
+		batch_clear(pkt, BATCH_FORMAT_RAW);
+	}
+	
+	if(batch_format(pkt) == BATCH_FORMAT_DELTA){
+		added = delta_add(pkt, sample, count);
+		if(added == 0){
+			return 0;
+		}
+		pl[BATCH_DELTA_COUNT_OFFSET] = (unsigned char)added;
+	}
+	else{
+		if(count >= raw_max(pkt)){
+			return 0;
+		}
+		put_bits(pl + BATCH_DATA_OFFSET, count * BATCH_SAMPLE_BITS, sample, BATCH_SAMPLE_BITS);
+		added = count + 1;
+		uint32_t tag = pl[BATCH_HEADER_OFFSET] & BATCH_SENSOR_FLAG;
+		pl[BATCH_HEADER_OFFSET] = (unsigned char)(BATCH_FORMAT_RAW | tag | added);
+	}
+	
+	set_time(pkt, count, time_us);
+	pkt->payload.sample = sample;
+	return added;
+}
+
+uint32_t batch_full(const struct Pack* pkt){
+	// Returns 1 if not even a sample equal to the newest one would fit
+	uint32_t count = batch_count(pkt);
+	
+	if(batch_format(pkt) == BATCH_FORMAT_DELTA){
+		uint32_t width = pkt->payload.pl[BATCH_HEADER_OFFSET] & BATCH_WIDTH_MASK;
+		return count >= BATCH_DELTA_MAX_SAMPLES || (count > 0 && delta_position(count + 1, width) > delta_bits(pkt));
+	}
+	return count >= raw_max(pkt);
+}
+
+uint32_t batch_format(const struct Pack* pkt){
+	// BATCH_FORMAT_RAW, BATCH_FORMAT_DELTA, or 0 if the packet holds no batch
+	uint32_t format = pkt->payload.pl[BATCH_HEADER_OFFSET] & BATCH_FORMAT_MASK;
+	return (format == BATCH_FORMAT_RAW || format == BATCH_FORMAT_DELTA) ? format : 0;
+}
+
+uint32_t batch_count(const struct Pack* pkt){
+	// Number of samples in the batch (0 if the packet holds no batch)
+	switch(batch_format(pkt)){
+		case BATCH_FORMAT_RAW:
+			return pkt->payload.pl[BATCH_HEADER_OFFSET] & BATCH_COUNT_MASK;
+		case BATCH_FORMAT_DELTA:
+			return pkt->payload.pl[BATCH_DELTA_COUNT_OFFSET];
+	}
+	return 0;
+}
+
+uint16_t batch_sample(const struct Pack* pkt, uint32_t index){
+	// Sample 'index' of the batch, oldest first (a delta batch is decoded up to it)
+	const unsigned char* pl = pkt->payload.pl;
+	
+	if(batch_format(pkt) == BATCH_FORMAT_DELTA){
+		const unsigned char* data = pl + BATCH_DELTA_DATA_OFFSET;
+		uint32_t width = pl[BATCH_HEADER_OFFSET] & BATCH_WIDTH_MASK;
+		int32_t sample = signed_sample(get_bits(data, 0, BATCH_SAMPLE_BITS));
+		for(uint32_t i=1; i<=index; i++){
+			sample += unzigzag(get_bits(data, delta_position(i, width), width));
+		}
+		return (uint16_t)(sample & 0x7FF);
+	}
+	return (uint16_t)get_bits(pl + BATCH_DATA_OFFSET, index * BATCH_SAMPLE_BITS, BATCH_SAMPLE_BITS);
+}
+
+uint32_t batch_decode(const struct Pack* pkt, uint16_t* samples){
+	// Writes every sample of the batch to 'samples' (up to BATCH_DELTA_MAX_SAMPLES), returns how many
+	const unsigned char* pl = pkt->payload.pl;
+	uint32_t count = batch_count(pkt);
+	
+	if(batch_format(pkt) == BATCH_FORMAT_DELTA){
+		const unsigned char* data = pl + BATCH_DELTA_DATA_OFFSET;
+		uint32_t width = pl[BATCH_HEADER_OFFSET] & BATCH_WIDTH_MASK;
+		int32_t sample = signed_sample(get_bits(data, 0, BATCH_SAMPLE_BITS));
+		for(uint32_t i=0; i<count; i++){
+			if(i > 0){
+				sample += unzigzag(get_bits(data, delta_position(i, width), width));
+			}
+			samples[i] = (uint16_t)(sample & 0x7FF);
+		}
+	}
+	else{
+		for(uint32_t i=0; i<count; i++){
+			samples[i] = (uint16_t)get_bits(pl + BATCH_DATA_OFFSET, i * BATCH_SAMPLE_BITS, BATCH_SAMPLE_BITS);
+		}
+	}
+	return count;
+}
+
+uint32_t batch_time(const struct Pack* pkt){
+	// micros() when the first sample was added
+	const unsigned char* pl = pkt->payload.pl;
+	return ((uint32_t)pl[BATCH_TIME_OFFSET] << 24) | ((uint32_t)pl[BATCH_TIME_OFFSET+1] << 16) |
+	       ((uint32_t)pl[BATCH_TIME_OFFSET+2] << 8) | pl[BATCH_TIME_OFFSET+3];
+}
+
+uint16_t batch_span_ms(const struct Pack* pkt){
+	// Time from the first to the last sample in ms
+	const unsigned char* pl = pkt->payload.pl;
+	return (uint16_t)((pl[BATCH_SPAN_OFFSET] << 8) | pl[BATCH_SPAN_OFFSET+1]);
+}
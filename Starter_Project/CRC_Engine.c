@@ -0,0 +1,128 @@
+#include "main.h"
+#include "CRC_Engine.h"
+
+/*
+CRC Engine
+Streams a buffer of 32-bit words into the CRC data register using DMA2 Stream 0 in memory-to-memory
+mode (only DMA2 can do memory-to-memory on the STM32F4). The CPU only sets the transfer up, the words
+are fed by the DMA while the CPU carries on. Completion is signalled through a flag (crc_engine_busy)
+and an optional callback which is called from the DMA interrupt with the CRC value.
+A DMA transfer error leaves the CRC unit with part of the words only: crc_engine_wait, crc_engine_result and the
+callback then return CRC_ENGINE_ERROR instead of 0, and the CRC they give is not valid. crc_engine_feed writes
+the words from the CPU instead, for a caller that must have a CRC.
+The CRC unit takes 4 AHB cycles per word and stalls the bus while it computes, so no delays are needed
+between words.
+*/
+
+static volatile uint32_t crc_busy; // 1 while a transfer is running
+static volatile uint32_t crc_value; // CRC of the last completed transfer
+static volatile int crc_error; // 0, or CRC_ENGINE_ERROR if the last transfer failed
+static crc_callback_t crc_done; // Called from the interrupt when the transfer is complete
+
+void crc_engine_configure(void){
+	// Enable the clocks to the CRC unit and DMA2
+	LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_CRC);
+	LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA2);
+
+	LL_DMA_DisableStream(DMA2, LL_DMA_STREAM_0);
+	while(LL_DMA_IsEnabledStream(DMA2, LL_DMA_STREAM_0));
+
+	// Memory-to-memory: the 'peripheral' port is the source buffer (incremented),
+	// the 'memory' port is the CRC data register (fixed)
+	LL_DMA_SetChannelSelection(DMA2, LL_DMA_STREAM_0, LL_DMA_CHANNEL_0);
+	LL_DMA_ConfigTransfer(DMA2, LL_DMA_STREAM_0,
+	                      LL_DMA_DIRECTION_MEMORY_TO_MEMORY |
+	                      LL_DMA_PRIORITY_HIGH |
+	                      LL_DMA_MODE_NORMAL |
+	                      LL_DMA_PERIPH_INCREMENT |
+	                      LL_DMA_MEMORY_NOINCREMENT |
+	                      LL_DMA_PDATAALIGN_WORD |
+	                      LL_DMA_MDATAALIGN_WORD);
+
+	// Direct mode is not allowed for memory-to-memory transfers
+	LL_DMA_EnableFifoMode(DMA2, LL_DMA_STREAM_0);
+	LL_DMA_SetFIFOThreshold(DMA2, LL_DMA_STREAM_0, LL_DMA_FIFOTHRESHOLD_FULL);
+	LL_DMA_SetM2MDstAddress(DMA2, LL_DMA_STREAM_0, (uint32_t)&CRC->DR);
+
+	LL_DMA_EnableIT_TC(DMA2, LL_DMA_STREAM_0);
+	LL_DMA_EnableIT_TE(DMA2, LL_DMA_STREAM_0);
+	NVIC_SetPriority(DMA2_Stream0_IRQn, 2);
+	NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+
+	crc_busy = 0;
+	crc_done = 0;
+}
+
+void crc_engine_start(const uint32_t* words, uint32_t count, crc_callback_t callback){
+	// Starts feeding 'count' words to the CRC unit, returns straight away
+	while(crc_busy); // Only one transfer at a time
+
+	LL_CRC_ResetCRCCalculationUnit(CRC);
+	crc_done = callback;
+	crc_error = 0;
+
+	if(count == 0){
+		crc_value = LL_CRC_ReadData32(CRC);
+		if(crc_done) crc_done(crc_value, 0);
+		return;
+	}
+
+	crc_busy = 1;
+	LL_DMA_ClearFlag_TC0(DMA2);
+	LL_DMA_ClearFlag_HT0(DMA2);
+	LL_DMA_ClearFlag_TE0(DMA2);
+	LL_DMA_ClearFlag_FE0(DMA2);
+	LL_DMA_ClearFlag_DME0(DMA2);
+
+	LL_DMA_SetM2MSrcAddress(DMA2, LL_DMA_STREAM_0, (uint32_t)words);
+	LL_DMA_SetDataLength(DMA2, LL_DMA_STREAM_0, count);
+	LL_DMA_EnableStream(DMA2, LL_DMA_STREAM_0);
+}
+
+uint32_t crc_engine_busy(void){
+	// Returns 1 while a transfer is running, 0 otherwise
+	return crc_busy;
+}
+
+int crc_engine_result(uint32_t* crc){
+	// Gives the CRC of the last completed transfer ('crc' may be 0), returns 0 or CRC_ENGINE_ERROR
+	if(crc) *crc = crc_value;
+	return crc_error;
+}
+
+int crc_engine_wait(uint32_t* crc){
+	// Waits for the running transfer (if any) and gives its CRC ('crc' may be 0), returns 0 or CRC_ENGINE_ERROR
+	while(crc_busy);
+	return crc_engine_result(crc);
+}
+
+uint32_t crc_engine_feed(const uint32_t* words, uint32_t count){
+	// Feeds 'count' words to the CRC unit from the CPU and returns the CRC (no DMA, so it cannot fail)
+	while(crc_busy);
+
+	LL_CRC_ResetCRCCalculationUnit(CRC);
+	for(uint32_t i=0; i<count; i++){
+		LL_CRC_FeedData32(CRC, words[i]);
+	}
+	crc_value = LL_CRC_ReadData32(CRC);
+	crc_error = 0;
+	return crc_value;
+}
+
+void DMA2_Stream0_IRQHandler(void){
+	if(LL_DMA_IsActiveFlag_TC0(DMA2)){
+		LL_DMA_ClearFlag_TC0(DMA2);
+		crc_value = LL_CRC_ReadData32(CRC);
+	}
+	else if(LL_DMA_IsActiveFlag_TE0(DMA2)){
+		// Transfer error: the stream is disabled by hardware, the result is not valid
+		LL_DMA_ClearFlag_TE0(DMA2);
+		crc_value = LL_CRC_ReadData32(CRC);
+		crc_error = CRC_ENGINE_ERROR;
+	}
+	else{
+		return;
+	}
+	crc_busy = 0;
+	if(crc_done) crc_done(crc_value, crc_error);
+}
@@ -0,0 +1,349 @@
+#include "main.h"
+#include "Time_Delays.h"
+#include "I2C_Bus.h"
+#include "EEPROM.h"
+
+/*
+EEPROM
+Driver for the I2C EEPROM on I2C1, built on the transfer queue of I2C_Bus.c.
+eeprom_write_async sets a write up and returns. The data is split into page writes, each one a transfer with the
+two address bytes in cmd and the page's data in tx, queued when the previous one has finished. Between pages the
+EEPROM is busy with its internal write cycle and does not acknowledge its address, so a page write that comes
+back not acknowledged is simply queued again a little later (acknowledge polling), and the one that is
+acknowledged carries the page. Completion is signalled by eeprom_async_busy and an optional callback.
+Polls are spaced out by TIM5 (one pulse mode, 1 us per count), and the bus is free for other transfers while the
+writer waits. The time from the STOP of a page write to the first acknowledge is recorded in a histogram, and the
+delay to the first poll and the interval between polls are worked out from it: the first poll goes just before
+the shortest cycles seen so far, and the interval is small enough to catch most cycles within a fraction of the
+spread. A cycle that takes longer than EEPROM_WRITE_TIMEOUT_US ends the write with EEPROM_TIMEOUT, as does a
+transfer the I2C1 queue gave up on after recovering the bus (I2C_TIMEOUT). The waits below call i2c_poll, so a
+held bus is noticed and recovered while the main program waits.
+A page write cut short by a bus recovery has had some of its data bytes taken, and the STOP of the recovery starts
+a write cycle of them. The EEPROM then does not acknowledge the retry, so once a page write has been run again a
+NACK is taken as the write cycle: the page is polled with and written again in full once the EEPROM answers. A
+page write that fails for good leaves the EEPROM to be polled before the next write or read.
+Reads are transfers of up to EEPROM_READ_CHUNK bytes (the address in cmd, then a sequential read into the
+caller's buffer, by DMA for more than one byte), the first one polled the same way, so a read queued during a
+write cycle waits for it without blocking.
+The transfers are in the lowest priority class of the I2C1 queue. Each page write, poll and read chunk is a
+transfer of its own, so a sensor read waits for one of them at most, and the sensors are read while the EEPROM
+is busy with its internal write cycle (the bus is free until the next poll).
+*/
+
+// States of the driver
+#define EE_IDLE 0 // Nothing to do
+#define EE_BUSY 1 // Transfer queued or on the bus
+#define EE_WAIT 2 // Waiting for TIM5 before the next poll
+
+static volatile uint32_t ee_state = EE_IDLE;
+static volatile int ee_error; // Result of the last asynchronous write or read
+static uint32_t eeprom_write_pending; // 1 after a page write until the EEPROM acknowledges again
+
+static struct I2C_Transfer ee_transfer; // Page write, poll or read being run
+static uint16_t ee_address; // Address of the current page write
+static const unsigned char* ee_data; // Data for the current page write
+static unsigned char* ee_rx; // Where the current read chunk goes
+static uint16_t ee_length; // Bytes left to write or read, including the current page or chunk
+static eeprom_callback_t ee_done;
+
+static struct EEPROM_Stats ee_stats; // Write cycle measurements
+static uint32_t ee_cycle_start; // micros() at the STOP of the last page write
+static uint32_t ee_cycle_timed; // The pending cycle started at the end of a page write (not of a recovery)
+
+static void ee_transfer_done(struct I2C_Transfer* t);
+
+void eeprom_configure(void){
+	// Sets up TIM5 for the polls (i2c_bus_configure must be called first)
+	eeprom_stats_reset();
+	
+	// TIM5 counts microseconds and stops at the update event (one pulse mode)
+	LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_TIM5);
+	LL_TIM_SetPrescaler(TIM5, SystemCoreClock / 1000000 - 1);
+	LL_TIM_SetOnePulseMode(TIM5, LL_TIM_ONEPULSEMODE_SINGLE);
+	LL_TIM_SetUpdateSource(TIM5, LL_TIM_UPDATESOURCE_COUNTER);
+	LL_TIM_GenerateEvent_UPDATE(TIM5); // Load the prescaler
+	LL_TIM_ClearFlag_UPDATE(TIM5);
+	LL_TIM_EnableIT_UPDATE(TIM5);
+	NVIC_SetPriority(TIM5_IRQn, 1); // Same as the I2C1 interrupts, the transfers are queued from here
+	NVIC_EnableIRQ(TIM5_IRQn);
+	
+	ee_transfer.address = EEPROMADR;
+	ee_transfer.flags = 0;
+	ee_transfer.priority = I2C_PRIORITY_LOW; // Sensor reads go first
+	ee_transfer.done = ee_transfer_done;
+}
+
+static void ee_submit(void){
+	// Queues ee_transfer (again)
+	ee_state = EE_BUSY;
+	i2c_submit(&ee_transfer, 1);
+}
+
+static void ee_poll_later(uint32_t us){
+	// Queues ee_transfer after 'us' microseconds
+	if(us == 0){
+		ee_submit();
+		return;
+	}
+	ee_state = EE_WAIT;
+	LL_TIM_SetAutoReload(TIM5, us);
+	LL_TIM_SetCounter(TIM5, 0);
+	LL_TIM_EnableCounter(TIM5);
+}
+
+static uint32_t ee_percentile(uint32_t percent){
+	// Upper edge of the histogram bin that contains the given percentile of the measured cycles
+	uint32_t target = (ee_stats.cycles * percent + 99) / 100;
+	uint32_t sum = 0;
+	
+	for(int i=0; i<EEPROM_HIST_BINS; i++){
+		sum += ee_stats.histogram[i];
+		if(sum >= target){
+			return (i+1) * EEPROM_HIST_BIN_US;
+		}
+	}
+	return EEPROM_HIST_BINS * EEPROM_HIST_BIN_US;
+}
+
+static void ee_record_cycle(uint32_t us){
+	// Adds a measured write cycle and adapts the polling to the distribution
+	uint32_t bin = us / EEPROM_HIST_BIN_US;
+	
+	ee_stats.cycles++;
+	ee_stats.total_us += us;
+	if(us < ee_stats.min_us) ee_stats.min_us = us;
+	if(us > ee_stats.max_us) ee_stats.max_us = us;
+	ee_stats.histogram[(bin < EEPROM_HIST_BINS) ? bin : EEPROM_HIST_BINS-1]++;
+	
+	// First poll a little before the shortest cycle, then poll often enough to land within an eighth of
+	// the spread between fast (5th percentile) and slow (95th percentile) cycles
+	ee_stats.first_poll_us = (ee_stats.min_us > EEPROM_HIST_BIN_US) ? ee_stats.min_us - EEPROM_HIST_BIN_US : 0;
+	uint32_t spread = ee_percentile(95) - ee_percentile(5);
+	ee_stats.poll_interval_us = spread / 8;
+	if(ee_stats.poll_interval_us < 50) ee_stats.poll_interval_us = 50;
+	if(ee_stats.poll_interval_us > 1000) ee_stats.poll_interval_us = 1000;
+}
+
+static void ee_first_poll(void){
+	// Queues ee_transfer, after the expected write cycle time if the EEPROM is busy
+	if(eeprom_write_pending){
+		uint32_t elapsed = micros() - ee_cycle_start;
+		ee_poll_later((elapsed < ee_stats.first_poll_us) ? ee_stats.first_poll_us - elapsed : 0);
+	}
+	else{
+		ee_submit();
+	}
+}
+
+static void ee_finish(int error){
+	// Ends the write or read
+	eeprom_callback_t done = ee_done;
+	ee_error = error;
+	ee_length = 0;
+	ee_state = EE_IDLE;
+	if(done) done(error);
+}
+
+static void ee_next_page(void){
+	// Sets up the next page write, or finishes
+	if(ee_length == 0){
+		ee_finish(ee_error);
+		return;
+	}
+	uint16_t page = EEPROM_PAGE_SIZE - (ee_address % EEPROM_PAGE_SIZE); // Bytes left in this page
+	if(page > ee_length){
+		page = ee_length;
+	}
+	ee_transfer.cmd[0] = (unsigned char)(ee_address >> 8); //ADDRESS HIGH BYTE
+	ee_transfer.cmd[1] = (unsigned char)(ee_address & 0x00FF); //ADDRESS LOW BYTE
+	ee_transfer.cmd_length = 2;
+	ee_transfer.tx = ee_data;
+	ee_transfer.tx_length = page;
+	ee_transfer.rx_length = 0;
+	ee_first_poll();
+}
+
+static void ee_read_chunk(void){
+	// Sets up the read of the next chunk
+	ee_transfer.cmd[0] = (unsigned char)(ee_address >> 8); //ADDRESS HIGH BYTE
+	ee_transfer.cmd[1] = (unsigned char)(ee_address & 0x00FF); //ADDRESS LOW BYTE
+	ee_transfer.cmd_length = 2;
+	ee_transfer.tx_length = 0;
+	ee_transfer.rx = ee_rx;
+	ee_transfer.rx_length = (ee_length < EEPROM_READ_CHUNK) ? ee_length : EEPROM_READ_CHUNK;
+}
+
+static void ee_cycle_started(uint32_t timed){
+	// The EEPROM has started an internal write cycle, it is polled before anything else is sent to it. 'timed' is
+	// 0 for a cycle started by the STOP of a bus recovery, whose time is not recorded
+	eeprom_write_pending = 1;
+	ee_cycle_timed = timed;
+	ee_cycle_start = micros();
+}
+
+static void ee_transfer_done(struct I2C_Transfer* t){
+	// A page write, poll or read has finished (I2C1 interrupt)
+	if(t->tx_length && t->tries > 1 && t->status != I2C_OK && !eeprom_write_pending){
+		// Run again after a bus recovery: the bytes that got through are being written, poll with the page
+		ee_cycle_started(0);
+	}
+	if(t->status == I2C_NACK && eeprom_write_pending){
+		if(micros() - ee_cycle_start < EEPROM_WRITE_TIMEOUT_US){
+			// Not acknowledged: still busy with the internal write cycle, try again later
+			ee_stats.polls++;
+			ee_poll_later(ee_stats.poll_interval_us);
+		}
+		else{
+			ee_stats.timeouts++;
+			eeprom_write_pending = 0;
+			ee_finish(EEPROM_TIMEOUT);
+		}
+		return;
+	}
+	if(t->status != I2C_OK){
+		ee_finish((t->status == I2C_TIMEOUT) ? EEPROM_TIMEOUT : EEPROM_ERROR);
+		return;
+	}
+	
+	// Acknowledged, so the EEPROM has finished any internal write cycle
+	if(eeprom_write_pending && ee_cycle_timed){
+		ee_record_cycle(t->acked_us - ee_cycle_start);
+	}
+	eeprom_write_pending = 0;
+	if(t->tx_length == 0){
+		if(t->rx_length && ee_length > t->rx_length){
+			// Next chunk of a read, queued behind anything of a higher class that came meanwhile
+			ee_address = (uint16_t)((ee_address + t->rx_length) & (EEPROM_SIZE - 1));
+			ee_rx += t->rx_length;
+			ee_length -= t->rx_length;
+			ee_read_chunk();
+			ee_submit();
+			return;
+		}
+		ee_finish(0); // Poll or last chunk of a read
+		return;
+	}
+	ee_cycle_started(1); // The EEPROM does not respond until the page is written
+	ee_address += t->tx_length;
+	ee_data += t->tx_length;
+	ee_length -= t->tx_length;
+	ee_next_page();
+}
+
+void eeprom_write_async(uint16_t address, const unsigned char* data, uint16_t length, eeprom_callback_t callback){
+	// Starts writing 'length' bytes from any address and returns. 'data' must stay valid until the write
+	// finishes. A length of 0 only waits (polls) until the EEPROM has finished its internal write cycle
+	eeprom_async_wait(); // One write or read at a time
+	
+	ee_address = address;
+	ee_data = data;
+	ee_length = length;
+	ee_done = callback;
+	ee_error = 0;
+	
+	if(length == 0){
+		ee_transfer.cmd_length = 0; // Address only
+		ee_transfer.tx_length = 0;
+		ee_transfer.rx_length = 0;
+		ee_state = EE_BUSY;
+		ee_first_poll();
+	}
+	else{
+		ee_state = EE_BUSY;
+		ee_next_page();
+	}
+}
+
+uint32_t eeprom_async_busy(void){
+	// Returns 1 while an asynchronous write or read is running, 0 otherwise
+	return ee_state != EE_IDLE;
+}
+
+int eeprom_async_wait(void){
+	// Waits for the asynchronous write or read to finish, returns its error (0 on success, EEPROM_ERROR or
+	// EEPROM_TIMEOUT). Bounded by EEPROM_WRITE_TIMEOUT_US and the I2C1 deadlines
+	while(ee_state != EE_IDLE){
+		i2c_poll();
+	}
+	return ee_error;
+}
+
+int eeprom_write(uint16_t address, const unsigned char* data, uint16_t length){
+	// Writes 'length' bytes from any address and waits until they have been sent, returns 0 on success or the error
+	eeprom_write_async(address, data, length, 0);
+	return eeprom_async_wait();
+}
+
+int eeprom_wait_ready(void){
+	// Waits for any write to finish, including the EEPROM's internal write cycle of the last page. Returns 0, or the
+	// error of the write (or read) that was running, or of the polling
+	int error = eeprom_async_wait();
+	if(eeprom_write_pending){
+		eeprom_write_async(0, 0, 0, 0);
+		int poll = eeprom_async_wait();
+		if(!error){
+			error = poll;
+		}
+	}
+	return error;
+}
+
+int eeprom_read(uint16_t address, unsigned char* data, uint16_t length){
+	// Reads 'length' bytes from the EEPROM starting at 'address' (sequential read) and waits for them, returns 0 on
+	// success or the error (the data is then not all read)
+	if(length == 0){
+		return 0;
+	}
+	eeprom_read_async(address, data, length, 0);
+	return eeprom_async_wait();
+}
+
+void eeprom_read_async(uint16_t address, unsigned char* data, uint16_t length, eeprom_callback_t callback){
+	// Queues a sequential read of 'length' (at least 1) bytes into 'data' and returns. A write cycle still
+	// running is waited for by polling, like a page write. Completion is signalled like an asynchronous write
+	eeprom_async_wait(); // One write or read at a time
+	
+	ee_done = callback;
+	ee_error = 0;
+	ee_address = address;
+	ee_rx = data;
+	ee_length = length;
+	ee_read_chunk();
+	ee_state = EE_BUSY;
+	ee_first_poll();
+}
+
+const struct EEPROM_Stats* eeprom_stats(void){
+	// Write cycle measurements, for comparing EEPROM chips
+	return &ee_stats;
+}
+
+uint32_t eeprom_stats_mean_us(void){
+	// Mean write cycle time in microseconds (0 before the first measurement)
+	return ee_stats.cycles ? ee_stats.total_us / ee_stats.cycles : 0;
+}
+
+void eeprom_stats_reset(void){
+	// Clears the measurements and goes back to polling straight away every 100 us
+	for(int i=0; i<EEPROM_HIST_BINS; i++){
+		ee_stats.histogram[i] = 0;
+	}
+	ee_stats.cycles = 0;
+	ee_stats.min_us = 0xFFFFFFFF;
+	ee_stats.max_us = 0;
+	ee_stats.total_us = 0;
+	ee_stats.polls = 0;
+	ee_stats.timeouts = 0;
+	ee_stats.first_poll_us = 0;
+	ee_stats.poll_interval_us = 100;
+}
+
+void TIM5_IRQHandler(void){
+	// Time for the next poll
+	if(LL_TIM_IsActiveFlag_UPDATE(TIM5)){
+		LL_TIM_ClearFlag_UPDATE(TIM5);
+		if(ee_state == EE_WAIT){
+			ee_submit();
+		}
+	}
+}
@@ -0,0 +1,215 @@
+#include <string.h>
+
+#include "EEPROM_Cache.h"
+
+/*
+EEPROM Cache
+Page sized write-back cache in RAM in front of the EEPROM driver. Writes only change the cached pages and mark
+them dirty, so several updates to the same page cost one page write cycle when the page is flushed. Pages are
+flushed when a line is needed for another page (least recently used first), by eeprom_cache_flush, or by
+eeprom_cache_poll once they have been dirty for longer than a given age.
+Reads are served from the cache when every page they cover is cached, otherwise they are read from the EEPROM
+with the dirty pages copied over the result.
+Dirty pages are lost on a reset, so anything that must survive one should be followed by eeprom_cache_flush.
+A read from the EEPROM that fails is returned as the error of the cache read, or of the cache write that needed
+the rest of a page (the page is then not cached, and the bytes from that page on are not written). A page whose
+write back fails, when it is sent or when the driver finishes it, stays dirty and is written again by the next
+flush or poll after the age; the first such error is kept and returned by the next eeprom_cache_write,
+eeprom_cache_wait, eeprom_cache_flush or eeprom_cache_poll (which only waits for the driver without a busy hook).
+Nothing in here touches the hardware, so the same file can be built against an EEPROM image on a host.
+*/
+
+static void line_failed(struct EEPROM_Cache* c, struct EEPROM_Cache_Line* line, int error){
+	// The line did not get written back: it stays dirty, and the error is kept for the caller
+	line->dirty = 1;
+	line->dirty_since = c->now;
+	if(!c->error){
+		c->error = error;
+	}
+}
+
+static int take_error(struct EEPROM_Cache* c){
+	// Returns the kept error and clears it
+	int error = c->error;
+	c->error = 0;
+	return error;
+}
+
+static void line_wait(struct EEPROM_Cache* c){
+	// The EEPROM driver may still be sending a flushed line, wait before changing any line
+	if(c->in_flight && c->eeprom->wait){
+		int error = c->eeprom->wait();
+		if(error){
+			line_failed(c, c->in_flight, error);
+		}
+	}
+	c->in_flight = 0;
+}
+
+static void line_flush(struct EEPROM_Cache* c, struct EEPROM_Cache_Line* line){
+	// Writes a dirty line back as one page write cycle
+	if(!line->valid || !line->dirty){
+		return;
+	}
+	line_wait(c);
+	int error = c->eeprom->write((uint16_t)(line->page * EEPROM_CACHE_PAGE_SIZE), line->data, EEPROM_CACHE_PAGE_SIZE);
+	if(error){
+		line_failed(c, line, error);
+		return;
+	}
+	line->dirty = 0;
+	c->in_flight = line;
+	c->flushes++;
+}
+
+static struct EEPROM_Cache_Line* line_find(struct EEPROM_Cache* c, uint16_t page){
+	// Returns the line holding 'page', or 0
+	for(int i=0; i<EEPROM_CACHE_LINES; i++){
+		if(c->lines[i].valid && c->lines[i].page == page){
+			return &c->lines[i];
+		}
+	}
+	return 0;
+}
+
+static struct EEPROM_Cache_Line* line_victim(struct EEPROM_Cache* c){
+	// Returns a free line, or the least recently used one after writing it back
+	struct EEPROM_Cache_Line* victim = &c->lines[0];
+	
+	for(int i=0; i<EEPROM_CACHE_LINES; i++){
+		if(!c->lines[i].valid){
+			return &c->lines[i];
+		}
+		if(c->lines[i].used < victim->used){
+			victim = &c->lines[i];
+		}
+	}
+	line_flush(c, victim);
+	return victim;
+}
+
+void eeprom_cache_init(struct EEPROM_Cache* c, const struct EEPROM_Ops* eeprom){
+	// Starts with an empty cache
+	memset(c, 0, sizeof(*c));
+	c->eeprom = eeprom;
+}
+
+int eeprom_cache_write(struct EEPROM_Cache* c, uint16_t address, const unsigned char* data, uint16_t length){
+	// Writes 'length' bytes into the cached pages, returns 0 on success, the EEPROM read error, or the error of a
+	// write back
+	while(length){
+		uint16_t page = address / EEPROM_CACHE_PAGE_SIZE;
+		uint16_t offset = address % EEPROM_CACHE_PAGE_SIZE;
+		uint16_t n = EEPROM_CACHE_PAGE_SIZE - offset; // Bytes in this page
+		if(n > length){
+			n = length;
+		}
+		
+		struct EEPROM_Cache_Line* line = line_find(c, page);
+		if(line){
+			c->hits++;
+		}
+		else{
+			c->misses++;
+			line = line_victim(c);
+			line_wait(c);
+			if(line->dirty){
+				return take_error(c); // Its write back failed, the line keeps its page
+			}
+			if(n < EEPROM_CACHE_PAGE_SIZE){
+				// Only part of the page is written, the rest has to come from the EEPROM
+				int error = c->eeprom->read((uint16_t)(page * EEPROM_CACHE_PAGE_SIZE), line->data, EEPROM_CACHE_PAGE_SIZE);
+				if(error){
+					line->valid = 0;
+					return error;
+				}
+			}
+			line->page = page;
+			line->valid = 1;
+			line->dirty = 0;
+		}
+		
+		if(line->dirty){
+			c->merged++;
+		}
+		else{
+			line->dirty = 1;
+			line->dirty_since = c->now;
+		}
+		line->used = ++c->use_count;
+		line_wait(c);
+		memcpy(line->data + offset, data, n);
+		
+		address += n;
+		data += n;
+		length -= n;
+	}
+	return take_error(c);
+}
+
+int eeprom_cache_read(struct EEPROM_Cache* c, uint16_t address, unsigned char* data, uint16_t length){
+	// Reads 'length' bytes, from RAM if all the pages are cached. Returns 0 on success or the EEPROM read error
+	uint16_t first = address / EEPROM_CACHE_PAGE_SIZE;
+	uint16_t last = (uint16_t)((address + length - 1) / EEPROM_CACHE_PAGE_SIZE);
+	int cached = 1;
+	int error = 0;
+	
+	if(length == 0){
+		return 0;
+	}
+	for(uint16_t page=first; page<=last && cached; page++){
+		cached = line_find(c, page) != 0;
+	}
+	
+	if(cached){
+		c->hits++;
+	}
+	else{
+		c->misses++;
+		error = c->eeprom->read(address, data, length);
+	}
+	
+	// Copy the cached pages over what was read (all of them if nothing was read)
+	for(int i=0; i<EEPROM_CACHE_LINES; i++){
+		struct EEPROM_Cache_Line* line = &c->lines[i];
+		if(!line->valid || line->page < first || line->page > last || (!cached && !line->dirty)){
+			continue;
+		}
+		uint32_t start = (uint32_t)line->page * EEPROM_CACHE_PAGE_SIZE; // Overlap of the page and the read
+		uint32_t end = start + EEPROM_CACHE_PAGE_SIZE;
+		if(start < address) start = address;
+		if(end > (uint32_t)address + length) end = (uint32_t)address + length;
+		memcpy(data + (start - address), line->data + (start - (uint32_t)line->page * EEPROM_CACHE_PAGE_SIZE), end - start);
+		line->used = ++c->use_count;
+	}
+	return error;
+}
+
+int eeprom_cache_wait(struct EEPROM_Cache* c){
+	// Waits for the page being written back, returns 0 or the error of a write back
+	line_wait(c);
+	return take_error(c);
+}
+
+int eeprom_cache_flush(struct EEPROM_Cache* c){
+	// Writes every dirty page back and waits for the last one, returns 0 or the error of a write back
+	for(int i=0; i<EEPROM_CACHE_LINES; i++){
+		line_flush(c, &c->lines[i]);
+	}
+	return eeprom_cache_wait(c);
+}
+
+int eeprom_cache_poll(struct EEPROM_Cache* c, uint32_t now, uint32_t max_age){
+	// Writes back the pages that have been dirty for longer than 'max_age' (same units as 'now'), without waiting
+	// for them. Returns 0 or the error of an earlier write back, taken once the driver has finished it
+	c->now = now;
+	if(c->in_flight && (!c->eeprom->busy || !c->eeprom->busy())){
+		line_wait(c);
+	}
+	for(int i=0; i<EEPROM_CACHE_LINES; i++){
+		if(c->lines[i].valid && c->lines[i].dirty && now - c->lines[i].dirty_since > max_age){
+			line_flush(c, &c->lines[i]);
+		}
+	}
+	return take_error(c);
+}
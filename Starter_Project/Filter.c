@@ -0,0 +1,201 @@
+#include "Filter.h"
+
+/*
+Filter
+Smooths the temperature samples before they are packed: a boxcar moving average, an exponential moving average
+or a median of a small window, all in fixed point on the Q7.3 samples. Samples are filtered in blocks, and each
+filter uses the Cortex-M4 DSP instructions where they help:
+ - boxcar: a running sum. The changes to the sum for two samples (new sample minus the one leaving the window)
+   are worked out with one SSUB16.
+ - EMA: y = alpha * x + (1 - alpha) * y in one SMLAD, with alpha in Q15 and y kept with FILTER_EMA_FRAC extra
+   fraction bits, so small steps are not lost to rounding.
+ - median: two neighbouring windows are sorted at once, one in each half of a word, with an odd-even
+   transposition network. Each compare and exchange is SSUB16 (sets the GE flags per half) and two SELs.
+The inputs are kept twice in history, FILTER_HISTORY apart, so the window of any sample is contiguous and no
+index has to wrap inside the kernels. The history starts filled with the first sample, so the output does not
+ramp up from zero.
+Nothing in here touches the hardware, so the same file can be built for host tools, where the DSP instructions
+are replaced by C versions that give the same results.
+*/
+
+#if defined(__ARM_FEATURE_DSP) || defined(__TARGET_FEATURE_DSPMUL)
+#include "main.h" // CMSIS intrinsics for the DSP instructions
+#else
+// C versions of the DSP instructions, __SSUB16 sets the GE flags that __SEL reads as on the Cortex-M4
+static uint32_t dsp_ge;
+
+static inline uint32_t __SSUB16(uint32_t a, uint32_t b){
+	int32_t lo = (int16_t)a - (int16_t)b;
+	int32_t hi = (int16_t)(a >> 16) - (int16_t)(b >> 16);
+	dsp_ge = (lo >= 0 ? 0x3u : 0) | (hi >= 0 ? 0xCu : 0);
+	return ((uint32_t)lo & 0xFFFF) | ((uint32_t)hi << 16);
+}
+
+static inline uint32_t __SEL(uint32_t a, uint32_t b){
+	return ((dsp_ge & 0x1) ? a & 0xFFFF : b & 0xFFFF) | ((dsp_ge & 0x4) ? a & 0xFFFF0000 : b & 0xFFFF0000);
+}
+
+static inline uint32_t __SMLAD(uint32_t a, uint32_t b, uint32_t acc){
+	return (uint32_t)((int32_t)acc + (int16_t)a * (int16_t)b + (int16_t)(a >> 16) * (int16_t)(b >> 16));
+}
+
+#define __PKHBT(a, b, s) (((uint32_t)(a) & 0xFFFF) | (((uint32_t)(b) << (s)) & 0xFFFF0000))
+#endif
+
+void filter_init(struct Filter* f, uint32_t type, uint32_t param){
+	// Sets a filter up, out of range values of param are clamped (see Filter.h)
+	f->type = type;
+	f->length = 1;
+	if(type == FILTER_BOXCAR){
+		if(param > FILTER_BOXCAR_MAX_SHIFT) param = FILTER_BOXCAR_MAX_SHIFT;
+		f->length = 1u << param;
+	}
+	else if(type == FILTER_EMA){
+		if(param < 1) param = 1;
+		if(param > 32767) param = 32767;
+	}
+	else if(type == FILTER_MEDIAN){
+		if(param > FILTER_MEDIAN_MAX) param = FILTER_MEDIAN_MAX;
+		param |= 1; // The window has a middle
+		f->length = param;
+	}
+	f->param = param;
+	f->index = 0;
+	f->primed = 0;
+	f->sum = 0;
+	f->ema = 0;
+}
+
+static void filter_prime(struct Filter* f, int16_t x){
+	// Fills the history with the first sample, as if it had always been there
+	for(uint32_t i=0; i<FILTER_HISTORY * 2; i++){
+		f->history[i] = x;
+	}
+	f->sum = x * (int32_t)f->length;
+	f->ema = x * (1 << FILTER_EMA_FRAC);
+	f->primed = 1;
+}
+
+static inline void filter_put(struct Filter* f, int16_t x){
+	// Adds a sample to the history (both copies)
+	f->history[f->index] = x;
+	f->history[f->index + FILTER_HISTORY] = x;
+	f->index = (f->index + 1) & (FILTER_HISTORY - 1);
+}
+
+static void boxcar_block(struct Filter* f, const int16_t* in, int16_t* out, uint32_t n){
+	uint32_t shift = f->param;
+	int32_t round = shift ? 1 << (shift - 1) : 0;
+	int32_t sum = f->sum;
+	uint32_t i = 0;
+
+	for(; i + 1 < n; i += 2){
+		int16_t x0 = in[i];
+		int16_t x1 = in[i + 1];
+		// The samples leaving the window. Each is read just before the sample that can overwrite it is added
+		// (x0 leaves x1's window when the length is 1)
+		const int16_t* old = &f->history[f->index + FILTER_HISTORY - f->length];
+		int16_t old0 = old[0];
+		filter_put(f, x0);
+		int16_t old1 = old[1];
+		filter_put(f, x1);
+		uint32_t d = __SSUB16(__PKHBT(x0, x1, 16), __PKHBT(old0, old1, 16)); // Both changes to the sum
+		sum += (int16_t)d;
+		out[i] = (int16_t)((sum + round) >> shift);
+		sum += (int32_t)d >> 16;
+		out[i + 1] = (int16_t)((sum + round) >> shift);
+	}
+	if(i < n){
+		int16_t x = in[i];
+		sum += x - f->history[f->index + FILTER_HISTORY - f->length];
+		filter_put(f, x);
+		out[i] = (int16_t)((sum + round) >> shift);
+	}
+	f->sum = sum;
+}
+
+static void ema_block(struct Filter* f, const int16_t* in, int16_t* out, uint32_t n){
+	int32_t alpha = (int32_t)f->param;
+	uint32_t coeff = __PKHBT(alpha, 32768 - alpha, 16);
+	int32_t y = f->ema;
+
+	for(uint32_t i=0; i<n; i++){
+		int32_t x = in[i] * (1 << FILTER_EMA_FRAC);
+		y = (int32_t)__SMLAD(__PKHBT(x, y, 16), coeff, 1 << 14) >> 15; // alpha * x + (1 - alpha) * y, rounded
+		out[i] = (int16_t)((y + (1 << (FILTER_EMA_FRAC - 1))) >> FILTER_EMA_FRAC);
+	}
+	f->ema = y;
+}
+
+static inline void median_cx(uint32_t* a, uint32_t* b){
+	// Compare and exchange in both halves: *a gets the smaller samples, *b the larger
+	uint32_t x = *a;
+	uint32_t y = *b;
+	__SSUB16(x, y); // GE set in the halves where x >= y
+	*a = __SEL(y, x);
+	*b = __SEL(x, y);
+}
+
+static void median_block(struct Filter* f, const int16_t* in, int16_t* out, uint32_t n){
+	uint32_t length = f->length;
+	uint32_t w[FILTER_MEDIAN_MAX];
+
+	for(uint32_t i=0; i<n; i+=2){
+		uint32_t pair = (i + 1 < n);
+		int16_t x0 = in[i];
+		int16_t x1 = pair ? in[i + 1] : x0;
+		// Window of x0 starts here, the one of x1 a sample later, both end before FILTER_HISTORY * 2
+		uint32_t start = (f->index - (length - 1)) & (FILTER_HISTORY - 1);
+		filter_put(f, x0);
+		if(pair){
+			filter_put(f, x1);
+		}
+
+		const int16_t* h = &f->history[start];
+		for(uint32_t k=0; k<length; k++){
+			w[k] = __PKHBT(h[k], h[k + 1], 16); // Low half: window of x0, high half: window of x1
+		}
+		for(uint32_t pass=0; pass<length; pass++){
+			for(uint32_t k=pass&1; k+1<length; k+=2){
+				median_cx(&w[k], &w[k + 1]);
+			}
+		}
+		out[i] = (int16_t)w[length / 2];
+		if(pair){
+			out[i + 1] = (int16_t)(w[length / 2] >> 16);
+		}
+	}
+}
+
+void filter_block(struct Filter* f, const int16_t* in, int16_t* out, uint32_t n){
+	// Filters n samples, out may be the same buffer as in
+	if(n == 0){
+		return;
+	}
+	if(!f->primed){
+		filter_prime(f, in[0]);
+	}
+	switch(f->type){
+		case FILTER_BOXCAR:
+			boxcar_block(f, in, out, n);
+			break;
+		case FILTER_EMA:
+			ema_block(f, in, out, n);
+			break;
+		case FILTER_MEDIAN:
+			median_block(f, in, out, n);
+			break;
+		default:
+			for(uint32_t i=0; i<n; i++){
+				out[i] = in[i];
+			}
+			break;
+	}
+}
+
+int16_t filter_sample(struct Filter* f, int16_t x){
+	// Filters a single sample
+	int16_t y;
+	filter_block(f, &x, &y, 1);
+	return y;
+}
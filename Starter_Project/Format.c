@@ -0,0 +1,68 @@
+#include "Format.h"
+
+/*
+Format
+Writes numbers for the LCD into a caller's buffer with integer arithmetic only, in place of sprintf, so the display
+code does not pull in the printf and floating point libraries (and does not spend thousands of cycles on each
+redraw). Each function writes a terminated string and returns its length.
+ - format_temperature: an 11-bit LM75 reading (two's complement, 0.125 degree steps) in degrees with the three
+   decimals the steps need, "22.125" or "-0.500". The fraction is one of eight, so it comes from a table.
+ - format_hex: like "%x", lower case without leading zeros.
+ - format_uint: like "%u".
+Nothing in here touches the hardware, so the same file can be built for host tools.
+*/
+
+static const char format_eighths[8][4] = { "000", "125", "250", "375", "500", "625", "750", "875" };
+static const char format_digits[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+                                        'a', 'b', 'c', 'd', 'e', 'f' };
+
+uint32_t format_uint(char* buf, uint32_t value){
+	char reversed[FORMAT_UINT_MAX];
+	uint32_t n = 0;
+	uint32_t length = 0;
+	
+	do{
+		reversed[n++] = (char)('0' + value % 10);
+		value /= 10;
+	}while(value);
+	while(n){
+		buf[length++] = reversed[--n];
+	}
+	buf[length] = '\0';
+	return length;
+}
+
+uint32_t format_hex(char* buf, uint32_t value){
+	uint32_t shift = 28;
+	uint32_t length = 0;
+	
+	while(shift && (value >> shift) == 0){ // Leading zeros
+		shift -= 4;
+	}
+	for(;;){
+		buf[length++] = format_digits[(value >> shift) & 0xF];
+		if(shift == 0){
+			break;
+		}
+		shift -= 4;
+	}
+	buf[length] = '\0';
+	return length;
+}
+
+uint32_t format_temperature(char* buf, uint16_t sample){
+	int32_t eighths = (sample & 0x400) ? (int32_t)(sample & 0x7FF) - 0x800 : (int32_t)(sample & 0x7FF);
+	uint32_t length = 0;
+	
+	if(eighths < 0){
+		buf[length++] = '-';
+		eighths = -eighths;
+	}
+	length += format_uint(buf + length, (uint32_t)eighths >> 3);
+	buf[length++] = '.';
+	for(int i=0; i<3; i++){
+		buf[length++] = format_eighths[eighths & 7][i];
+	}
+	buf[length] = '\0';
+	return length;
+}
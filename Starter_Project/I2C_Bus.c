@@ -0,0 +1,757 @@
+#include "main.h"
+#include "Time_Delays.h"
+#include "I2C_Bus.h"
+
+/*
+I2C Bus
+Runs every transaction on I2C1 from the interrupts. A driver describes a transaction in a struct I2C_Transfer
+(address, bytes to write, buffer to read into, callback) and queues it with i2c_submit, which returns straight
+away; the transfers are run one after the other, and each one's callback is called from the interrupt once it is
+over. A callback may queue the next transfer itself.
+Each transfer has a priority class (I2C_PRIORITY_HIGH for the sensor reads, NORMAL, LOW for the EEPROM) with its
+own queue, run in the order it was queued. When the bus comes free the oldest transfer of the highest class
+waiting goes next, so a sensor read waits for at most the one transfer already on the bus, never for a queue of
+EEPROM traffic. Transfers are not interrupted once started, so the drivers of long operations split them into
+transfers (the EEPROM driver: one per page write, poll or read chunk), and the gaps between them, including the
+EEPROM's internal write cycle, are where the higher classes get in. The delay from i2c_submit to the START is
+recorded per class (i2c_class_stats).
+A transfer is a write of cmd then tx, a read of rx after a repeated START, or both. Bytes are written from the
+event interrupt on TXE, the last one is let out (BTF) before the repeated START or the STOP. Reads of 2 bytes or
+more are moved by DMA1 Stream 0 (channel 1, I2C1_RX) with the I2C LAST bit set, so the peripheral NACKs the final
+byte by itself and the CPU only hears of the read when it is over (DMA transfer complete). A single byte is
+NACKed before ADDR is cleared and taken on RXNE.
+Transfers queued together can be chained (I2C_CHAIN): each one ends with a repeated START into the next instead of
+a STOP, so the bus is not let go between them and nothing else is run in between, whatever its class. A transfer
+whose address is not acknowledged ends with I2C_NACK and the chain carries on; a bus error ends the rest of the
+chain with I2C_ERROR.
+The I2C1 interrupts are only enabled in the peripheral while a transfer is on the bus.
+The SCL timing (i2c_bus_set_speed) is worked out from the APB1 clock as RCC has it set up when it is called, not
+from a copy of the clock settings, so it follows any change to SystemClock_Config. Speeds up to 100 kHz use
+standard mode and faster ones fast mode (duty cycle 2), up to I2C_SPEED_MAX.
+Every transfer on the bus has a deadline on the DWT cycle counter (I2C_TIMEOUT_US, plus I2C_TIMEOUT_BYTE_US per
+byte, which follows the bus speed: a byte takes 23 us at 400 kHz but 450 us at 20 kHz). A device holding the bus
+raises no interrupt, so the deadline is checked by i2c_poll, which every wait loop and the main loop call (its
+delays included). A transfer is only caught as late as the next i2c_poll: anything that blocks without calling it
+holds the whole queue, and the sampler's sensor reads, for that long. A transfer that misses its deadline, or meets
+a bus error, has the bus recovered: I2C1 lets go of the pins, SCL is clocked by hand until a device holding SDA low
+lets it go, a STOP is made, and I2C1 is reset with its timing kept. The transfer is then run again, up to
+I2C_RETRIES times, and ends with I2C_TIMEOUT or I2C_ERROR after that. The wait for the previous STOP before a START
+has a deadline as well. Each device's transfers, timeouts, retries and recoveries are counted with a histogram of
+transfer times (i2c_device_stats), so the worst cases can be seen.
+Each transaction is also recorded as it finishes in a ring of the newest I2C_TRACE_SIZE (struct I2C_Trace): its
+time, address, lengths, first bytes each way, status, tries and duration. The transfers of a chain that are not run
+after an earlier one failed are recorded (and counted as failures) with its status and 0 tries. Recording copies a
+few bytes in the interrupt that ends the transfer, and can be turned off (i2c_trace_enable). i2c_trace_copy takes
+the newest entries for the program; for a unit in the field the ring (ib_trace, found by its I2C_TRACE_MAGIC) is
+saved from RAM with the debugger, e.g. in uVision "SAVE trace.hex &ib_trace, &ib_trace + sizeof(ib_trace) - 1" and
+then "objcopy -I ihex -O binary trace.hex trace.bin", and replayed on a host against the device models with
+Host_Tools/I2C_Replay.
+*/
+
+// States of the transfer at the head of the queue
+#define IB_IDLE      0 // Nothing queued
+#define IB_START     1 // START requested, waiting for SB
+#define IB_ADDRESS_W 2 // Control byte (write) sent, waiting for ADDR or AF
+#define IB_WRITE     3 // Writing cmd and tx on TXE
+#define IB_BTF       4 // Last byte loaded, waiting for it to go out
+#define IB_RESTART   5 // Repeated START for the read requested, waiting for SB
+#define IB_ADDRESS_R 6 // Control byte (read) sent, waiting for ADDR or AF
+#define IB_READ_DMA  7 // Bytes coming in by DMA, waiting for transfer complete
+#define IB_READ_BYTE 8 // Single byte coming in, waiting for RXNE
+
+static volatile uint32_t ib_state = IB_IDLE;
+static struct I2C_Transfer* volatile ib_head; // Transfer on the bus (the first of its class queue)
+static struct I2C_Transfer* ib_queue[I2C_PRIORITIES]; // Oldest transfer of each class, the rest follow on 'next'
+static struct I2C_Transfer* ib_tail[I2C_PRIORITIES];
+static struct I2C_Class_Stats ib_classes[I2C_PRIORITIES];
+static uint32_t ib_index; // Bytes written of cmd and tx
+static uint32_t ib_chained; // The end of the head transfer has already been requested as a repeated START
+static uint32_t ib_completing; // A callback is running, the next transfer is started after it
+
+// Pins of I2C1 (set up by i2c_1_configure), driven as GPIO during a recovery
+#define IB_GPIO GPIOB
+#define IB_SCL  LL_GPIO_PIN_8
+#define IB_SDA  LL_GPIO_PIN_9
+
+static uint32_t ib_cycles_us; // DWT cycles per microsecond
+static uint32_t ib_speed; // SCL frequency set by i2c_bus_set_speed
+static uint32_t ib_byte_us = I2C_TIMEOUT_BYTE_US(I2C_SPEED_MIN); // Deadline per byte at that speed (the slowest, until set)
+static uint32_t ib_started; // Cycle count at the first START of the head transfer
+static uint32_t ib_deadline; // Cycle count by which the head transfer has to have finished
+static uint32_t ib_tries; // Times the head transfer has been run again
+static struct I2C_Device_Stats ib_devices[I2C_DEVICES];
+static struct I2C_Device_Stats* ib_device; // Counters of the head transfer's device
+static struct I2C_Trace ib_trace = { .magic = I2C_TRACE_MAGIC, .size = I2C_TRACE_SIZE };
+static uint32_t ib_tracing = 1; // Transactions are recorded in ib_trace
+
+static inline uint32_t ib_cycles(void){
+	return DWT->CYCCNT;
+}
+
+void i2c_bus_configure(void){
+	// Sets up the DMA for reads and the I2C1 interrupts (i2c_1_configure must be called first)
+
+	// DMA1 Stream 0 channel 1 moves received bytes from I2C1->DR to memory
+	LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+	LL_DMA_DisableStream(DMA1, LL_DMA_STREAM_0);
+	LL_DMA_SetChannelSelection(DMA1, LL_DMA_STREAM_0, LL_DMA_CHANNEL_1);
+	LL_DMA_ConfigTransfer(DMA1, LL_DMA_STREAM_0,
+	                      LL_DMA_DIRECTION_PERIPH_TO_MEMORY |
+	                      LL_DMA_PRIORITY_HIGH |
+	                      LL_DMA_MODE_NORMAL |
+	                      LL_DMA_PERIPH_NOINCREMENT |
+	                      LL_DMA_MEMORY_INCREMENT |
+	                      LL_DMA_PDATAALIGN_BYTE |
+	                      LL_DMA_MDATAALIGN_BYTE);
+	LL_DMA_DisableFifoMode(DMA1, LL_DMA_STREAM_0);
+	LL_DMA_SetPeriphAddress(DMA1, LL_DMA_STREAM_0, (uint32_t)&I2C1->DR);
+	LL_DMA_EnableIT_TC(DMA1, LL_DMA_STREAM_0);
+	LL_DMA_EnableIT_TE(DMA1, LL_DMA_STREAM_0);
+	NVIC_SetPriority(DMA1_Stream0_IRQn, 1);
+	NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+
+	// The drivers' timers (TIM2, TIM5) use the same priority, so a transfer is never queued from an interrupt
+	// that has interrupted the engine
+	NVIC_SetPriority(I2C1_EV_IRQn, 1);
+	NVIC_SetPriority(I2C1_ER_IRQn, 1);
+	NVIC_EnableIRQ(I2C1_EV_IRQn);
+	NVIC_EnableIRQ(I2C1_ER_IRQn);
+
+	// The cycle counter times the deadlines
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	ib_cycles_us = SystemCoreClock / 1000000;
+	i2c_stats_reset();
+}
+
+uint32_t i2c_bus_set_speed(uint32_t hz){
+	// Sets the SCL clock from the APB1 clock, once the transfers queued have finished (main program only). Returns
+	// the SCL frequency set (the divider rounds it down), or 0 if 'hz' is out of range, or the APB1 clock cannot
+	// give it (at least 2 MHz for standard mode and 4 MHz for fast mode), and the speed is left as it was
+	LL_RCC_ClocksTypeDef clocks;
+	uint32_t pclk;
+	uint32_t ccr;
+	uint32_t primask;
+
+	LL_RCC_GetSystemClocksFreq(&clocks);
+	pclk = clocks.PCLK1_Frequency;
+	if(hz < I2C_SPEED_MIN || hz > I2C_SPEED_MAX || pclk < ((hz > I2C_SPEED_STANDARD) ? 4000000 : 2000000) ||
+	   pclk / (2 * hz) > (I2C_CCR_CCR >> I2C_CCR_CCR_Pos)){
+		return 0;
+	}
+
+	// Nothing on the bus while the timing changes, the interrupts stay off so nothing new is queued meanwhile
+	for(;;){
+		primask = __get_PRIMASK();
+		__disable_irq();
+		if(!i2c_busy()){
+			break;
+		}
+		__set_PRIMASK(primask);
+		i2c_poll();
+	}
+	LL_I2C_Disable(I2C1); // CCR and TRISE can only be written with the peripheral off
+	LL_I2C_ConfigSpeed(I2C1, pclk, hz, LL_I2C_DUTYCYCLE_2);
+	LL_I2C_Enable(I2C1);
+
+	// The frequency the divider gives: 2 * CCR periods in standard mode, 3 * CCR in fast mode
+	ccr = (I2C1->CCR & I2C_CCR_CCR) >> I2C_CCR_CCR_Pos;
+	ib_speed = pclk / (((I2C1->CCR & I2C_CCR_FS) ? 3 : 2) * ccr);
+	ib_trace.speed = ib_speed;
+	ib_byte_us = I2C_TIMEOUT_BYTE_US(ib_speed);
+	__set_PRIMASK(primask);
+	return ib_speed;
+}
+
+uint32_t i2c_bus_speed(void){
+	// SCL frequency set up, 0 before i2c_bus_set_speed
+	return ib_speed;
+}
+
+static void ib_delay(uint32_t us){
+	// Busy wait on the cycle counter (SysTick does not count while the interrupts are off)
+	uint32_t start = ib_cycles();
+	while(ib_cycles() - start < us * ib_cycles_us);
+}
+
+static struct I2C_Device_Stats* ib_find(uint8_t address){
+	// Counters of a device, a free entry is given to a new address
+	for(uint32_t i=0; i<I2C_DEVICES-1; i++){
+		if(ib_devices[i].address == address || ib_devices[i].address == 0){
+			ib_devices[i].address = address;
+			return &ib_devices[i];
+		}
+	}
+	return &ib_devices[I2C_DEVICES-1]; // Table full
+}
+
+static void ib_recover(void){
+	// Frees a bus held by a device: up to I2C_RECOVERY_CLOCKS pulses on SCL until it lets SDA go (it finishes
+	// the byte it was sending and takes the last pulse as a NACK), a STOP, then a reset of I2C1
+	uint32_t start = ib_cycles();
+	uint32_t cr2 = I2C1->CR2 & I2C_CR2_FREQ; // Timing, kept over the reset
+	uint32_t ccr = I2C1->CCR;
+	uint32_t trise = I2C1->TRISE;
+
+	LL_I2C_Disable(I2C1);
+	LL_GPIO_SetOutputPin(IB_GPIO, IB_SCL | IB_SDA); // Open drain, released
+	LL_GPIO_SetPinMode(IB_GPIO, IB_SCL, LL_GPIO_MODE_OUTPUT);
+	LL_GPIO_SetPinMode(IB_GPIO, IB_SDA, LL_GPIO_MODE_OUTPUT);
+	for(uint32_t i=0; i<I2C_RECOVERY_CLOCKS && !LL_GPIO_IsInputPinSet(IB_GPIO, IB_SDA); i++){
+		LL_GPIO_ResetOutputPin(IB_GPIO, IB_SCL);
+		ib_delay(5); // 100 kHz
+		LL_GPIO_SetOutputPin(IB_GPIO, IB_SCL);
+		ib_delay(5);
+	}
+	LL_GPIO_ResetOutputPin(IB_GPIO, IB_SCL); // STOP: SDA goes high while SCL is high
+	ib_delay(5);
+	LL_GPIO_ResetOutputPin(IB_GPIO, IB_SDA);
+	ib_delay(5);
+	LL_GPIO_SetOutputPin(IB_GPIO, IB_SCL);
+	ib_delay(5);
+	LL_GPIO_SetOutputPin(IB_GPIO, IB_SDA);
+	ib_delay(5);
+	LL_GPIO_SetPinMode(IB_GPIO, IB_SCL, LL_GPIO_MODE_ALTERNATE);
+	LL_GPIO_SetPinMode(IB_GPIO, IB_SDA, LL_GPIO_MODE_ALTERNATE);
+
+	// A reset clears BUSY, which a glitch can leave set for good
+	LL_I2C_EnableReset(I2C1);
+	LL_I2C_DisableReset(I2C1);
+	I2C1->CR2 = cr2;
+	I2C1->CCR = ccr;
+	I2C1->TRISE = trise;
+	LL_I2C_Enable(I2C1);
+
+	uint32_t us = (ib_cycles() - start) / ib_cycles_us;
+	ib_device->recoveries++;
+	if(us > ib_device->recovery_max_us){
+		ib_device->recovery_max_us = us;
+	}
+}
+
+static uint32_t ib_budget(const struct I2C_Transfer* t){
+	// Cycles the transfer may take on the bus
+	uint32_t bytes = 1 + t->cmd_length + t->tx_length + (t->rx_length ? 1 + t->rx_length : 0);
+	return (I2C_TIMEOUT_US + bytes * ib_byte_us) * ib_cycles_us;
+}
+
+static void ib_go(void){
+	// Puts the head transfer on the bus (the first time or again) and sets its deadline
+	uint32_t start = ib_cycles();
+
+	while(READ_BIT(I2C1->CR1, I2C_CR1_STOP)){ // A STOP from the previous transaction takes a few microseconds
+		if(ib_cycles() - start > I2C_STOP_TIMEOUT_US * ib_cycles_us){
+			ib_recover(); // Something holds the bus
+			break;
+		}
+	}
+	ib_deadline = ib_cycles() + ib_budget(ib_head);
+	ib_state = IB_START;
+	LL_I2C_EnableIT_EVT(I2C1);
+	LL_I2C_EnableIT_ERR(I2C1);
+	LL_I2C_GenerateStartCondition(I2C1); //START
+}
+
+static void ib_begin(void){
+	// A new head transfer goes on the bus: its clock starts, and its time in the queue is counted
+	struct I2C_Class_Stats* c = &ib_classes[ib_head->priority];
+	uint32_t us;
+	uint32_t bin = 0;
+
+	ib_started = ib_cycles();
+	ib_tries = 0;
+	ib_device = ib_find(ib_head->address);
+
+	us = (ib_started - ib_head->queued) / ib_cycles_us;
+	c->transfers++;
+	c->total_us += us;
+	if(us > c->max_us){
+		c->max_us = us;
+	}
+	while(bin < I2C_LATENCY_BINS-1 && us >= (uint32_t)I2C_LATENCY_BIN_US << bin){
+		bin++;
+	}
+	c->histogram[bin]++;
+}
+
+static struct I2C_Transfer* ib_next(void){
+	// Oldest transfer of the highest class waiting, 0 if there is none
+	for(uint32_t c=0; c<I2C_PRIORITIES; c++){
+		if(ib_queue[c]){
+			return ib_queue[c];
+		}
+	}
+	return 0;
+}
+
+static void ib_start(void){
+	// Puts a new head transfer on the bus with a START
+	ib_begin();
+	ib_go();
+}
+
+void i2c_submit(struct I2C_Transfer* t, uint32_t n){
+	// Queues the transfers t[0] to t[n-1] in the class of t[0].priority and returns. They run one after the
+	// other, and nothing of the same class queued later runs before the last of them (transfers of a higher class
+	// may run in between, unless they are chained). Each one keeps its status I2C_PENDING until it has finished
+	uint32_t c = t[0].priority;
+	uint32_t now = ib_cycles();
+	for(uint32_t i=0; i<n; i++){
+		t[i].priority = (uint8_t)c;
+		t[i].status = I2C_PENDING;
+		t[i].acked_us = 0;
+		t[i].queued = now;
+		t[i].next = (i + 1 < n) ? &t[i + 1] : 0;
+	}
+
+	uint32_t primask = __get_PRIMASK(); // May be called from the main program or from a callback
+	__disable_irq();
+	if(ib_queue[c]){
+		ib_tail[c]->next = t;
+	}
+	else{
+		ib_queue[c] = t;
+	}
+	ib_tail[c] = &t[n - 1];
+	if(ib_state == IB_IDLE && !ib_completing){
+		ib_head = ib_next();
+		ib_start();
+	}
+	__set_PRIMASK(primask);
+}
+
+uint32_t i2c_wait(const struct I2C_Transfer* t){
+	// Waits for a transfer to finish and returns its status (main program only). The wait is bounded by the
+	// deadlines of the transfers queued before it and its own, each tried 1 + I2C_RETRIES times
+	while(t->status == I2C_PENDING){
+		i2c_poll();
+	}
+	return t->status;
+}
+
+uint32_t i2c_busy(void){
+	// Returns 1 while any transfer is queued or on the bus
+	return ib_head != 0;
+}
+
+static void ib_complete(uint32_t status, uint32_t chained);
+
+static void ib_retry(uint32_t status){
+	// The head transfer has missed its deadline or met a bus error (I2C_TIMEOUT or I2C_ERROR): recovers the bus
+	// and runs the transfer again, or ends it with 'status' once it has used its retries
+	if(status == I2C_TIMEOUT){
+		ib_device->timeouts++;
+	}
+	else{
+		ib_device->bus_errors++;
+	}
+	LL_DMA_DisableStream(DMA1, LL_DMA_STREAM_0);
+	LL_I2C_DisableDMAReq_RX(I2C1);
+	LL_I2C_DisableLastDMA(I2C1);
+	LL_I2C_DisableIT_BUF(I2C1);
+	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK);
+	ib_recover();
+	if(ib_tries < I2C_RETRIES){
+		ib_tries++;
+		ib_device->retries++;
+		ib_go();
+	}
+	else{
+		ib_complete(status, 0);
+	}
+}
+
+uint32_t i2c_poll(void){
+	// Checks the deadline of the transfer on the bus, and recovers the bus and retries the transfer if it has
+	// passed. Returns 1 if it had. Called by the wait loops and the main loop (main program only)
+	uint32_t late = 0;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if(ib_head && ib_state != IB_IDLE && !ib_completing && (int32_t)(ib_cycles() - ib_deadline) > 0){
+		ib_retry(I2C_TIMEOUT);
+		late = 1;
+	}
+	__set_PRIMASK(primask);
+	return late;
+}
+
+const struct I2C_Device_Stats* i2c_device_stats(uint8_t address){
+	// Counters of the device at 'address', 0 if it has not been addressed since i2c_stats_reset
+	for(uint32_t i=0; i<I2C_DEVICES; i++){
+		if(ib_devices[i].address == address && (address != 0 || i == I2C_DEVICES-1)){
+			return &ib_devices[i];
+		}
+	}
+	return 0;
+}
+
+void i2c_stats_reset(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	for(uint32_t i=0; i<I2C_PRIORITIES; i++){
+		ib_classes[i].transfers = 0;
+		ib_classes[i].total_us = 0;
+		ib_classes[i].max_us = 0;
+		for(uint32_t b=0; b<I2C_LATENCY_BINS; b++){
+			ib_classes[i].histogram[b] = 0;
+		}
+	}
+	for(uint32_t i=0; i<I2C_DEVICES; i++){
+		struct I2C_Device_Stats* d = &ib_devices[i];
+		d->address = 0;
+		d->transfers = 0;
+		d->nacks = 0;
+		d->failures = 0;
+		d->timeouts = 0;
+		d->bus_errors = 0;
+		d->retries = 0;
+		d->recoveries = 0;
+		d->recovery_max_us = 0;
+		d->max_us = 0;
+		for(uint32_t b=0; b<I2C_LATENCY_BINS; b++){
+			d->histogram[b] = 0;
+		}
+	}
+	if(ib_head){
+		ib_device = ib_find(ib_head->address);
+	}
+	__set_PRIMASK(primask);
+}
+
+const struct I2C_Class_Stats* i2c_class_stats(uint32_t priority){
+	// Queueing delay of a priority class
+	return &ib_classes[priority < I2C_PRIORITIES ? priority : I2C_PRIORITIES-1];
+}
+
+void i2c_trace_enable(uint32_t on){
+	// Turns the recording of transactions on (the default) or off, the entries recorded are kept
+	ib_tracing = on;
+}
+
+uint32_t i2c_trace_copy(struct I2C_Trace_Entry* e, uint32_t max){
+	// Copies the newest transactions of the trace, at most 'max', oldest first. Returns the number copied
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint32_t head = ib_trace.head;
+	uint32_t n = (head < I2C_TRACE_SIZE) ? head : I2C_TRACE_SIZE;
+	if(n > max){
+		n = max;
+	}
+	for(uint32_t i=0; i<n; i++){
+		e[i] = ib_trace.entry[(head - n + i) & (I2C_TRACE_SIZE - 1)];
+	}
+	__set_PRIMASK(primask);
+	return n;
+}
+
+const struct I2C_Trace* i2c_trace(void){
+	// The ring itself, to be dumped
+	return &ib_trace;
+}
+
+static void ib_trace_add(const struct I2C_Transfer* t, uint32_t status, uint32_t chained, uint32_t us, uint32_t tries){
+	// Records a transfer as it finishes, over the oldest entry
+	struct I2C_Trace_Entry* e = &ib_trace.entry[ib_trace.head & (I2C_TRACE_SIZE - 1)];
+	uint32_t n = 0;
+
+	e->time_us = micros() - us;
+	e->duration_us = us;
+	e->address = t->address;
+	e->flags = chained ? I2C_CHAIN : 0;
+	e->status = (uint8_t)status;
+	e->tries = (uint8_t)tries;
+	e->write_length = (uint16_t)(t->cmd_length + t->tx_length);
+	e->read_length = t->rx_length;
+	for(uint32_t i=0; i<t->cmd_length && n<I2C_TRACE_BYTES; i++){
+		e->write[n++] = t->cmd[i];
+	}
+	for(uint32_t i=0; i<t->tx_length && n<I2C_TRACE_BYTES; i++){
+		e->write[n++] = t->tx[i];
+	}
+	while(n < I2C_TRACE_BYTES){
+		e->write[n++] = 0;
+	}
+	for(n=0; n<I2C_TRACE_BYTES; n++){
+		e->read[n] = (status == I2C_OK && n < t->rx_length) ? t->rx[n] : 0;
+	}
+	ib_trace.head++;
+}
+
+static void ib_record(uint32_t status, uint32_t chained){
+	// Counts the head transfer as it finishes, with the time it took, and records it in the trace
+	struct I2C_Device_Stats* d = ib_device;
+	uint32_t us = (ib_cycles() - ib_started) / ib_cycles_us;
+	uint32_t bin = 0;
+
+	d->transfers++;
+	if(status == I2C_NACK || status == I2C_NACK_DATA){
+		d->nacks++;
+	}
+	else if(status == I2C_ERROR || status == I2C_TIMEOUT){
+		d->failures++;
+	}
+	if(us > d->max_us){
+		d->max_us = us;
+	}
+	while(bin < I2C_LATENCY_BINS-1 && us >= (uint32_t)I2C_LATENCY_BIN_US << bin){
+		bin++;
+	}
+	d->histogram[bin]++;
+	if(ib_tracing){
+		ib_trace_add(ib_head, status, chained, us, ib_tries + 1);
+	}
+}
+
+static void ib_record_skipped(const struct I2C_Transfer* t, uint32_t status){
+	// Counts and traces a transfer of a chain that is not run after an earlier one failed, as not tried
+	struct I2C_Device_Stats* d = ib_find(t->address);
+
+	d->transfers++;
+	d->failures++;
+	if(ib_tracing){
+		ib_trace_add(t, status, 0, 0, 0);
+	}
+}
+
+static uint32_t ib_release(uint32_t status){
+	// Ends the head transfer on the bus: a repeated START into the next transfer of its chain, or a STOP.
+	// Returns 1 for the repeated START
+	struct I2C_Transfer* t = ib_head;
+
+	if((t->flags & I2C_CHAIN) && t->next && status != I2C_ERROR){
+		LL_I2C_GenerateStartCondition(I2C1); //RE-START for the next transfer
+		return 1;
+	}
+	LL_I2C_GenerateStopCondition(I2C1); //STOP
+	return 0;
+}
+
+static void ib_complete(uint32_t status, uint32_t chained){
+	// Takes the head transfer off its queue, reports it and moves on to the next one: the next of its chain, or
+	// the oldest of the highest class waiting
+	struct I2C_Transfer* t = ib_head;
+	uint32_t c = t->priority;
+
+	LL_I2C_DisableIT_BUF(I2C1);
+	ib_record(status, chained);
+	ib_queue[c] = t->next;
+	t->tries = (uint8_t)(ib_tries + 1);
+	t->status = status;
+	ib_completing = 1;
+	if(t->done){
+		t->done(t);
+	}
+
+	// After a bus error or a timeout the rest of the chain is not run
+	while((status == I2C_ERROR || status == I2C_TIMEOUT) && (t->flags & I2C_CHAIN) && ib_queue[c] == t->next &&
+	      t->next){
+		t = ib_queue[c];
+		ib_queue[c] = t->next;
+		ib_record_skipped(t, status);
+		t->tries = 0;
+		t->status = status;
+		if(t->done){
+			t->done(t);
+		}
+	}
+	ib_completing = 0;
+
+	ib_head = chained ? ib_queue[c] : ib_next();
+	if(!ib_head){
+		LL_I2C_DisableIT_EVT(I2C1);
+		LL_I2C_DisableIT_ERR(I2C1);
+		ib_state = IB_IDLE;
+	}
+	else if(chained){
+		ib_begin();
+		ib_deadline = ib_started + ib_budget(ib_head);
+		ib_state = IB_START; // The repeated START is on its way
+	}
+	else{
+		ib_start();
+	}
+}
+
+static void ib_end(uint32_t status){
+	// Releases the bus and completes the head transfer
+	ib_complete(status, ib_release(status));
+}
+
+static void ib_read(struct I2C_Transfer* t){
+	// ADDR of the read is set: starts the reception (ADDR is cleared last, the ACK, DMA and LAST settings have to
+	// be in place before the first byte comes in)
+	if(t->rx_length == 1){
+		LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_NACK); //NACK THE ONLY BYTE
+		LL_I2C_ClearFlag_ADDR(I2C1);
+		ib_chained = ib_release(I2C_OK); // STOP (or RE-START) once it has been received
+		ib_state = IB_READ_BYTE;
+		LL_I2C_EnableIT_BUF(I2C1);
+		return;
+	}
+	LL_DMA_ClearFlag_TC0(DMA1);
+	LL_DMA_ClearFlag_HT0(DMA1);
+	LL_DMA_ClearFlag_TE0(DMA1);
+	LL_DMA_ClearFlag_FE0(DMA1);
+	LL_DMA_ClearFlag_DME0(DMA1);
+	LL_DMA_SetMemoryAddress(DMA1, LL_DMA_STREAM_0, (uint32_t)t->rx);
+	LL_DMA_SetDataLength(DMA1, LL_DMA_STREAM_0, t->rx_length);
+	LL_DMA_EnableStream(DMA1, LL_DMA_STREAM_0);
+
+	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK); //ACK INCOMING DATA
+	LL_I2C_EnableDMAReq_RX(I2C1);
+	LL_I2C_EnableLastDMA(I2C1);
+	ib_state = IB_READ_DMA;
+	LL_I2C_ClearFlag_ADDR(I2C1);
+}
+
+void I2C1_EV_IRQHandler(void){
+	struct I2C_Transfer* t = ib_head;
+	uint32_t writes;
+
+	if(!t){
+		return;
+	}
+	writes = t->cmd_length + t->tx_length;
+	switch(ib_state){
+		case IB_START:
+			if(LL_I2C_IsActiveFlag_SB(I2C1)){
+				if(writes || t->rx_length == 0){
+					LL_I2C_TransmitData8(I2C1, t->address); //CONTROL BYTE (ADDRESS + WRITE)
+					ib_state = IB_ADDRESS_W;
+				}
+				else{
+					LL_I2C_TransmitData8(I2C1, t->address+1); //ADDRESS + READ, nothing to write first
+					ib_state = IB_ADDRESS_R;
+				}
+			}
+			break;
+
+		case IB_ADDRESS_W:
+			if(LL_I2C_IsActiveFlag_ADDR(I2C1)){
+				t->acked_us = micros();
+				LL_I2C_ClearFlag_ADDR(I2C1);
+				if(writes == 0){
+					ib_end(I2C_OK); // Address only
+					break;
+				}
+				ib_index = 0;
+				ib_state = IB_WRITE;
+				LL_I2C_EnableIT_BUF(I2C1);
+			}
+			break;
+
+		case IB_WRITE:
+			if(LL_I2C_IsActiveFlag_TXE(I2C1)){
+				if(ib_index < t->cmd_length){
+					LL_I2C_TransmitData8(I2C1, t->cmd[ib_index]);
+				}
+				else{
+					LL_I2C_TransmitData8(I2C1, t->tx[ib_index - t->cmd_length]);
+				}
+				ib_index++;
+				if(ib_index == writes){
+					LL_I2C_DisableIT_BUF(I2C1); // Next event is BTF once the last byte has gone
+					ib_state = IB_BTF;
+				}
+			}
+			break;
+
+		case IB_BTF:
+			if(LL_I2C_IsActiveFlag_BTF(I2C1)){
+				if(t->rx_length){
+					LL_I2C_GenerateStartCondition(I2C1); //RE-START (clears BTF)
+					ib_state = IB_RESTART;
+				}
+				else{
+					ib_end(I2C_OK);
+				}
+			}
+			break;
+
+		case IB_RESTART:
+			if(LL_I2C_IsActiveFlag_SB(I2C1)){
+				LL_I2C_TransmitData8(I2C1, t->address+1); //ADDRESS + READ
+				ib_state = IB_ADDRESS_R;
+			}
+			break;
+
+		case IB_ADDRESS_R:
+			if(LL_I2C_IsActiveFlag_ADDR(I2C1)){
+				if(!t->acked_us){
+					t->acked_us = micros();
+				}
+				ib_read(t);
+			}
+			break;
+
+		case IB_READ_BYTE:
+			if(LL_I2C_IsActiveFlag_RXNE(I2C1)){
+				t->rx[0] = LL_I2C_ReceiveData8(I2C1);
+				LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK);
+				ib_complete(I2C_OK, ib_chained);
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+void I2C1_ER_IRQHandler(void){
+	uint32_t status = I2C_ERROR;
+
+	if(LL_I2C_IsActiveFlag_AF(I2C1) && !LL_I2C_IsActiveFlag_BERR(I2C1) && !LL_I2C_IsActiveFlag_ARLO(I2C1)){
+		status = (ib_state == IB_ADDRESS_W || ib_state == IB_ADDRESS_R) ? I2C_NACK : I2C_NACK_DATA;
+	}
+	LL_I2C_ClearFlag_AF(I2C1);
+	LL_I2C_ClearFlag_BERR(I2C1);
+	LL_I2C_ClearFlag_ARLO(I2C1);
+	LL_I2C_ClearFlag_OVR(I2C1);
+	if(!ib_head || ib_state == IB_IDLE){
+		return;
+	}
+
+	if(status == I2C_ERROR){
+		ib_retry(I2C_ERROR); // A glitch or a device out of step, the bus is recovered
+		return;
+	}
+	LL_I2C_AcknowledgeNextData(I2C1, LL_I2C_ACK);
+	if(ib_state == IB_READ_BYTE){
+		ib_complete(status, 0); // The STOP has already been requested
+		return;
+	}
+	if(ib_state == IB_READ_DMA){
+		LL_DMA_DisableStream(DMA1, LL_DMA_STREAM_0);
+		LL_I2C_DisableDMAReq_RX(I2C1);
+		LL_I2C_DisableLastDMA(I2C1);
+	}
+	ib_end(status);
+}
+
+void DMA1_Stream0_IRQHandler(void){
+	uint32_t error = 0;
+
+	if(LL_DMA_IsActiveFlag_TC0(DMA1)){
+		LL_DMA_ClearFlag_TC0(DMA1);
+	}
+	else if(LL_DMA_IsActiveFlag_TE0(DMA1)){
+		LL_DMA_ClearFlag_TE0(DMA1);
+		LL_DMA_DisableStream(DMA1, LL_DMA_STREAM_0);
+		error = 1;
+	}
+	else{
+		return;
+	}
+	if(ib_state != IB_READ_DMA){
+		return;
+	}
+	if(error){
+		ib_retry(I2C_ERROR);
+		return;
+	}
+
+	// The last byte has been NACKed by the peripheral
+	LL_I2C_DisableDMAReq_RX(I2C1);
+	LL_I2C_DisableLastDMA(I2C1);
+	ib_end(I2C_OK);
+}
@@ -0,0 +1,29 @@
+#ifndef __ALARM_H
+#define __ALARM_H
+
+#include <stdint.h>
+
+#define ALARM_RING_SIZE 16 // Crossings waiting for the main loop, must be a power of 2
+
+// One change of the OS line
+struct Alarm_Event {
+	uint32_t time_us; // micros() in the EXTI interrupt
+	uint8_t active; // 1: went above Tos, 0: fell below Thyst
+};
+
+// Counters, only written by alarm_configure and the interrupt
+struct Alarm_Stats {
+	uint32_t raised; // Crossings above Tos
+	uint32_t cleared; // Crossings back below Thyst
+	uint32_t overruns; // Crossings dropped because the ring was full
+	uint32_t errors; // Sensors that did not acknowledge the threshold writes
+};
+
+// 			 Alarm Functions
+uint32_t alarm_configure(int16_t tos, int16_t thyst);
+uint32_t alarm_active(void);
+uint32_t alarm_read(struct Alarm_Event* e);
+const struct Alarm_Stats* alarm_stats(void);
+void     EXTI15_10_IRQHandler(void);
+
+#endif /* __ALARM_H */
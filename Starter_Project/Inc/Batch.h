@@ -0,0 +1,45 @@
+#ifndef __BATCH_H
+#define __BATCH_H
+
+#include <stdint.h>
+
+#include "Packet.h"
+#include "Journal.h"
+
+// Layout of a batch in pl (multi-byte fields most significant byte first). The journal sequence number after it
+// is left alone
+#define BATCH_HEADER_OFFSET 0 // Format (bits 7-6), then the sample count (raw) or the delta width (delta)
+#define BATCH_TIME_OFFSET 1 // micros() when the first sample was added (4 bytes)
+#define BATCH_SPAN_OFFSET 5 // ms from the first to the last sample (2 bytes)
+#define BATCH_DATA_OFFSET 7 // Raw: samples, packed most significant bit first
+#define BATCH_DATA_BYTES (JOURNAL_SEQ_OFFSET - BATCH_DATA_OFFSET)
+#define BATCH_DELTA_COUNT_OFFSET 7 // Delta: sample count
+#define BATCH_DELTA_DATA_OFFSET 8 // Delta: first sample, then the zigzag deltas, packed most significant bit first
+#define BATCH_DELTA_BITS ((JOURNAL_SEQ_OFFSET - BATCH_DELTA_DATA_OFFSET) * 8)
+#define BATCH_SENSOR_OFFSET 41 // Tagged batches: the sensor's I2C address, the data ends before it
+
+#define BATCH_FORMAT_MASK 0xC0
+#define BATCH_FORMAT_RAW 0x40 // BATCH_SAMPLE_BITS bits per sample
+#define BATCH_FORMAT_DELTA 0x80 // Change from the previous sample, zigzag mapped, in a width set per packet
+#define BATCH_SENSOR_FLAG 0x20 // The batch is tagged with the sensor it came from
+#define BATCH_COUNT_MASK 0x1F // Raw: sample count
+#define BATCH_WIDTH_MASK 0x0F // Delta: bits per delta
+
+#define BATCH_SAMPLE_BITS 11 // Samples are the 11-bit LM75 reading (0.125 degree steps)
+#define BATCH_MAX_SAMPLES (BATCH_DATA_BYTES * 8 / BATCH_SAMPLE_BITS) // Raw: 25
+#define BATCH_DELTA_MAX_SAMPLES 255 // Delta: limited by the count byte (reached when every delta is 0 or +-1)
+
+// 			 Batch Functions
+void     batch_clear(struct Pack* pkt, uint32_t format);
+uint32_t batch_add(struct Pack* pkt, uint16_t sample, uint32_t time_us);
+uint32_t batch_full(const struct Pack* pkt);
+uint32_t batch_format(const struct Pack* pkt);
+uint32_t batch_count(const struct Pack* pkt);
+void     batch_set_sensor(struct Pack* pkt, uint32_t address);
+uint32_t batch_sensor(const struct Pack* pkt);
+uint16_t batch_sample(const struct Pack* pkt, uint32_t index);
+uint32_t batch_decode(const struct Pack* pkt, uint16_t* samples);
+uint32_t batch_time(const struct Pack* pkt);
+uint16_t batch_span_ms(const struct Pack* pkt);
+
+#endif /* __BATCH_H */
@@ -0,0 +1,18 @@
+#ifndef __CRC_ENGINE_H
+#define __CRC_ENGINE_H
+
+#include <stdint.h>
+
+// 			 CRC Engine (DMA2 Stream 0 memory-to-memory into CRC->DR)
+#define CRC_ENGINE_ERROR 1 // DMA transfer error, the CRC is not valid
+typedef void (*crc_callback_t)(uint32_t crc, int error); // 'error' is 0 or CRC_ENGINE_ERROR
+
+void     crc_engine_configure(void);
+void     crc_engine_start(const uint32_t* words, uint32_t count, crc_callback_t callback);
+uint32_t crc_engine_busy(void);
+int      crc_engine_result(uint32_t* crc);
+int      crc_engine_wait(uint32_t* crc);
+uint32_t crc_engine_feed(const uint32_t* words, uint32_t count);
+void     DMA2_Stream0_IRQHandler(void);
+
+#endif /* __CRC_ENGINE_H */
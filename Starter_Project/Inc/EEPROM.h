@@ -0,0 +1,56 @@
+#ifndef __EEPROM_H
+#define __EEPROM_H
+
+#include <stdint.h>
+
+// EEPROM I2C Address
+#define EEPROMADR 0xA0
+
+// EEPROM size and page size (24LC64)
+#define EEPROM_SIZE 8192
+#define EEPROM_PAGE_SIZE 32
+
+// Bytes read per transfer: a sensor read waits for one chunk at most (1.6 ms at 400 kHz), each chunk costs the
+// address again (4 bytes)
+#define EEPROM_READ_CHUNK 64
+
+// Errors of a write or read (0 on success)
+#define EEPROM_ERROR   1 // Not acknowledged, or a bus error that the I2C1 retries did not get past
+#define EEPROM_TIMEOUT 2 // The write cycle did not end in time, or the bus stayed held (I2C_TIMEOUT)
+
+// Internal write cycle timing: a cycle longer than the timeout is an error (the datasheet maximum is 5 ms)
+#define EEPROM_WRITE_TIMEOUT_US 20000
+#define EEPROM_HIST_BINS 40 // Histogram of write cycle times
+#define EEPROM_HIST_BIN_US 250 // Width of each bin, the last bin also counts longer cycles
+
+// Measured write cycle times, used to choose when to poll
+struct EEPROM_Stats {
+	uint32_t cycles; // Write cycles measured
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t total_us; // Sum of all measured cycle times (mean = total_us / cycles)
+	uint32_t polls; // Polls that were not acknowledged (EEPROM still busy)
+	uint32_t timeouts; // Write cycles longer than EEPROM_WRITE_TIMEOUT_US
+	uint32_t histogram[EEPROM_HIST_BINS];
+	uint32_t first_poll_us; // Current delay from the end of a page write to the first poll
+	uint32_t poll_interval_us; // Current delay between polls
+};
+
+// Called from the interrupt when an asynchronous write or read has finished (error is 0 on success)
+typedef void (*eeprom_callback_t)(int error);
+
+// 			 EEPROM Functions
+void     eeprom_configure(void);
+void     eeprom_write_async(uint16_t address, const unsigned char* data, uint16_t length, eeprom_callback_t callback);
+uint32_t eeprom_async_busy(void);
+int      eeprom_async_wait(void);
+int      eeprom_write(uint16_t address, const unsigned char* data, uint16_t length);
+int      eeprom_wait_ready(void);
+int      eeprom_read(uint16_t address, unsigned char* data, uint16_t length);
+void     eeprom_read_async(uint16_t address, unsigned char* data, uint16_t length, eeprom_callback_t callback);
+const struct EEPROM_Stats* eeprom_stats(void);
+uint32_t eeprom_stats_mean_us(void);
+void     eeprom_stats_reset(void);
+void     TIM5_IRQHandler(void);
+
+#endif /* __EEPROM_H */
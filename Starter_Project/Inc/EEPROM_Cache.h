@@ -0,0 +1,43 @@
+#ifndef __EEPROM_CACHE_H
+#define __EEPROM_CACHE_H
+
+#include <stdint.h>
+
+#include "Journal.h"
+
+#define EEPROM_CACHE_LINES 8 // Pages held in RAM
+#define EEPROM_CACHE_PAGE_SIZE 32 // Must be the EEPROM page size
+
+// One cached EEPROM page
+struct EEPROM_Cache_Line {
+	uint16_t page; // EEPROM page number (address / EEPROM_CACHE_PAGE_SIZE)
+	uint8_t valid;
+	uint8_t dirty; // Changed since it was last written to the EEPROM
+	uint32_t used; // When the line was last used, for least recently used replacement
+	uint32_t dirty_since; // Time (as given to eeprom_cache_poll) the line became dirty
+	unsigned char data[EEPROM_CACHE_PAGE_SIZE];
+};
+
+// Write-back cache in front of the EEPROM
+struct EEPROM_Cache {
+	const struct EEPROM_Ops* eeprom;
+	struct EEPROM_Cache_Line lines[EEPROM_CACHE_LINES];
+	uint32_t use_count; // Counter for 'used'
+	uint32_t now; // Last time given to eeprom_cache_poll
+	struct EEPROM_Cache_Line* in_flight; // Flushed line the EEPROM driver may still be writing (0 if none)
+	int error; // First write back error not yet returned (0 if none)
+	uint32_t hits; // Reads served and writes merged entirely from RAM
+	uint32_t misses; // Reads that went to the EEPROM and writes that needed a new line
+	uint32_t merged; // Writes to a page that was already dirty (saved page write cycles)
+	uint32_t flushes; // Page write cycles issued
+};
+
+// 			 EEPROM Cache Functions
+void     eeprom_cache_init(struct EEPROM_Cache* c, const struct EEPROM_Ops* eeprom);
+int      eeprom_cache_write(struct EEPROM_Cache* c, uint16_t address, const unsigned char* data, uint16_t length);
+int      eeprom_cache_read(struct EEPROM_Cache* c, uint16_t address, unsigned char* data, uint16_t length);
+int      eeprom_cache_wait(struct EEPROM_Cache* c);
+int      eeprom_cache_flush(struct EEPROM_Cache* c);
+int      eeprom_cache_poll(struct EEPROM_Cache* c, uint32_t now, uint32_t max_age);
+
+#endif /* __EEPROM_CACHE_H */
@@ -0,0 +1,39 @@
+#ifndef __FILTER_H
+#define __FILTER_H
+
+#include <stdint.h>
+
+// Filter types
+#define FILTER_NONE   0 // Samples pass through
+#define FILTER_BOXCAR 1 // Mean of the last 2^param samples (param 0-5)
+#define FILTER_EMA    2 // Exponential moving average, y += alpha * (x - y) with alpha = param / 32768 (1-32767)
+#define FILTER_MEDIAN 3 // Median of the last param samples (odd, 1-FILTER_MEDIAN_MAX)
+
+#define FILTER_HISTORY 32 // Input samples kept, power of 2 (the longest boxcar)
+#define FILTER_BOXCAR_MAX_SHIFT 5
+#define FILTER_MEDIAN_MAX 9
+#define FILTER_EMA_FRAC 4 // Extra fraction bits kept in the EMA state
+
+// Samples are signed Q7.3 (the LM75 reading: 0.125 degree steps), the 11-bit LM75 value sign extended
+#define FILTER_FROM_LM75(v) ((int16_t)((uint16_t)(v) << 5) >> 5)
+#define FILTER_TO_LM75(x) ((uint16_t)(x) & 0x7FF)
+
+// State of one filter
+struct Filter {
+	uint32_t type;
+	uint32_t param;
+	uint32_t length; // Samples in the window (boxcar, median)
+	uint32_t index; // Where the next sample goes in history
+	uint32_t primed; // The history has been filled with the first sample
+	int32_t  sum; // Boxcar: sum of the window
+	int32_t  ema; // EMA: state, Q7.(3 + FILTER_EMA_FRAC)
+	int16_t  history[FILTER_HISTORY * 2]; // Every sample is stored twice, FILTER_HISTORY apart, so a window is
+	                                      // always contiguous
+};
+
+// 			 Filter Functions
+void     filter_init(struct Filter* f, uint32_t type, uint32_t param);
+void     filter_block(struct Filter* f, const int16_t* in, int16_t* out, uint32_t n);
+int16_t  filter_sample(struct Filter* f, int16_t x);
+
+#endif /* __FILTER_H */
@@ -0,0 +1,15 @@
+#ifndef __FORMAT_H
+#define __FORMAT_H
+
+#include <stdint.h>
+
+#define FORMAT_TEMPERATURE_MAX 9 // Longest temperature, "-128.000" and the terminator
+#define FORMAT_HEX_MAX 9 // Longest 32-bit hex value and the terminator
+#define FORMAT_UINT_MAX 11 // Longest 32-bit decimal value and the terminator
+
+// 			 Format Functions
+uint32_t format_temperature(char* buf, uint16_t sample);
+uint32_t format_hex(char* buf, uint32_t value);
+uint32_t format_uint(char* buf, uint32_t value);
+
+#endif /* __FORMAT_H */
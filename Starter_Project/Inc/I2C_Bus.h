@@ -0,0 +1,144 @@
+#ifndef __I2C_BUS_H
+#define __I2C_BUS_H
+
+#include <stdint.h>
+
+// Bus speeds, SCL in Hz. I2C1 of the STM32F401 has standard and fast mode only (no Fast-mode Plus), and the LM75
+// and the 24LC64 stop at 400 kHz as well
+#define I2C_SPEED_STANDARD 100000
+#define I2C_SPEED_FAST     400000
+#define I2C_SPEED_MAX      I2C_SPEED_FAST
+// Slowest speed the deadlines and byte timeouts have been checked at (EEPROM_Bench runs each speed from here up).
+// The divider is not the limit: its 12 bits would go down to about 5 kHz from the 42 MHz APB1 clock
+#define I2C_SPEED_MIN      20000
+
+#define I2C_CMD_MAX 4 // Bytes a transfer can carry in cmd (register pointer or memory address, short values)
+
+// Status of a transfer
+#define I2C_PENDING   0 // Queued or on the bus
+#define I2C_OK        1
+#define I2C_NACK      2 // The address was not acknowledged (no device there, or it is busy)
+#define I2C_NACK_DATA 3 // A byte written was not acknowledged
+#define I2C_ERROR     4 // Bus error, lost arbitration or DMA error on every try (the rest of its chain is not run)
+#define I2C_TIMEOUT   5 // Missed its deadline on every try (the rest of its chain is not run)
+
+// Deadlines and recovery: a transfer has I2C_TIMEOUT_US, plus I2C_TIMEOUT_BYTE_US at the bus speed for each byte,
+// from its START to its end. One that misses it, or meets a bus error, has the bus recovered and is run again up
+// to I2C_RETRIES times. A missed deadline is only noticed by i2c_poll, so a held bus goes unnoticed for as long as
+// nothing calls it
+#define I2C_TIMEOUT_US      1000
+#define I2C_STRETCH_BYTE_US 50 // Clock stretching allowed for each byte
+#define I2C_TIMEOUT_BYTE_US(hz) (18000000 / (hz) + I2C_STRETCH_BYTE_US) // Twice the 9 bit times, and stretching
+#define I2C_STOP_TIMEOUT_US 100 // Wait for the previous STOP to go out before a START
+#define I2C_RETRIES         2
+#define I2C_RECOVERY_CLOCKS 9 // SCL pulses at most to make a device let go of SDA
+
+// Per-device counters
+#define I2C_DEVICES 12 // Addresses counted separately, the last entry counts any others (its address is 0)
+#define I2C_LATENCY_BINS 8 // Histogram of transfer times: bin 0 is under I2C_LATENCY_BIN_US, each bin doubles
+#define I2C_LATENCY_BIN_US 128 // and the last one counts everything longer
+
+// Trace of the transactions on the bus (i2c_trace)
+#define I2C_TRACE_SIZE  128 // Transactions kept (the newest), must be a power of 2
+#define I2C_TRACE_BYTES 4 // Bytes kept of the start of the write and of the read
+#define I2C_TRACE_MAGIC 0x54433249 // "I2CT" in memory, finds the ring in a RAM dump
+
+// Flags
+#define I2C_CHAIN 0x01 // The next transfer of the same i2c_submit follows with a repeated START instead of a STOP
+
+// Priority classes, a waiting transfer of a higher class goes on the bus first
+#define I2C_PRIORITY_HIGH   0 // Sensor reads (time critical)
+#define I2C_PRIORITY_NORMAL 1 // Sensor set up, probes
+#define I2C_PRIORITY_LOW    2 // EEPROM page writes, polls and reads
+#define I2C_PRIORITIES      3
+
+struct I2C_Transfer;
+typedef void (*i2c_callback_t)(struct I2C_Transfer* t);
+
+// One transaction on I2C1: START, address, cmd and tx written, then a repeated START, address and rx read, STOP.
+// Either part may be left out; with neither the device is only addressed (a probe or an acknowledge poll)
+struct I2C_Transfer {
+	uint8_t address; // 8-bit address, R/W bit clear
+	uint8_t flags;
+	uint8_t priority; // I2C_PRIORITY_HIGH, NORMAL or LOW (of the first transfer, for all of an i2c_submit)
+	uint8_t cmd_length;
+	uint8_t cmd[I2C_CMD_MAX]; // Written first, from the transfer itself
+	const unsigned char* tx; // Written after cmd
+	uint16_t tx_length;
+	uint16_t rx_length; // 2 bytes or more are moved by DMA (static buffers only on a host)
+	unsigned char* rx;
+	i2c_callback_t done; // Called from the interrupt once the transfer has finished, 0 for none
+	void* context; // For the callback
+	volatile uint32_t status;
+	uint8_t tries; // Times it was run, set as it finishes: more than 1 after a bus recovery, 0 if it was not run
+	uint32_t acked_us; // micros() when the address was acknowledged
+	uint32_t queued; // Cycle count at i2c_submit
+	struct I2C_Transfer* next; // Queue link (i2c_submit)
+};
+
+// Counters of one device (address), only written by the engine
+struct I2C_Device_Stats {
+	uint8_t address;
+	uint32_t transfers; // Transfers finished, with any status
+	uint32_t nacks; // Finished with I2C_NACK or I2C_NACK_DATA
+	uint32_t failures; // Finished with I2C_ERROR or I2C_TIMEOUT (after the retries, or not run after its chain failed)
+	uint32_t timeouts; // Deadlines missed
+	uint32_t bus_errors; // Bus errors, lost arbitration and DMA errors
+	uint32_t retries; // Transfers run again after a timeout or a bus error
+	uint32_t recoveries; // Bus recoveries (SCL clocked, STOP, I2C1 reset)
+	uint32_t recovery_max_us; // Longest recovery
+	uint32_t max_us; // Longest transfer, from its first START to its end, including retries
+	uint32_t histogram[I2C_LATENCY_BINS]; // Transfer times
+};
+
+// Queueing delay of a priority class (i2c_submit to the transfer's START), only written by the engine
+struct I2C_Class_Stats {
+	uint32_t transfers; // Transfers started
+	uint32_t total_us; // Sum of the delays (mean = total_us / transfers)
+	uint32_t max_us;
+	uint32_t histogram[I2C_LATENCY_BINS]; // Delays, in the bins of the transfer times
+};
+
+// One transaction as it finished. Fixed width fields only, so the ring has the same layout on the board and on a
+// host reading a dump of it
+struct I2C_Trace_Entry {
+	uint32_t time_us; // micros() at the first START
+	uint32_t duration_us; // First START to the end, including the retries
+	uint8_t address; // 8-bit address, R/W bit clear
+	uint8_t flags; // I2C_CHAIN if it ended with a repeated START into the next transfer instead of a STOP
+	uint8_t status; // I2C_OK, I2C_NACK (address not acknowledged), I2C_NACK_DATA, I2C_ERROR or I2C_TIMEOUT
+	uint8_t tries; // Times it was run, more than 1 after a timeout or a bus error, 0 if not run after its chain failed
+	uint16_t write_length; // Bytes written (cmd and tx), 0 for no write
+	uint16_t read_length; // Bytes read (rx), 0 for no read
+	uint8_t write[I2C_TRACE_BYTES]; // First bytes written
+	uint8_t read[I2C_TRACE_BYTES]; // First bytes read, 0 unless the transfer ended with I2C_OK
+};
+
+// Ring of the newest transactions, written by the engine over the oldest
+struct I2C_Trace {
+	uint32_t magic; // I2C_TRACE_MAGIC
+	uint32_t size; // I2C_TRACE_SIZE
+	volatile uint32_t head; // Transactions recorded, the newest is entry[(head - 1) % size]
+	uint32_t speed; // SCL frequency (i2c_bus_set_speed)
+	struct I2C_Trace_Entry entry[I2C_TRACE_SIZE];
+};
+
+// 			 I2C Bus Functions
+void     i2c_bus_configure(void);
+uint32_t i2c_bus_set_speed(uint32_t hz);
+uint32_t i2c_bus_speed(void);
+void     i2c_submit(struct I2C_Transfer* t, uint32_t n);
+uint32_t i2c_wait(const struct I2C_Transfer* t);
+uint32_t i2c_busy(void);
+uint32_t i2c_poll(void);
+const struct I2C_Device_Stats* i2c_device_stats(uint8_t address);
+const struct I2C_Class_Stats* i2c_class_stats(uint32_t priority);
+void     i2c_stats_reset(void);
+void     i2c_trace_enable(uint32_t on);
+uint32_t i2c_trace_copy(struct I2C_Trace_Entry* e, uint32_t max);
+const struct I2C_Trace* i2c_trace(void);
+void     I2C1_EV_IRQHandler(void);
+void     I2C1_ER_IRQHandler(void);
+void     DMA1_Stream0_IRQHandler(void);
+
+#endif /* __I2C_BUS_H */
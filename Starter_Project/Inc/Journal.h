@@ -0,0 +1,40 @@
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+
+#include <stdint.h>
+
+#include "Packet.h"
+
+// The last two bytes of pl in a journal record hold its sequence number (most significant byte first)
+#define JOURNAL_SEQ_OFFSET 42
+
+// Access to the EEPROM the journal is stored in (the EEPROM driver on the board, a RAM image on a host). Each one
+// returns 0 on success or the driver's error (a write that returns early has its error returned by the wait)
+struct EEPROM_Ops {
+	int (*write)(uint16_t address, const unsigned char* data, uint16_t length);
+	int (*read)(uint16_t address, unsigned char* data, uint16_t length);
+	int (*wait)(void); // Waits for a write that returned early to finish (0 if writes finish before returning)
+	uint32_t (*busy)(void); // 1 while a write that returned early is still running (0 if not given: wait is used)
+};
+
+// Circular journal of PACKET_SIZE byte records, slot n is at EEPROM address n*PACKET_SIZE
+struct Journal {
+	const struct EEPROM_Ops* eeprom;
+	fcs_function_t fcs; // Used to recalculate the FCS after the sequence number is stamped in
+	uint32_t fcs_mode;
+	uint16_t slots; // Number of record slots
+	uint16_t head; // Slot the next record goes to
+	uint16_t count; // Number of records, the oldest (tail) is 'count' slots behind the head
+	uint16_t next_seq; // Sequence number of the next record
+	int error; // First EEPROM error met by the last journal call (0 if none)
+	unsigned char record[PACKET_SIZE]; // Record being written (the EEPROM may still be reading it after journal_append returns)
+};
+
+// 			 Journal Functions
+void     journal_mount(struct Journal* j, const struct EEPROM_Ops* eeprom, uint16_t slots, fcs_function_t fcs, uint32_t fcs_mode);
+uint16_t journal_append(struct Journal* j, const struct Pack* pkt);
+uint16_t journal_read_last(struct Journal* j, struct Pack* pkts, uint16_t n);
+uint16_t journal_read_block(struct Journal* j, unsigned char* bytes, uint16_t n);
+uint16_t journal_sequence(const struct Pack* pkt);
+
+#endif /* __JOURNAL_H */
@@ -11,6 +11,8 @@ void     InstructionOrData(char);
 void     Write_Data_To_LCD(unsigned char data);
 void     Write_Command_To_LCD(unsigned char command);
 void     Copy_Data_Buffer_To_LCD(void);
+void     Flush_LCD(void);
+void     Defer_LCD_Flush(int on);
 void     Fill_Page(unsigned char);
 void     Write_Test_Character(unsigned char l0, unsigned char l1,unsigned char l2,unsigned char l3,unsigned char l4,unsigned char l5,unsigned char l6,unsigned char l7);
 void     pixel(int x,int y, int colour);
@@ -0,0 +1,51 @@
+#ifndef __PACKET_H
+#define __PACKET_H
+
+#include <stdint.h>
+
+// Size of the packet as stored in EEPROM (MAC dest, MAC src, Length, Payload, FCS)
+#define PACKET_SIZE 64
+#define PACKET_FCS_OFFSET 60 // The FCS covers the bytes before it
+
+// FCS formats (the version of the word stream fed to the CRC unit)
+#define FCS_MODE_LEGACY 0 // v0: every byte (and the length and sample fields) widened to its own word, 58 words
+#define FCS_MODE_PACKED 1 // v1: bytes 0-59 of the serialised packet packed big-endian into 15 words
+#define FCS_WORDS_MAX 58
+
+// payload.sample holds the 11-bit reading, and a flag for packets filled while the over-temperature alarm was on
+#define PACKET_SAMPLE_MASK 0x07FF
+#define PACKET_ALARM_FLAG 0x8000
+
+// Payload structure (46 byte field)
+struct P {
+	uint16_t sample; // 2 bytes
+	unsigned char pl[44]; // 44 bytes
+}; 
+
+// Packet structure (the members of the structure are the fields of the packet)
+struct Pack {
+	unsigned char MAC_dest[6]; // 6 byte field
+	unsigned char MAC_src[6]; // 6 byte field
+	uint16_t length; //2 byte field
+	struct P payload; // 46 byte field
+	uint32_t FCS; //4 byte field
+};
+
+// Cached FCS state for a packet where only payload.sample changes
+struct FCS_Cache {
+	uint32_t mode; // FCS format the cache was primed for
+	uint32_t base; // FCS with sample = 0 (all the constant fields before and after the sample)
+	uint32_t basis[16]; // Change in the FCS caused by each bit of the sample
+};
+
+// Function that calculates the FCS of a packet in a given format (calculate_CRC_mode on the board)
+typedef uint32_t (*fcs_function_t)(struct Pack pkt, uint32_t mode);
+
+// 			 Packet Functions
+void     packet_serialise(const struct Pack* pkt, unsigned char* bytes);
+void     packet_parse(const unsigned char* bytes, struct Pack* pkt);
+uint32_t packet_fcs_words(const struct Pack* pkt, uint32_t mode, uint32_t* words);
+void     fcs_cache_prime(struct FCS_Cache* cache, const struct Pack* pkt, uint32_t mode, fcs_function_t fcs);
+uint32_t fcs_cache_update(const struct FCS_Cache* cache, uint16_t sample);
+
+#endif /* __PACKET_H */
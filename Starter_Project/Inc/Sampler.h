@@ -0,0 +1,45 @@
+#ifndef __SAMPLER_H
+#define __SAMPLER_H
+
+#include <stdint.h>
+
+// Temperature Sensor I2C Address (the shield's LM75), and the last address an LM75 can be set to
+#define TEMPADR 0x90
+#define TEMPADR_LAST 0x9E
+
+#define SAMPLER_MAX_SENSORS 8
+
+#define SAMPLER_RING_SIZE 32 // Samples waiting for the main loop, must be a power of 2
+
+// One temperature reading
+struct Sample {
+	uint32_t time_us; // micros() at the timer update that started the read
+	uint16_t value; // 11-bit LM75 reading (0.125 degree steps)
+	uint8_t sensor; // Index of the sensor (sampler_sensor_address)
+};
+
+// Counters, only written by the interrupts
+struct Sampler_Stats {
+	uint32_t samples; // Sensor reads completed
+	uint32_t missed; // Timer updates that came while the previous sweep was still waiting or running
+	uint32_t overruns; // Samples dropped because the ring was full (the main loop is not keeping up)
+	uint32_t errors; // Sensor reads ended by a bus error or a NACK
+	uint32_t pointer_writes; // Reads that set the pointer register first (the rest were fast reads)
+};
+
+// 			 Sampler Functions
+void     sampler_configure(uint32_t period_us);
+uint32_t sampler_scan(void);
+uint32_t sampler_sensors(void);
+uint32_t sampler_sensor_address(uint32_t sensor);
+void     sampler_set_period(uint32_t period_us);
+void     sampler_start(void);
+void     sampler_stop(void);
+void     sampler_set_fast(uint32_t on);
+void     sampler_pointer_moved(void);
+uint32_t sampler_read(struct Sample* s);
+uint32_t sampler_pending(void);
+const struct Sampler_Stats* sampler_stats(void);
+void     TIM2_IRQHandler(void);
+
+#endif /* __SAMPLER_H */
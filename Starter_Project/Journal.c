@@ -0,0 +1,148 @@
+#include "Journal.h"
+
+/*
+Journal
+Stores packets one after the other across the whole EEPROM instead of always at address 0. When the last slot
+is used it wraps around and overwrites the oldest record.
+Every record carries a 16-bit sequence number in the last two bytes of pl (the FCS is recalculated to cover it),
+so after a reset journal_mount finds the newest record by scanning the slots once. From then on the head and the
+number of records are kept in RAM and appending is a single record write.
+A slot whose FCS does not check (never written, or a write cut short by a reset) is not a record, nor is one that
+cannot be read. Each call leaves the first EEPROM error it met in j->error (0 if none), a mount that met one may
+have missed records.
+Nothing in here touches the hardware, so the same file can be built against an EEPROM image on a host.
+*/
+
+uint16_t journal_sequence(const struct Pack* pkt){
+	// Returns the sequence number of a record read from the journal
+	return (uint16_t)((pkt->payload.pl[JOURNAL_SEQ_OFFSET] << 8) | pkt->payload.pl[JOURNAL_SEQ_OFFSET+1]);
+}
+
+static void note_error(struct Journal* j, int error){
+	// Keeps the first error of the call
+	if(error && !j->error){
+		j->error = error;
+	}
+}
+
+static int slot_read(struct Journal* j, uint16_t slot, struct Pack* pkt){
+	// Reads a slot, returns 1 if it holds a record
+	unsigned char bytes[PACKET_SIZE];
+	int error = j->eeprom->read((uint16_t)(slot * PACKET_SIZE), bytes, PACKET_SIZE);
+	
+	note_error(j, error);
+	if(error){
+		return 0;
+	}
+	packet_parse(bytes, pkt);
+	return j->fcs(*pkt, j->fcs_mode) == pkt->FCS;
+}
+
+void journal_mount(struct Journal* j, const struct EEPROM_Ops* eeprom, uint16_t slots, fcs_function_t fcs, uint32_t fcs_mode){
+	// Finds the newest record and how many records follow on from each other before it
+	struct Pack pkt;
+	int newest = -1; // Slot of the newest record
+	uint16_t newest_seq = 0; // Its sequence number
+	
+	j->eeprom = eeprom;
+	j->fcs = fcs;
+	j->fcs_mode = fcs_mode;
+	j->slots = slots;
+	j->head = 0;
+	j->count = 0;
+	j->next_seq = 0;
+	j->error = 0;
+	
+	for(uint16_t s=0; s<slots; s++){
+		// Sequence numbers wrap, a record is newer if it is less than half the range ahead
+		if(slot_read(j, s, &pkt) && (newest < 0 || (int16_t)(journal_sequence(&pkt) - newest_seq) > 0)){
+			newest = s;
+			newest_seq = journal_sequence(&pkt);
+		}
+	}
+	if(newest < 0){
+		return;
+	}
+	
+	// Walk back from the newest record while the sequence numbers count down by one
+	j->count = 1;
+	while(j->count < slots){
+		uint16_t s = (uint16_t)((newest + slots - j->count) % slots);
+		if(!slot_read(j, s, &pkt) || journal_sequence(&pkt) != (uint16_t)(newest_seq - j->count)){
+			break;
+		}
+		j->count++;
+	}
+	j->head = (uint16_t)((newest + 1) % slots);
+	j->next_seq = (uint16_t)(newest_seq + 1);
+}
+
+uint16_t journal_append(struct Journal* j, const struct Pack* pkt){
+	// Writes the packet to the head slot with the next sequence number, returns the sequence number
+	struct Pack rec = *pkt;
+	uint16_t seq = j->next_seq;
+	
+	rec.payload.pl[JOURNAL_SEQ_OFFSET] = (unsigned char)(seq >> 8);
+	rec.payload.pl[JOURNAL_SEQ_OFFSET+1] = (unsigned char)(seq);
+	rec.FCS = j->fcs(rec, j->fcs_mode);
+	
+	j->error = 0;
+	if(j->eeprom->wait){
+		note_error(j, j->eeprom->wait()); // The previous record may still be being written from the buffer (its error)
+	}
+	packet_serialise(&rec, j->record);
+	note_error(j, j->eeprom->write((uint16_t)(j->head * PACKET_SIZE), j->record, PACKET_SIZE));
+	
+	j->head = (uint16_t)((j->head + 1) % j->slots);
+	if(j->count < j->slots){
+		j->count++;
+	}
+	j->next_seq++;
+	return seq;
+}
+
+uint16_t journal_read_last(struct Journal* j, struct Pack* pkts, uint16_t n){
+	// Reads the newest 'n' records into 'pkts', oldest first. Returns the number of records read
+	struct Pack pkt;
+	uint16_t got = 0;
+	
+	j->error = 0;
+	if(n > j->count){
+		n = j->count;
+	}
+	for(uint16_t i=0; i<n; i++){
+		uint16_t s = (uint16_t)((j->head + j->slots - n + i) % j->slots);
+		if(slot_read(j, s, &pkt)){
+			pkts[got++] = pkt;
+		}
+	}
+	return got;
+}
+
+uint16_t journal_read_block(struct Journal* j, unsigned char* bytes, uint16_t n){
+	// Reads the newest 'n' records as stored (PACKET_SIZE bytes each, oldest first) into 'bytes' with at most two
+	// sequential reads, one either side of the wrap. Returns the number of records, which can then be checked 
+	// and parsed in place with packet_parse, or 0 if they could not be read
+	j->error = 0;
+	if(n > j->count){
+		n = j->count;
+	}
+	if(n == 0){
+		return 0;
+	}
+	
+	uint16_t first = (uint16_t)((j->head + j->slots - n) % j->slots); // Slot of the oldest record wanted
+	uint16_t run = j->slots - first; // Records before the end of the EEPROM
+	if(run > n){
+		run = n;
+	}
+	
+	if(j->eeprom->wait){
+		j->eeprom->wait(); // An error here is the last append's, not the read's
+	}
+	note_error(j, j->eeprom->read((uint16_t)(first * PACKET_SIZE), bytes, (uint16_t)(run * PACKET_SIZE)));
+	if(n > run && !j->error){
+		note_error(j, j->eeprom->read(0, bytes + run * PACKET_SIZE, (uint16_t)((n - run) * PACKET_SIZE)));
+	}
+	return j->error ? 0 : n;
+}
@@ -7,6 +7,20 @@ unsigned int char_x, char_y, orientation;
 unsigned char* font;
 unsigned char buffer[512];    // Display data buffer for LCD
 
+// The text functions only change the buffer and mark the columns they changed on each page (8 rows of pixels).
+// Flush_LCD sends the changed columns of each dirty page, with the column address commands, instead of all 512
+// bytes; the bytes that end up as the LCD already shows them (a line blanked and written again) are left out by
+// comparing with a copy of what it shows. put_string flushes once at its end, or not at all while Defer_LCD_Flush
+// is on, in which case the caller flushes once for the whole screen.
+#define LCD_PAGES 4
+#define LCD_WIDTH 128
+#define LCD_FLUSH_GAP 3 // Unchanged bytes sent rather than a new column address (3 command bytes)
+
+static unsigned char shown[512]; // What the LCD shows
+static int dirty_first[LCD_PAGES] = { LCD_WIDTH, LCD_WIDTH, LCD_WIDTH, LCD_WIDTH }; // Changed columns of each
+static int dirty_last[LCD_PAGES] = { -1, -1, -1, -1 };                                // page (none: first > last)
+static int defer_flush;
+
 void LCD_Display_Config(void) {
 /* Configure Display */
 	Configure_LCD_Pins();
@@ -17,6 +31,8 @@ void LCD_Display_Config(void) {
 }
 
 int put_string(int x, int y, char* stringToSend){
+	int defer = defer_flush;
+	defer_flush = 1; // One flush for the whole string
 	locate(x,y);
 	int width_of_font = font[1]-1;
 	int length = strlen(stringToSend);
@@ -25,9 +41,64 @@ int put_string(int x, int y, char* stringToSend){
 		x+=width_of_font; 
 		locate(x,y);
 	}
+	defer_flush = defer;
+	if(!defer_flush){
+		Flush_LCD();
+	}
 	return 1;
 }
 
+void Defer_LCD_Flush(int on)
+{
+    // On: the text functions leave the LCD alone until Flush_LCD. Off flushes what is waiting
+    defer_flush = on;
+    if (!on) {
+        Flush_LCD();
+    }
+}
+
+static void Send_Columns(int page, int first, int last)
+{
+    // Sends columns 'first' to 'last' of a page
+    int i;
+    Write_Command_To_LCD(0x00 | (first & 0x0F)); // set column low nibble
+    Write_Command_To_LCD(0x10 | (first >> 4));   // set column hi nibble
+    Write_Command_To_LCD(0xB0 | page);           // set page address
+    for(i=page*LCD_WIDTH+first; i<=page*LCD_WIDTH+last; i++) {
+        Write_Data_To_LCD(buffer[i]);
+        shown[i] = buffer[i];
+    }
+}
+
+void Flush_LCD(void)
+{
+    // Sends the bytes changed since the last flush, in runs split where LCD_FLUSH_GAP or more bytes are unchanged
+    int page, i, run, last;
+    for(page=0; page<LCD_PAGES; page++) {
+        unsigned char* now = &buffer[page*LCD_WIDTH];
+        unsigned char* was = &shown[page*LCD_WIDTH];
+        i = dirty_first[page];
+        while (i <= dirty_last[page]) {
+            if (now[i] == was[i]) {
+                i++;
+                continue;
+            }
+            run = i;
+            last = i;
+            while (i <= dirty_last[page] && i - last <= LCD_FLUSH_GAP) {
+                if (now[i] != was[i]) {
+                    last = i;
+                }
+                i++;
+            }
+            Send_Columns(page, run, last);
+            i = last + 1;
+        }
+        dirty_first[page] = LCD_WIDTH;
+        dirty_last[page] = -1;
+    }
+}
+
 
 int put_char(int value)
 {
@@ -39,7 +110,9 @@ int put_char(int value)
         }
     } else {
         character(char_x, char_y, value);
-        Copy_Data_Buffer_To_LCD();
+        if (!defer_flush) {
+            Flush_LCD();
+        }
     }
     return value;
 }
@@ -143,11 +216,17 @@ void Write_Test_Character(unsigned char l0, unsigned char l1,unsigned char l2,un
  
 void pixel(int x, int y, int color)
 {
-    if(x > 128 || y > 32 || x < 0 || y < 0) return;
+    if(x >= LCD_WIDTH || y >= LCD_PAGES*8 || x < 0 || y < 0) return;
+    int page = y/8;
+    unsigned char byte = buffer[x + (page * LCD_WIDTH)];
     if(color == 0)
-      buffer[x + ((y/8) * 128)] &= ~(1 << (y%8));  // erase pixel
+      byte &= ~(1 << (y%8));  // erase pixel
     else
-      buffer[x + ((y/8) * 128)] |= (1  << (y%8));   // set pixel
+      byte |= (1  << (y%8));   // set pixel
+    if(byte == buffer[x + (page * LCD_WIDTH)]) return;
+    buffer[x + (page * LCD_WIDTH)] = byte;
+    if(x < dirty_first[page]) dirty_first[page] = x;  // mark the column changed
+    if(x > dirty_last[page]) dirty_last[page] = x;
 }
 
 void Set_Contrast(unsigned int o)
@@ -257,6 +336,13 @@ void Copy_Data_Buffer_To_LCD(void)
 	
 	  int i=0;
 	  
+	  // Everything is sent, nothing is left to flush
+	  memcpy(shown, buffer, 512);
+	  for(i=0; i<LCD_PAGES; i++) {
+	      dirty_first[i] = LCD_WIDTH;
+	      dirty_last[i] = -1;
+	  }
+	  
 	  // Page 0
     Write_Command_To_LCD(0x00);      // set column low nibble to 0  
     Write_Command_To_LCD(0x10);      // set column hi nibble to 0
@@ -0,0 +1,116 @@
+#include "Packet.h"
+
+/*
+Packet
+Converts packets to and from the byte layout used in EEPROM (multi-byte fields are stored most significant
+byte first) and builds the word streams that are fed to the CRC unit for the FCS.
+Nothing in here touches the hardware, so the same file can be built for host tools.
+*/
+
+void packet_serialise(const struct Pack* pkt, unsigned char* bytes){
+	// Writes the packet into PACKET_SIZE bytes in EEPROM order
+	int n=0; // Byte index
+	
+	for(int i=0; i<6; i++){
+		bytes[n++]= pkt->MAC_dest[i];
+	}
+	for(int i=0; i<6; i++){
+		bytes[n++]= pkt->MAC_src[i];
+	}
+	bytes[n++]= (unsigned char)(pkt->length >> 8); //LENGTH HIGH BYTE
+	bytes[n++]= (unsigned char)(pkt->length); //LENGTH LOW BYTE
+	bytes[n++]= (unsigned char)(pkt->payload.sample >> 8); //TEMPERATURE HIGH BYTE
+	bytes[n++]= (unsigned char)(pkt->payload.sample); //TEMPERATURE LOW BYTE
+	for(int i=0; i<44; i++){
+		bytes[n++]= pkt->payload.pl[i];
+	}
+	bytes[n++]= (unsigned char)(pkt->FCS >> 24); //FIRST FCS BYTE
+	bytes[n++]= (unsigned char)(pkt->FCS >> 16); //SECOND FCS BYTE
+	bytes[n++]= (unsigned char)(pkt->FCS >> 8); //THIRD FCS BYTE
+	bytes[n++]= (unsigned char)(pkt->FCS); //FOURTH FCS BYTE
+}
+
+void packet_parse(const unsigned char* bytes, struct Pack* pkt){
+	// Reads a packet back from PACKET_SIZE bytes in EEPROM order
+	int n=0; // Byte index
+	
+	for(int i=0; i<6; i++){
+		pkt->MAC_dest[i]= bytes[n++];
+	}
+	for(int i=0; i<6; i++){
+		pkt->MAC_src[i]= bytes[n++];
+	}
+	pkt->length= (uint16_t)((bytes[n] << 8) | bytes[n+1]);
+	n+=2;
+	pkt->payload.sample= (uint16_t)((bytes[n] << 8) | bytes[n+1]);
+	n+=2;
+	for(int i=0; i<44; i++){
+		pkt->payload.pl[i]= bytes[n++];
+	}
+	pkt->FCS= ((uint32_t)bytes[n] << 24) | ((uint32_t)bytes[n+1] << 16) | ((uint32_t)bytes[n+2] << 8) | bytes[n+3];
+}
+
+uint32_t packet_fcs_words(const struct Pack* pkt, uint32_t mode, uint32_t* words){
+	// Fills 'words' with the stream fed to the CRC unit for the given FCS mode, returns the number of words
+	uint32_t n=0; // Number of words
+	
+	if(mode == FCS_MODE_PACKED){
+		unsigned char bytes[PACKET_SIZE];
+		packet_serialise(pkt, bytes);
+		// The CRC unit shifts each word in from bit 31, so packing big-endian makes the
+		// result the standard CRC-32/MPEG-2 of the first 60 bytes of the serialised packet
+		for(int i=0; i<PACKET_FCS_OFFSET; i+=4){
+			words[n++]= ((uint32_t)bytes[i] << 24) | ((uint32_t)bytes[i+1] << 16) | ((uint32_t)bytes[i+2] << 8) | bytes[i+3];
+		}
+		return n;
+	}
+	
+	// FCS_MODE_LEGACY
+	for(int i=0;i<6;i++){
+	    words[n++]= pkt->MAC_dest[i];
+	}
+	for(int i=0;i<6;i++){
+	    words[n++]= pkt->MAC_src[i];
+	}
+	words[n++]= pkt->length;
+	words[n++]= pkt->payload.sample;
+	for(int i=0; i<44; i++){
+	    words[n++]= pkt->payload.pl[i];
+	}
+	return n;
+}
+
+/*
+Incremental FCS
+The CRC is linear: for two messages of the same length, CRC(a) ^ CRC(b) depends only on a ^ b. So the FCS of
+a packet is the FCS of the same packet with sample = 0, XORed with the contribution of every set bit of the
+sample pushed through the rest of the packet. Both are worked out once by fcs_cache_prime, after which a new
+sample costs at most 16 XORs and gives exactly the same value as recalculating over the whole packet.
+The cache has to be primed again whenever any field other than the sample changes.
+*/
+
+void fcs_cache_prime(struct FCS_Cache* cache, const struct Pack* pkt, uint32_t mode, fcs_function_t fcs){
+	// Calculates the FCS of the constant fields and the contribution of each sample bit
+	struct Pack tmp = *pkt;
+	
+	cache->mode = mode;
+	tmp.payload.sample = 0;
+	cache->base = fcs(tmp, mode);
+	
+	for(int i=0; i<16; i++){
+		tmp.payload.sample = (uint16_t)(1u << i);
+		cache->basis[i] = fcs(tmp, mode) ^ cache->base;
+	}
+}
+
+uint32_t fcs_cache_update(const struct FCS_Cache* cache, uint16_t sample){
+	// Returns the FCS of the primed packet with its sample field set to 'sample'
+	uint32_t crc = cache->base;
+	
+	for(int i=0; sample; i++, sample >>= 1){
+		if(sample & 1){
+			crc ^= cache->basis[i];
+		}
+	}
+	return crc;
+}
@@ -0,0 +1,229 @@
+#include "main.h"
+#include "Time_Delays.h"
+#include "I2C_Bus.h"
+#include "Sampler.h"
+
+/*
+Sampler
+Reads the temperature sensors in the background at a fixed rate. TIM2 (1 us per count) gives an update interrupt
+every period, and the interrupt notes the time and queues one read transfer per sensor on the I2C1 transfer
+queue (I2C_Bus.c), which runs them from the I2C1 and DMA interrupts. The transfers are chained, so the sweep is a
+single bus transaction: each read ends with a repeated START for the next sensor instead of a STOP, the bus does
+not go idle between sensors and no EEPROM transfer gets in between them. The reads are in the highest priority
+class, so a sweep waits for at most the transfer already on the bus (one EEPROM page write or read chunk), not
+for the EEPROM transfers queued behind it.
+The LM75 keeps its pointer register between transactions, so once a read has set it to the temperature register
+the following reads (fast mode, sampler_set_fast) leave the pointer write out and start straight with the read:
+one START and three bytes instead of two STARTs and five bytes. The pointer is set again after an error, and after
+other code has addressed the sensor's other registers and called sampler_pointer_moved.
+Several LM75s can share the bus (address pins A2-A0, TEMPADR to TEMPADR_LAST): sampler_scan probes every address
+at start up, and each timer update then reads all the sensors found. A sensor that does not acknowledge is
+counted and the sweep carries on with the next one.
+Finished samples go into a ring that is written only by the interrupt (head) and read only by the main loop
+(tail), so neither side has to turn interrupts off. A timer update that comes while the previous sweep is still
+queued or running is counted as missed rather than queued, so the sample times stay on the grid.
+*/
+
+#define SM_IDLE 0 // Waiting for the timer
+#define SM_BUSY 1 // Sweep queued or on the bus
+
+static volatile uint32_t sm_state = SM_IDLE;
+static uint32_t sm_time; // micros() at the timer update of the running sweep
+static volatile uint32_t sm_fast = 1; // Leave the pointer write out when the pointer is known
+static volatile uint32_t sm_pointer_ok; // Bit per sensor: its pointer register is on the temperature register
+
+static uint8_t sm_address[SAMPLER_MAX_SENSORS] = { TEMPADR }; // Sensors found by sampler_scan
+static uint32_t sm_sensors = 1;
+
+static struct I2C_Transfer sm_transfer[SAMPLER_MAX_SENSORS]; // One read per sensor, chained
+static unsigned char sm_data[SAMPLER_MAX_SENSORS][2]; // Temperature bytes of each sensor (DMA)
+
+static struct Sample sm_ring[SAMPLER_RING_SIZE];
+static volatile uint32_t sm_head; // Samples written (only changed by the interrupt)
+static volatile uint32_t sm_tail; // Samples read (only changed by the main loop)
+
+static struct Sampler_Stats sm_stats;
+
+static void sm_done(struct I2C_Transfer* t);
+
+void sampler_configure(uint32_t period_us){
+	// Sets TIM2 up to count microseconds and interrupt every 'period_us' (i2c_bus_configure must be called
+	// first). Sampling starts with sampler_start
+	LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_TIM2);
+	LL_TIM_DisableCounter(TIM2);
+	LL_TIM_SetPrescaler(TIM2, SystemCoreClock / 1000000 - 1);
+	LL_TIM_SetCounterMode(TIM2, LL_TIM_COUNTERMODE_UP);
+	LL_TIM_SetAutoReload(TIM2, period_us - 1);
+	LL_TIM_SetUpdateSource(TIM2, LL_TIM_UPDATESOURCE_COUNTER);
+	LL_TIM_GenerateEvent_UPDATE(TIM2); // Load the prescaler
+	LL_TIM_ClearFlag_UPDATE(TIM2);
+	LL_TIM_EnableIT_UPDATE(TIM2);
+
+	// Same priority as the I2C1 and DMA interrupts, the sweep is queued from here
+	NVIC_SetPriority(TIM2_IRQn, 1);
+	NVIC_EnableIRQ(TIM2_IRQn);
+
+	for(uint32_t i=0; i<SAMPLER_MAX_SENSORS; i++){
+		sm_transfer[i].priority = I2C_PRIORITY_HIGH; // Ahead of any EEPROM transfer waiting
+		sm_transfer[i].cmd[0] = 0x00; // Pointer register to the temperature register
+		sm_transfer[i].tx_length = 0;
+		sm_transfer[i].rx = sm_data[i];
+		sm_transfer[i].rx_length = 2;
+		sm_transfer[i].done = sm_done;
+	}
+	sm_state = SM_IDLE;
+	sm_pointer_ok = 0; // Not known until the first read has set it
+	sm_head = 0;
+	sm_tail = 0;
+}
+
+uint32_t sampler_scan(void){
+	// Probes every LM75 address (before sampler_start) and returns the number of sensors that acknowledged.
+	// If none does, the sampler keeps reading TEMPADR, and the errors are counted
+	static struct I2C_Transfer probe[(TEMPADR_LAST - TEMPADR) / 2 + 1];
+	uint32_t found = 0;
+	uint32_t n = sizeof(probe) / sizeof(probe[0]);
+	
+	for(uint32_t i=0; i<n; i++){
+		probe[i].address = (uint8_t)(TEMPADR + 2 * i); // Address only
+		probe[i].flags = 0;
+		probe[i].priority = I2C_PRIORITY_NORMAL;
+		probe[i].cmd_length = 0;
+		probe[i].tx_length = 0;
+		probe[i].rx_length = 0;
+		probe[i].done = 0;
+	}
+	i2c_submit(probe, n);
+	i2c_wait(&probe[n - 1]);
+	for(uint32_t i=0; i<n; i++){
+		if(probe[i].status == I2C_OK && found < SAMPLER_MAX_SENSORS){
+			sm_address[found++] = probe[i].address;
+		}
+	}
+	
+	if(found == 0){
+		sm_address[0] = TEMPADR;
+	}
+	sm_sensors = found ? found : 1;
+	sm_pointer_ok = 0;
+	return found;
+}
+
+uint32_t sampler_sensors(void){
+	// Number of sensors read in each sweep
+	return sm_sensors;
+}
+
+uint32_t sampler_sensor_address(uint32_t sensor){
+	// I2C address of a sensor (the index in Sample.sensor)
+	return sm_address[sensor];
+}
+
+void sampler_set_period(uint32_t period_us){
+	// Changes the sampling period, the next sample is taken one new period from now
+	LL_TIM_SetAutoReload(TIM2, period_us - 1);
+	LL_TIM_SetCounter(TIM2, 0);
+}
+
+void sampler_start(void){
+	LL_TIM_SetCounter(TIM2, 0);
+	LL_TIM_EnableCounter(TIM2);
+}
+
+void sampler_stop(void){
+	// A read that is already running finishes
+	LL_TIM_DisableCounter(TIM2);
+}
+
+void sampler_set_fast(uint32_t on){
+	// Selects fast reads (only the data read once the pointer is set, the default) or the full sequence every time
+	sm_fast = on;
+	sm_pointer_ok = 0;
+}
+
+void sampler_pointer_moved(void){
+	// To be called by code that leaves an LM75 pointing at another register, once its transfers have finished
+	sm_pointer_ok = 0;
+}
+
+uint32_t sampler_read(struct Sample* s){
+	// Takes the oldest sample from the ring, returns 0 if there is none (main loop only)
+	uint32_t tail = sm_tail;
+	if(tail == sm_head){
+		return 0;
+	}
+	*s = sm_ring[tail & (SAMPLER_RING_SIZE - 1)];
+	__DMB(); // The sample is copied before its slot is handed back
+	sm_tail = tail + 1;
+	return 1;
+}
+
+uint32_t sampler_pending(void){
+	// Returns the number of samples waiting in the ring
+	return sm_head - sm_tail;
+}
+
+const struct Sampler_Stats* sampler_stats(void){
+	return &sm_stats;
+}
+
+static void sm_push(uint16_t value, uint32_t sensor){
+	// Adds a sample to the ring, or counts it as lost if the main loop has not made room
+	uint32_t head = sm_head;
+	if(head - sm_tail == SAMPLER_RING_SIZE){
+		sm_stats.overruns++;
+		return;
+	}
+	sm_ring[head & (SAMPLER_RING_SIZE - 1)].time_us = sm_time;
+	sm_ring[head & (SAMPLER_RING_SIZE - 1)].value = value;
+	sm_ring[head & (SAMPLER_RING_SIZE - 1)].sensor = (uint8_t)sensor;
+	__DMB(); // The sample is in the ring before the main loop can see it
+	sm_head = head + 1;
+	sm_stats.samples++;
+}
+
+static void sm_done(struct I2C_Transfer* t){
+	// A sensor's read has finished (I2C1 or DMA interrupt)
+	uint32_t sensor = (uint32_t)(t - sm_transfer);
+	
+	if(t->status == I2C_OK){
+		uint16_t temperature = (uint16_t)((sm_data[sensor][0] << 8) | sm_data[sensor][1]);
+		sm_push(temperature >> 5, sensor); // The 11 bit value is in the upper part of the 16 bits
+		sm_pointer_ok |= 1u << sensor;
+	}
+	else{
+		// NACK (sensor missing) or bus error: set the pointer again next time, in case the sensor was reset
+		sm_stats.errors++;
+		sm_pointer_ok &= ~(1u << sensor);
+	}
+	if(sensor + 1 >= sm_sensors){
+		sm_state = SM_IDLE; // Last of the sweep
+	}
+}
+
+void TIM2_IRQHandler(void){
+	if(!LL_TIM_IsActiveFlag_UPDATE(TIM2)){
+		return;
+	}
+	LL_TIM_ClearFlag_UPDATE(TIM2);
+
+	if(sm_state != SM_IDLE){
+		sm_stats.missed++;
+		return;
+	}
+	sm_time = micros(); // One time for the whole sweep
+	sm_state = SM_BUSY;
+	for(uint32_t i=0; i<sm_sensors; i++){
+		struct I2C_Transfer* t = &sm_transfer[i];
+		t->address = sm_address[i];
+		t->flags = (i + 1 < sm_sensors) ? I2C_CHAIN : 0;
+		if(sm_fast && (sm_pointer_ok & (1u << i))){
+			t->cmd_length = 0; // ADDRESS + READ, the pointer is already set
+		}
+		else{
+			t->cmd_length = 1; // Set the pointer, then RE-START and read
+			sm_stats.pointer_writes++;
+		}
+	}
+	i2c_submit(sm_transfer, sm_sensors);
+}